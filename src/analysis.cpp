@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "analysis.hpp"
+#include "perfvisitor.hpp"
+#include "textbuffer.hpp"
+#include "util.hpp"
+#include "vectorizationvisitor.hpp"
+
+static std::string json_string(std::string const& s) {
+    std::stringstream out;
+    out << '"';
+    for(auto c : s) {
+        switch(c) {
+            case '"' : out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n";  break;
+            case '\t': out << "\\t";  break;
+            default  :
+                if(static_cast<unsigned char>(c)<0x20) {
+                    out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c);
+                }
+                else {
+                    out << c;
+                }
+        }
+    }
+    out << '"';
+    return out.str();
+}
+
+// the name of a file without its directory, so that reports do not depend on
+// where the .mod files are checked out
+static std::string file_basename(std::string const& path) {
+    auto pos = path.find_last_of('/');
+    return pos==std::string::npos ? path : path.substr(pos+1);
+}
+
+// the sorted names of a set of symbols as a JSON array
+static std::string json_names(std::set<Symbol*> const& symbols) {
+    std::vector<std::string> names;
+    for(auto s : symbols) {
+        names.push_back(s->name());
+    }
+    std::sort(names.begin(), names.end());
+
+    std::string s = "[";
+    for(auto i=0u; i<names.size(); ++i) {
+        s += (i ? ", " : "") + json_string(names[i]);
+    }
+    return s + "]";
+}
+
+// print the members of an object, with a comma after all but the last
+static void print_members(TextBuffer& text, std::vector<std::string> const& members) {
+    for(auto i=0u; i<members.size(); ++i) {
+        text.add_line(members[i] + (i+1<members.size() ? "," : ""));
+    }
+}
+
+static std::string number(double v) {
+    std::stringstream s;
+    s << v;
+    return s.str();
+}
+
+static std::string json_diagnostic(VectorizationDiagnostic const& d) {
+    return pprintf("{\"kind\": %, \"line\": %, \"column\": %, \"message\": %}",
+                   json_string(to_string(d.kind)), d.location.line, d.location.column,
+                   json_string(d.message));
+}
+
+static std::string json_cost(CostEstimate const& c, CostModel const& model) {
+    std::string ops;
+    for(auto i=0; i<num_cost_ops; ++i) {
+        ops += pprintf("%\"%\": %", i ? ", " : "", to_string(costOp(i)), c.count[i]);
+    }
+    return "\"cost\": {\"target\": " + json_string(model.name)
+        + ", \"cycles_per_instance\": " + number(c.cycles_per_instance)
+        + ", \"critical_path\": " + number(c.critical_path)
+        + ", \"ops\": {" + ops + "}}";
+}
+
+static void print_method(
+    TextBuffer& text, APIMethod* method, bool point_process, bool optimize,
+    MachineModel const& machine, CostModel const& cost_model)
+{
+    auto flops = make_unique<FlopVisitor>();
+    method->accept(flops.get());
+    auto memops = make_unique<MemOpVisitor>();
+    method->accept(memops.get());
+    auto vectorization = make_unique<VectorizationVisitor>(point_process, optimize);
+    method->accept(vectorization.get());
+
+    auto const& f = flops->flops;
+    auto estimate = roofline(f, memops->bytes_per_instance(), machine);
+
+    text.add_line(json_string(method->name()) + ": {");
+    text.increase_indentation();
+    print_members(text, {
+        pprintf("\"flops\": {\"add\": %, \"neg\": %, \"mul\": %, \"div\": %, "
+                "\"exp\": %, \"sin\": %, \"cos\": %, \"log\": %, \"pow\": %, \"total\": %}",
+                f.add, f.neg, f.mul, f.div, f.exp, f.sin, f.cos, f.log, f.pow, f.total()),
+        "\"loads\": {\"direct\": " + json_names(memops->vector_reads())
+            + ", \"indexed\": " + json_names(memops->indexed_reads()) + "}",
+        "\"stores\": {\"direct\": " + json_names(memops->vector_writes())
+            + ", \"indexed\": " + json_names(memops->indexed_writes()) + "}",
+        pprintf("\"locals\": %", method->scope()->locals().size()),
+        pprintf("\"bytes_per_instance\": %", memops->bytes_per_instance()),
+        "\"roofline\": {\"flops\": " + number(estimate.flops)
+            + ", \"intensity\": " + number(estimate.intensity)
+            + ", \"time_ns\": " + number(estimate.time)
+            + ", \"bound\": " + (estimate.memory_bound ? "\"memory\"" : "\"compute\"") + "}",
+        json_cost(estimate_cost(method, cost_model), cost_model) + ","
+    });
+
+    auto const& diagnostics = vectorization->diagnostics();
+    if(diagnostics.empty()) {
+        text.add_line("\"vectorization\": []");
+    }
+    else {
+        text.add_line("\"vectorization\": [");
+        text.increase_indentation();
+        std::vector<std::string> items;
+        for(auto const& d : diagnostics) {
+            items.push_back(json_diagnostic(d));
+        }
+        print_members(text, items);
+        text.decrease_indentation();
+        text.add_line("]");
+    }
+    text.decrease_indentation();
+}
+
+static void print_module(
+    TextBuffer& text, Module& m, bool optimize,
+    MachineModel const& machine, CostModel const& cost_model)
+{
+    std::vector<APIMethod*> methods;
+    int num_states = 0;
+    for(auto& symbol : m.symbols()) {
+        if(auto method = symbol.second->is_api_method()) {
+            methods.push_back(method);
+        }
+        else if(auto var = symbol.second->is_variable()) {
+            if(var->is_state()) ++num_states;
+        }
+    }
+    std::sort(methods.begin(), methods.end(),
+        [](APIMethod* l, APIMethod* r) {return l->name() < r->name();});
+
+    text.add_line("{");
+    text.increase_indentation();
+    text.add_line("\"name\": " + json_string(m.name()) + ",");
+    text.add_line("\"file\": " + json_string(file_basename(m.file_name())) + ",");
+    text.add_line(std::string("\"kind\": ")
+        + (m.kind()==moduleKind::density ? "\"density\"" : "\"point\"") + ",");
+    text.add_line(pprintf("\"states\": %,", num_states));
+    text.add_line("\"methods\": {");
+    text.increase_indentation();
+    for(auto i=0u; i<methods.size(); ++i) {
+        print_method(text, methods[i], m.kind()==moduleKind::point, optimize, machine, cost_model);
+        text.add_line(i+1<methods.size() ? "}," : "}");
+    }
+    text.decrease_indentation();
+    text.add_line("}");
+    text.decrease_indentation();
+}
+
+std::string analysis_json(
+    std::vector<Module*> const& modules, MachineModel const& machine,
+    CostModel const& cost_model, bool optimize)
+{
+    auto sorted = modules;
+    std::sort(sorted.begin(), sorted.end(),
+        [](Module* l, Module* r) {return l->name() < r->name();});
+
+    TextBuffer text;
+    text.add_line("{");
+    text.increase_indentation();
+    text.add_line("\"machine\": {");
+    text.increase_indentation();
+    print_members(text, {
+        "\"name\": " + json_string(machine.name),
+        "\"peak_gflops\": " + number(machine.peak_gflops),
+        "\"bandwidth\": " + number(machine.bandwidth),
+        pprintf("\"vector_width\": %", machine.vector_width)
+    });
+    text.decrease_indentation();
+    text.add_line("},");
+    text.add_line("\"modules\": [");
+    text.increase_indentation();
+    for(auto i=0u; i<sorted.size(); ++i) {
+        print_module(text, *sorted[i], optimize, machine, cost_model);
+        text.add_line(i+1<sorted.size() ? "}," : "}");
+    }
+    text.decrease_indentation();
+    text.add_line("]");
+    text.decrease_indentation();
+    text.add_line("}");
+
+    return text.str();
+}
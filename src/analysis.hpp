@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "costmodel.hpp"
+#include "module.hpp"
+#include "roofline.hpp"
+
+/// The performance analysis of the API methods of a set of modules as a
+/// single JSON document, for tools that track kernels across compiler
+/// versions and .mod file revisions.
+/// Modules and methods are sorted by name, so that the output of two runs
+/// can be compared with diff.
+/// The modules must have passed semantic analysis, and optimize is the
+/// option passed to the CPrinter, which changes the vectorization diagnostics.
+std::string analysis_json(
+    std::vector<Module*> const& modules, MachineModel const& machine,
+    CostModel const& cost_model, bool optimize);
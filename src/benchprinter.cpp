@@ -0,0 +1,452 @@
+#include <string>
+
+#include "benchprinter.hpp"
+#include "perfvisitor.hpp"
+#include "util.hpp"
+
+/******************************************************************************
+                              BenchPrinter
+******************************************************************************/
+
+// the default state of the ions used by the benchmark
+struct ion_defaults {
+    const char* name;
+    ionKind kind;
+    double reversal_potential;
+    double internal_concentration;
+    double external_concentration;
+};
+
+static const ion_defaults ions[] = {
+    {"na", ionKind::Na,   50.0, 10.0,   140.0},
+    {"k",  ionKind::K,   -77.0, 54.4,     2.5},
+    {"ca", ionKind::Ca,  132.5,  5e-5,    2.0},
+};
+
+// Hardware counters of the calling thread, read with perf_event_open.
+// The counters that can not be opened, e.g. in a virtual machine or when
+// perf_event_paranoid is too restrictive, are left out.
+static const char* perf_counters_source = R"(// Raw events are given by MODCC_PERF_RAW, a comma separated list of
+// name=config. On Intel processors the default is the scalar and vector
+// instruction counts of FP_ARITH_INST_RETIRED, in single and double precision:
+//   MODCC_PERF_RAW=scalar=0x03c7,sse=0x0cc7,avx2=0x30c7,avx512=0xc0c7
+// on other processors there are no raw events unless they are given, and an
+// empty MODCC_PERF_RAW leaves them out.
+class perf_counters {
+public:
+    perf_counters() {
+#ifdef __linux__
+        add("cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        add("instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        add("L1D_misses", PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_L1D));
+        add("LLC_misses", PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_LL));
+        const char* raw = std::getenv("MODCC_PERF_RAW");
+        if(!raw) raw = default_raw_events();
+        if(raw) {
+            std::stringstream events(raw);
+            std::string event;
+            while(std::getline(events, event, ',')) {
+                auto pos = event.find('=');
+                if(pos==std::string::npos) continue;
+                add(event.substr(0, pos), PERF_TYPE_RAW,
+                    std::strtoull(event.substr(pos+1).c_str(), nullptr, 0));
+            }
+        }
+#endif
+    }
+
+    ~perf_counters() {
+#ifdef __linux__
+        for(auto fd: fds_) close(fd);
+#endif
+    }
+
+    std::size_t size() const {return names_.size();}
+    std::string const& name(std::size_t i) const {return names_[i];}
+
+    // the index of a counter, or -1 if it is not available
+    int find(std::string const& name) const {
+        for(std::size_t i=0; i<names_.size(); ++i) {
+            if(names_[i]==name) return i;
+        }
+        return -1;
+    }
+
+    void read(std::vector<std::uint64_t>& values) const {
+        values.resize(fds_.size());
+#ifdef __linux__
+        for(std::size_t i=0; i<fds_.size(); ++i) {
+            if(::read(fds_[i], &values[i], sizeof(std::uint64_t))!=sizeof(std::uint64_t)) {
+                values[i] = 0;
+            }
+        }
+#endif
+    }
+
+private:
+#ifdef __linux__
+    static const char* default_raw_events() {
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned eax, ebx, ecx, edx;
+        if(__get_cpuid(0, &eax, &ebx, &ecx, &edx)) {
+            char vendor[13] = {0};
+            std::memcpy(vendor, &ebx, 4);
+            std::memcpy(vendor+4, &edx, 4);
+            std::memcpy(vendor+8, &ecx, 4);
+            if(!std::strcmp(vendor, "GenuineIntel")) {
+                return "scalar=0x03c7,sse=0x0cc7,avx2=0x30c7,avx512=0xc0c7";
+            }
+        }
+#endif
+        return nullptr;
+    }
+
+    static std::uint64_t cache_miss(std::uint64_t cache) {
+        return cache
+            | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+            | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+
+    void add(std::string const& name, std::uint32_t type, std::uint64_t config) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        int fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if(fd>=0) {
+            names_.push_back(name);
+            fds_.push_back(fd);
+        }
+    }
+#endif
+
+    std::vector<std::string> names_;
+    std::vector<int> fds_;
+};)";
+
+BenchPrinter::BenchPrinter(Module &m, CPrinterOptions const& opts)
+:   module_(&m),
+    options_(opts)
+{
+    // the mechanism is printed verbatim, without the include guard, which
+    // is not permitted in the main file
+    // the guard is replaced by an empty line to keep the line numbers of
+    // #line directives
+    std::istringstream mechanism(CPrinter(m, opts).text());
+    std::string line;
+    while(std::getline(mechanism, line)) {
+        text_.add_line(line=="#pragma once" ? "" : line);
+    }
+    text_.add_line();
+
+    print_driver();
+}
+
+void BenchPrinter::print_driver() {
+    auto const& name = module_->name();
+    auto const& used_ions = module_->neuron_block().ions;
+    auto uses_ion = [&used_ions] (ionKind k) {
+        for(auto const& ion: used_ions) {
+            if(ion.kind()==k) return true;
+        }
+        return false;
+    };
+
+    // point processes are driven by events with a single weight
+    std::string weight;
+    for(auto& sym: module_->symbols()) {
+        if(auto proc = sym.second->is_procedure()) {
+            if(proc->kind()==procedureKind::net_receive && proc->args().size()==1) {
+                weight = proc->args()[0]->is_argument()->name();
+            }
+        }
+    }
+    bool has_events = !weight.empty();
+
+    auto call = [this] (std::string const& method) {
+        if(options_.threads) {
+            return "mech." + method + "_parallel(num_threads);";
+        }
+        return "mech." + method + "();";
+    };
+
+    text_.add_line("/******************************************************************************");
+    text_.add_line("  benchmark driver for the " + name + " mechanism");
+    text_.add_line("  usage: bench <file.nodes> [steps] [threads]");
+    text_.add_line("******************************************************************************/");
+    text_.add_line();
+    text_.add_line("#include <algorithm>");
+    text_.add_line("#include <chrono>");
+    text_.add_line("#include <cstdint>");
+    text_.add_line("#include <cstdio>");
+    text_.add_line("#include <cstdlib>");
+    text_.add_line("#include <cstring>");
+    text_.add_line("#include <fstream>");
+    text_.add_line("#include <iostream>");
+    text_.add_line("#include <sstream>");
+    text_.add_line("#include <string>");
+    text_.add_line("#include <thread>");
+    text_.add_line("#include <vector>");
+    text_.add_line();
+    text_.add_line("#ifdef __linux__");
+    text_.add_line("#include <linux/perf_event.h>");
+    text_.add_line("#include <sys/syscall.h>");
+    text_.add_line("#include <unistd.h>");
+    text_.add_line("#if defined(__x86_64__) || defined(__i386__)");
+    text_.add_line("#include <cpuid.h>");
+    text_.add_line("#endif");
+    text_.add_line("#endif");
+    text_.add_line();
+    std::istringstream counters(perf_counters_source);
+    std::string line;
+    while(std::getline(counters, line)) {
+        text_.add_line(line);
+    }
+    text_.add_line();
+    text_.add_line("int main(int argc, char** argv) {");
+    text_.increase_indentation();
+    text_.add_line("using namespace nest::mc::mechanisms;");
+    text_.add_line("using mechanism_type = " + name + "::mechanism_" + name + "<double, int>;");
+    text_.add_line("using value_type = mechanism_type::value_type;");
+    text_.add_line("using size_type  = mechanism_type::size_type;");
+    text_.add_line("using view_type  = mechanism_type::view_type;");
+    text_.add_line("using index_view = mechanism_type::const_index_view;");
+    text_.add_line("using clock_type = std::chrono::high_resolution_clock;");
+    text_.add_line("auto seconds = [] (clock_type::duration d) {return std::chrono::duration<double>(d).count();};");
+    text_.add_line();
+    text_.add_line("if(argc<2) {");
+    text_.increase_indentation();
+    text_.add_line("std::cerr << \"usage: \" << argv[0] << \" <file.nodes> [steps] [threads]\" << std::endl;");
+    text_.add_line("return 1;");
+    text_.decrease_indentation();
+    text_.add_line("}");
+    text_.add_line("int num_steps = argc>2 ? std::atoi(argv[2]) : 1000;");
+    if(options_.first_touch) {
+        text_.add_line("int num_threads = argc>3 ? std::atoi(argv[3]) : modcc::default_num_threads();");
+    }
+    else {
+        text_.add_line("int num_threads = argc>3 ? std::atoi(argv[3]) : std::max(1, int(std::thread::hardware_concurrency()));");
+    }
+    if(!options_.threads) {
+        text_.add_line("num_threads = 1;");
+    }
+    text_.add_line();
+
+    text_.add_line("// the first entry in the node file is the number of instances, followed");
+    text_.add_line("// by the index of the node of each instance");
+    text_.add_line("std::ifstream fid(argv[1]);");
+    text_.add_line("int n = 0;");
+    text_.add_line("fid >> n;");
+    text_.add_line("std::vector<size_type> node_index(std::max(n, 0));");
+    text_.add_line("for(auto& i: node_index) fid >> i;");
+    text_.add_line("if(!fid) {");
+    text_.increase_indentation();
+    text_.add_line("std::cerr << \"unable to read node indexes from \" << argv[1] << std::endl;");
+    text_.add_line("return 1;");
+    text_.decrease_indentation();
+    text_.add_line("}");
+    text_.add_line("std::sort(node_index.begin(), node_index.end());");
+    text_.add_line("int num_nodes = n ? node_index.back()+1 : 0;");
+    text_.add_line();
+
+    text_.add_line("std::vector<value_type> vec_v(num_nodes, -65.);");
+    text_.add_line("std::vector<value_type> vec_i(num_nodes, 0.);");
+    text_.add_line("std::vector<value_type> vec_g(num_nodes, 0.);");
+    text_.add_line("std::vector<value_type> vec_area(num_nodes, 100.);");
+    text_.add_line();
+    text_.add_line("mechanism_type mech(");
+    text_.add_line("    view_type(vec_v.data(), num_nodes),");
+    text_.add_line("    view_type(vec_i.data(), num_nodes),");
+    text_.add_line("    index_view(node_index.data(), n));");
+    text_.add_line("mech.set_areas(view_type(vec_area.data(), num_nodes));");
+    text_.add_line("mech.set_conductances(view_type(vec_g.data(), num_nodes));");
+    text_.add_line();
+
+    if(used_ions.size()) {
+        text_.add_line("// the ions are defined on every node that has an instance");
+        text_.add_line("std::vector<size_type> ion_index(node_index);");
+        text_.add_line("ion_index.erase(std::unique(ion_index.begin(), ion_index.end()), ion_index.end());");
+        text_.add_line("int num_ion = ion_index.size();");
+        for(auto const& ion: ions) {
+            if(!uses_ion(ion.kind)) continue;
+            std::string p = ion.name;
+            text_.add_gutter() << "std::vector<value_type> "
+                << p << "_current(num_ion, 0.), "
+                << p << "_erev(num_ion, " << ion.reversal_potential << "), "
+                << p << "_xi(num_ion, " << ion.internal_concentration << "), "
+                << p << "_xo(num_ion, " << ion.external_concentration << ");";
+            text_.end_line();
+            text_.add_line("mechanism_type::ion_type ion_" + p + "(");
+            text_.add_line("    index_view(ion_index.data(), num_ion),");
+            text_.add_line("    view_type(" + p + "_current.data(), num_ion),");
+            text_.add_line("    view_type(" + p + "_erev.data(), num_ion),");
+            text_.add_line("    view_type(" + p + "_xi.data(), num_ion),");
+            text_.add_line("    view_type(" + p + "_xo.data(), num_ion));");
+            text_.add_line("mech.set_ion(ionKind::" + p + ", ion_" + p + ");");
+        }
+        text_.add_line();
+    }
+
+    text_.add_line("value_type dt = 0.025;");
+    text_.add_line("mech.set_params(0, dt);");
+    text_.add_line("auto start = clock_type::now();");
+    text_.add_line(call("nrn_init"));
+    text_.add_line("auto init_time = seconds(clock_type::now()-start);");
+    text_.add_line();
+    if(has_events) {
+        text_.add_line("// deliver one event to every instance, in one batch");
+        text_.add_line("std::vector<int> event_target(n);");
+        text_.add_line("for(int i=0; i<n; ++i) event_target[i] = i;");
+        text_.add_line("std::vector<value_type> event_weight(n, 0.01);");
+        text_.add_line("mechanism_type::event_batch events;");
+        text_.add_line("events.target = event_target.data();");
+        text_.add_line("events." + weight + " = event_weight.data();");
+        text_.add_line("events.size = n;");
+        text_.add_line("start = clock_type::now();");
+        text_.add_line("mech.deliver_events(events);");
+        text_.add_line("auto event_time = seconds(clock_type::now()-start);");
+        text_.add_line();
+    }
+    text_.add_line("perf_counters counters;");
+    text_.add_line("std::vector<std::uint64_t> before, after;");
+    text_.add_line("std::vector<std::uint64_t> current_counts(counters.size(), 0);");
+    text_.add_line("std::vector<std::uint64_t> state_counts(counters.size(), 0);");
+    text_.add_line("auto accumulate = [&before, &after] (std::vector<std::uint64_t>& counts) {");
+    text_.add_line("    for(std::size_t i=0; i<counts.size(); ++i) counts[i] += after[i]-before[i];");
+    text_.add_line("};");
+    text_.add_line();
+    text_.add_line("double current_time = 0;");
+    text_.add_line("double state_time = 0;");
+    text_.add_line("for(int step=0; step<num_steps; ++step) {");
+    text_.increase_indentation();
+    text_.add_line("mech.set_params(step*dt, dt);");
+    text_.add_line();
+    text_.add_line("counters.read(before);");
+    text_.add_line("auto t0 = clock_type::now();");
+    text_.add_line(call("nrn_current"));
+    text_.add_line("auto t1 = clock_type::now();");
+    text_.add_line("counters.read(after);");
+    text_.add_line("current_time += seconds(t1-t0);");
+    text_.add_line("accumulate(current_counts);");
+    text_.add_line();
+    text_.add_line("counters.read(before);");
+    text_.add_line("t0 = clock_type::now();");
+    text_.add_line(call("nrn_state"));
+    text_.add_line("t1 = clock_type::now();");
+    text_.add_line("counters.read(after);");
+    text_.add_line("state_time += seconds(t1-t0);");
+    text_.add_line("accumulate(state_counts);");
+    text_.decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
+
+    text_.add_line("// the checksum depends on the output of every kernel, so that the results");
+    text_.add_line("// of different code generation options can be compared");
+    text_.add_line("double checksum = 0;");
+    text_.add_line("for(auto x: vec_i) checksum += x;");
+    text_.add_line("for(auto x: vec_g) checksum += x;");
+    for(auto const& ion: ions) {
+        if(!uses_ion(ion.kind)) continue;
+        text_.add_line("for(auto x: " + std::string(ion.name) + "_current) checksum += x;");
+    }
+    text_.add_line();
+
+    text_.add_line("auto per_instance = [n] (double t, int steps) {");
+    text_.add_line("    return n && steps ? 1e9*t/(double(n)*steps) : 0.;");
+    text_.add_line("};");
+    text_.add_line("std::printf(\"mechanism    %s\\n\", \"" + name + "\");");
+    text_.add_line("std::printf(\"instances    %d\\n\", n);");
+    text_.add_line("std::printf(\"steps        %d\\n\", num_steps);");
+    text_.add_line("std::printf(\"threads      %d\\n\", num_threads);");
+    text_.add_line("std::printf(\"nrn_init     %10.3f ns/instance\\n\", per_instance(init_time, 1));");
+    if(has_events) {
+        text_.add_line("std::printf(\"events       %10.3f ns/event\\n\", per_instance(event_time, 1));");
+    }
+    text_.add_line("std::printf(\"nrn_current  %10.3f ns/instance/step\\n\", per_instance(current_time, num_steps));");
+    text_.add_line("std::printf(\"nrn_state    %10.3f ns/instance/step\\n\", per_instance(state_time, num_steps));");
+    text_.add_line("std::printf(\"total        %10.3f ns/instance/step\\n\", per_instance(current_time+state_time, num_steps));");
+    text_.add_line("std::printf(\"checksum     %.17g\\n\", checksum);");
+    text_.add_line();
+
+    // the operation counts and memory traffic of the kernels, as estimated by
+    // the same visitors that are used in analysis mode
+    auto flops = [this] (std::string const& method) {
+        auto e = module_->symbols()[method]->is_api_method();
+        auto v = make_unique<FlopVisitor>();
+        e->accept(v.get());
+        return v->flops.total();
+    };
+    auto bytes = [this] (std::string const& method) {
+        auto e = module_->symbols()[method]->is_api_method();
+        auto v = make_unique<MemOpVisitor>();
+        e->accept(v.get());
+        return v->bytes_per_instance();
+    };
+    text_.add_line("// operations and bytes per instance for each kernel, estimated by modcc,");
+    text_.add_line("// where each call to a math function counts as one operation");
+    text_.add_gutter() << "const double current_flops = " << flops("nrn_current") << ";";
+    text_.end_line();
+    text_.add_gutter() << "const double current_bytes = " << bytes("nrn_current") << ";";
+    text_.end_line();
+    text_.add_gutter() << "const double state_flops = " << flops("nrn_state") << ";";
+    text_.end_line();
+    text_.add_gutter() << "const double state_bytes = " << bytes("nrn_state") << ";";
+    text_.end_line();
+    text_.add_line();
+
+    text_.add_line("auto report = [&] (const char* kernel, double time, double flops, double bytes,");
+    text_.add_line("                   std::vector<std::uint64_t> const& counts)");
+    text_.add_line("{");
+    text_.increase_indentation();
+    text_.add_line("double instances = double(n)*num_steps;");
+    text_.add_line("if(!instances || !time) return;");
+    text_.add_line("std::printf(\"\\n%s\\n\", kernel);");
+    text_.add_line("std::printf(\"  %-14s %12.3f /instance %10.3f GFLOP/s\\n\", \"flops\", flops, 1e-9*flops*instances/time);");
+    text_.add_line("std::printf(\"  %-14s %12.3f /instance %10.3f GB/s\\n\", \"bytes (model)\", bytes, 1e-9*bytes*instances/time);");
+    text_.add_line("for(std::size_t i=0; i<counts.size(); ++i) {");
+    text_.add_line("    std::printf(\"  %-14s %12.3f /instance\\n\", counters.name(i).c_str(), counts[i]/instances);");
+    text_.add_line("}");
+    text_.add_line("auto cycles = counters.find(\"cycles\");");
+    text_.add_line("auto instructions = counters.find(\"instructions\");");
+    text_.add_line("if(cycles>=0 && instructions>=0 && counts[cycles]) {");
+    text_.add_line("    std::printf(\"  %-14s %12.3f\\n\", \"IPC\", double(counts[instructions])/counts[cycles]);");
+    text_.add_line("}");
+    text_.add_line("auto scalar = counters.find(\"scalar\");");
+    text_.add_line("if(scalar>=0) {");
+    text_.add_line("    double vector = 0;");
+    text_.add_line("    for(auto width: {\"sse\", \"avx2\", \"avx512\"}) {");
+    text_.add_line("        auto i = counters.find(width);");
+    text_.add_line("        if(i>=0) vector += counts[i];");
+    text_.add_line("    }");
+    text_.add_line("    if(counts[scalar]+vector) {");
+    text_.add_line("        std::printf(\"  %-14s %12.3f\\n\", \"vector share\", vector/(counts[scalar]+vector));");
+    text_.add_line("    }");
+    text_.add_line("}");
+    text_.add_line("auto llc = counters.find(\"LLC_misses\");");
+    text_.add_line("if(llc>=0) {");
+    text_.add_line("    std::printf(\"  %-14s %12.3f /instance\\n\", \"LLC bytes\", 64.*counts[llc]/instances);");
+    text_.add_line("}");
+    text_.decrease_indentation();
+    text_.add_line("};");
+    text_.add_line("report(\"nrn_current\", current_time, current_flops, current_bytes, current_counts);");
+    text_.add_line("report(\"nrn_state\", state_time, state_flops, state_bytes, state_counts);");
+    text_.add_line("if(!counters.size()) {");
+    text_.add_line("    std::printf(\"\\nhardware counters are not available\\n\");");
+    text_.add_line("}");
+    if(options_.threads) {
+        text_.add_line("else if(num_threads>1) {");
+        text_.add_line("    std::printf(\"\\nhardware counters only count the calling thread\\n\");");
+        text_.add_line("}");
+    }
+    text_.add_line("if(counters.size() && counters.find(\"scalar\")<0) {");
+    text_.add_line("    std::printf(\"\\nscalar and vector instruction counts are only read on Intel processors,\\n\"");
+    text_.add_line("                \"or with the raw events given in MODCC_PERF_RAW\\n\");");
+    text_.add_line("}");
+    text_.add_line();
+    text_.add_line("return 0;");
+    text_.decrease_indentation();
+    text_.add_line("}");
+}
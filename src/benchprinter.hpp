@@ -0,0 +1,25 @@
+#pragma once
+
+#include "cprinter.hpp"
+#include "module.hpp"
+#include "textbuffer.hpp"
+
+/// Prints a self contained benchmark for a mechanism: the mechanism as
+/// printed by CPrinter, followed by a main() that runs its kernels on the
+/// instances listed in a .nodes file and reports the time per instance.
+/// The benchmark is compiled against the stand-in runtime in tests/bench/runtime.
+class BenchPrinter {
+public:
+    BenchPrinter(Module &m, CPrinterOptions const& opts);
+
+    std::string text() const {
+        return text_.str();
+    }
+
+private:
+    void print_driver();
+
+    Module *module_ = nullptr;
+    CPrinterOptions options_;
+    TextBuffer text_;
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <map>
 #include <string>
 #include <vector>
 
@@ -43,6 +44,8 @@ struct NeuronBlock {
 // information stored in a NEURON {} block in mod file
 struct StateBlock {
     std::vector<std::string> state_variables;
+    // optional tolerance annotations, e.g. m <1e-4>, stored as strings
+    std::map<std::string, std::string> tolerances;
     auto begin() -> decltype(state_variables.begin()) {
         return state_variables.begin();
     }
@@ -62,6 +65,7 @@ struct Id {
     Token token;
     std::string value; // store the value as a string, not a number : empty string == no value
     unit_tokens units;
+    std::string tolerance; // tolerance annotation <tol> : empty string == no annotation
 
     Id(Token const& t, std::string const& v, unit_tokens const& u)
         : token(t), value(v), units(u)
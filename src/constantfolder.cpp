@@ -50,6 +50,10 @@ void ConstantFolderVisitor::visit(UnaryExpression *e) {
             case tok::log :
                 value = std::log(value);
                 return;
+            // lookups in tables are not folded
+            case tok::table :
+                is_number = false;
+                return;
             default :
                 throw compiler_exception(
                     "attempting constant folding on unsuported unary operator "
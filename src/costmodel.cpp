@@ -0,0 +1,279 @@
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "costmodel.hpp"
+#include "expression.hpp"
+#include "perfvisitor.hpp"
+#include "util.hpp"
+
+std::string to_string(costOp op) {
+    switch(op) {
+        case costOp::add     : return "add";
+        case costOp::mul     : return "mul";
+        case costOp::fma     : return "fma";
+        case costOp::div     : return "div";
+        case costOp::sqrt    : return "sqrt";
+        case costOp::exp     : return "exp";
+        case costOp::log     : return "log";
+        case costOp::pow     : return "pow";
+        case costOp::gather  : return "gather";
+        case costOp::scatter : return "scatter";
+    }
+    return "unknown";
+}
+
+/******************************************************************************
+                              CostModel
+******************************************************************************/
+
+// {latency, reciprocal throughput} in cycles, for a vector of doubles, in the
+// order of costOp:
+//   add, mul, fma, div, sqrt, exp, log, pow, gather, scatter
+// Haswell and Zen2 have no scatter instruction, so a scatter is a sequence of
+// extracts and scalar stores.
+static const CostModel cost_models[] = {
+    {"haswell", 4, {
+        {3, 1}, {5, 0.5}, {5, 0.5}, {35, 27}, {35, 28},
+        {40, 20}, {45, 24}, {100, 50}, {20, 8}, {10, 6}}},
+    {"skylake-x", 8, {
+        {4, 0.5}, {4, 0.5}, {4, 0.5}, {23, 16}, {31, 24},
+        {30, 16}, {35, 20}, {80, 40}, {22, 5}, {20, 11}}},
+    {"zen2", 4, {
+        {3, 0.5}, {3, 0.5}, {5, 0.5}, {13, 5}, {20, 9},
+        {40, 20}, {45, 24}, {100, 50}, {25, 9}, {10, 8}}},
+};
+
+CostModel const* CostModel::find(std::string const& name) {
+    for(auto const& m : cost_models) {
+        if(m.name==name) return &m;
+    }
+    return nullptr;
+}
+
+std::vector<std::string> CostModel::targets() {
+    std::vector<std::string> names;
+    for(auto const& m : cost_models) {
+        names.push_back(m.name);
+    }
+    return names;
+}
+
+/******************************************************************************
+                              CostVisitor
+******************************************************************************/
+
+void CostVisitor::operation(costOp op, double operands) {
+    count_[int(op)]++;
+    latency_ = operands + model_[op].latency;
+}
+
+// variables are looked up by name, so the times at which they are ready are
+// only valid in the procedure that assigned them
+void CostVisitor::visit(APIMethod *e) {
+    ready_.clear();
+    e->body()->accept(this);
+}
+
+void CostVisitor::visit(ProcedureExpression *e) {
+    ready_.clear();
+    e->body()->accept(this);
+}
+
+void CostVisitor::visit(FunctionExpression *e) {
+    ready_.clear();
+    e->body()->accept(this);
+}
+
+void CostVisitor::visit(BlockExpression *e) {
+    for(auto& expression : *e) {
+        expression->accept(this);
+    }
+}
+
+void CostVisitor::visit(IfExpression *e) {
+    e->condition()->accept(this);
+    e->true_branch()->accept(this);
+    if(e->false_branch()) {
+        e->false_branch()->accept(this);
+    }
+}
+
+// the body of the procedure starts when all of the arguments are ready
+// the callee has its own scope: the variables of the caller are hidden from
+// it, and are restored after the call
+void CostVisitor::visit(CallExpression *e) {
+    double start = 0;
+    for(auto& arg : e->args()) {
+        start = std::max(start, latency_of(arg.get()));
+    }
+    if(auto proc = e->procedure()) {
+        auto path = critical_path_;
+        critical_path_ = 0;
+        decltype(ready_) caller;
+        std::swap(caller, ready_);
+        proc->body()->accept(this);
+        std::swap(caller, ready_);
+        latency_ = start + critical_path_;
+        critical_path_ = std::max(path, latency_);
+    }
+}
+
+void CostVisitor::visit(NumberExpression *e) {
+    latency_ = 0;
+}
+
+void CostVisitor::visit(IdentifierExpression *e) {
+    auto it = ready_.find(e->spelling());
+    if(it!=ready_.end()) {
+        latency_ = it->second;
+        return;
+    }
+    // values that are loaded from indexed arrays are ready after a gather
+    latency_ = 0;
+    if(auto s = e->symbol()) {
+        auto l = s->is_local_variable();
+        if(s->is_indexed_variable() || (l && l->is_indexed() && l->is_read())) {
+            latency_ = model_[costOp::gather].latency;
+        }
+    }
+}
+
+void CostVisitor::visit(UnaryExpression *e) {
+    latency_of(e->expression());
+}
+
+void CostVisitor::visit(NegUnaryExpression *e) {
+    operation(costOp::add, latency_of(e->expression()));
+}
+
+void CostVisitor::visit(ExpUnaryExpression *e) {
+    operation(costOp::exp, latency_of(e->expression()));
+}
+
+void CostVisitor::visit(LogUnaryExpression *e) {
+    operation(costOp::log, latency_of(e->expression()));
+}
+
+void CostVisitor::visit(SinUnaryExpression *e) {
+    operation(costOp::exp, latency_of(e->expression()));
+}
+
+void CostVisitor::visit(CosUnaryExpression *e) {
+    operation(costOp::exp, latency_of(e->expression()));
+}
+
+// a lookup computes the position in the table, gathers the two entries
+// around it, and interpolates between them
+void CostVisitor::visit(TableLookupExpression *e) {
+    operation(costOp::fma, latency_of(e->expression()));
+    operation(costOp::gather, latency_);
+    operation(costOp::fma, latency_);
+}
+
+// comparisons cost as much as an add
+void CostVisitor::visit(BinaryExpression *e) {
+    auto l = latency_of(e->lhs());
+    auto r = latency_of(e->rhs());
+    operation(costOp::add, std::max(l, r));
+}
+
+void CostVisitor::visit(AssignmentExpression *e) {
+    auto t = latency_of(e->rhs());
+    if(auto id = e->lhs()->is_identifier()) {
+        ready_[id->spelling()] = t;
+    }
+    critical_path_ = std::max(critical_path_, t);
+}
+
+// an add with a multiply as one of its operands is fused into an fma
+void CostVisitor::additive(BinaryExpression* e) {
+    auto mul = e->lhs()->is_binary();
+    auto other = e->rhs();
+    if(!mul || mul->op()!=tok::times) {
+        mul = e->rhs()->is_binary();
+        other = e->lhs();
+    }
+    if(mul && mul->op()==tok::times) {
+        auto a = latency_of(mul->lhs());
+        auto b = latency_of(mul->rhs());
+        auto c = latency_of(other);
+        operation(costOp::fma, std::max({a, b, c}));
+        return;
+    }
+    auto l = latency_of(e->lhs());
+    auto r = latency_of(e->rhs());
+    operation(costOp::add, std::max(l, r));
+}
+
+void CostVisitor::visit(AddBinaryExpression *e) {
+    additive(e);
+}
+
+void CostVisitor::visit(SubBinaryExpression *e) {
+    additive(e);
+}
+
+void CostVisitor::visit(MulBinaryExpression *e) {
+    auto l = latency_of(e->lhs());
+    auto r = latency_of(e->rhs());
+    operation(costOp::mul, std::max(l, r));
+}
+
+void CostVisitor::visit(DivBinaryExpression *e) {
+    auto l = latency_of(e->lhs());
+    auto r = latency_of(e->rhs());
+    operation(costOp::div, std::max(l, r));
+}
+
+void CostVisitor::visit(PowBinaryExpression *e) {
+    auto l = latency_of(e->lhs());
+    auto r = latency_of(e->rhs());
+    operation(costOp::pow, std::max(l, r));
+}
+
+/******************************************************************************
+                              estimates
+******************************************************************************/
+
+CostEstimate estimate_cost(APIMethod* method, CostModel const& model) {
+    CostVisitor cost(model);
+    method->accept(&cost);
+    MemOpVisitor memops;
+    method->accept(&memops);
+
+    CostEstimate c;
+    for(auto i=0; i<num_cost_ops; ++i) {
+        c.count[i] = cost.count(costOp(i));
+    }
+    c.count[int(costOp::gather)]  = memops.indexed_reads().size();
+    c.count[int(costOp::scatter)] = memops.indexed_writes().size();
+
+    // each vector instruction processes vector_width instances
+    for(auto i=0; i<num_cost_ops; ++i) {
+        c.cycles_per_instance += c.count[i]*model.ops[i].throughput;
+    }
+    c.cycles_per_instance /= model.vector_width;
+    c.critical_path = cost.critical_path();
+
+    return c;
+}
+
+std::string cost_report(CostEstimate const& c, CostModel const& model) {
+    std::stringstream s;
+    s << "target    " << model.name << std::endl;
+
+    auto w = std::setw(8);
+    s << "          " << w << "count" << w << "cycles" << std::endl;
+    for(auto i=0; i<num_cost_ops; ++i) {
+        if(!c.count[i]) continue;
+        s << std::left << std::setw(10) << to_string(costOp(i)) << std::right
+          << w << c.count[i]
+          << w << std::fixed << std::setprecision(2)
+          << c.count[i]*model.ops[i].throughput/model.vector_width << std::endl;
+    }
+    s << "cycles    " << w << c.cycles_per_instance << " /instance (vectorized)" << std::endl;
+    s << "latency   " << w << c.critical_path << " cycles on the critical path" << std::endl;
+
+    return s.str();
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "visitor.hpp"
+
+/// classes of operations in generated kernels that have distinct costs
+enum class costOp {
+    add,        // add, subtract, negate and compare
+    mul,
+    fma,        // a multiply that is an operand of an add or subtract
+    div,
+    sqrt,
+    exp,        // exp, sin and cos
+    log,
+    pow,
+    gather,     // load of an indexed array
+    scatter     // store to an indexed array
+};
+
+constexpr int num_cost_ops = 10;
+
+std::string to_string(costOp op);
+
+/// the cost of one vector instruction, or one call to a vector math function
+struct OpCost {
+    double latency;     // cycles until the result can be used
+    double throughput;  // reciprocal throughput: cycles between independent instructions
+};
+
+/// Instruction costs of a target.
+/// The tables are approximate values for double precision vector
+/// instructions from published instruction tables, and for the vector math
+/// library calls used for the transcendental functions.
+struct CostModel {
+    std::string name;
+    // number of doubles in a vector register
+    int vector_width;
+    OpCost ops[num_cost_ops];
+
+    OpCost const& operator[](costOp op) const {
+        return ops[int(op)];
+    }
+
+    /// the cost model of a target, or nullptr if there is no table for it
+    static CostModel const* find(std::string const& name);
+
+    /// the names of the targets with a table
+    static std::vector<std::string> targets();
+};
+
+/// the operations in one instance of a kernel, and the cost of the kernel
+struct CostEstimate {
+    int count[num_cost_ops] = {0};
+    // cycles per instance if the kernel is vectorized and limited by the
+    // throughput of the execution units
+    double cycles_per_instance = 0;
+    // the latency of the longest chain of dependent operations in the body,
+    // which is the cost of an instance if iterations do not overlap
+    double critical_path = 0;
+};
+
+/// Counts the operations in an API method, procedure or function by cost
+/// class, and finds the longest chain of dependent operations.
+/// Like the FlopVisitor, both branches of an if statement are counted, and
+/// the operations of a procedure are counted for every call.
+/// Indexed loads and stores are not counted, they are added by estimate_cost
+/// from the MemOpVisitor.
+class CostVisitor : public Visitor {
+public:
+    explicit CostVisitor(CostModel const& model)
+    :   model_(model)
+    {}
+
+    void visit(Expression *e)            override {}
+    void visit(APIMethod *e)             override;
+    void visit(ProcedureExpression *e)   override;
+    void visit(FunctionExpression *e)    override;
+    void visit(BlockExpression *e)       override;
+    void visit(IfExpression *e)          override;
+    void visit(CallExpression *e)        override;
+    void visit(NumberExpression *e)      override;
+    void visit(IdentifierExpression *e)  override;
+    void visit(UnaryExpression *e)       override;
+    void visit(NegUnaryExpression *e)    override;
+    void visit(ExpUnaryExpression *e)    override;
+    void visit(LogUnaryExpression *e)    override;
+    void visit(SinUnaryExpression *e)    override;
+    void visit(CosUnaryExpression *e)    override;
+    void visit(TableLookupExpression *e) override;
+    void visit(BinaryExpression *e)      override;
+    void visit(AssignmentExpression *e)  override;
+    void visit(AddBinaryExpression *e)   override;
+    void visit(SubBinaryExpression *e)   override;
+    void visit(MulBinaryExpression *e)   override;
+    void visit(DivBinaryExpression *e)   override;
+    void visit(PowBinaryExpression *e)   override;
+
+    int count(costOp op) const {
+        return count_[int(op)];
+    }
+
+    double critical_path() const {
+        return critical_path_;
+    }
+
+private:
+    // latency of the expression after counting its operations
+    double latency_of(Expression* e) {
+        e->accept(this);
+        return latency_;
+    }
+    void operation(costOp op, double operands);
+    void additive(BinaryExpression* e);
+
+    CostModel const& model_;
+    int count_[num_cost_ops] = {0};
+    // the latency of the last expression that was visited
+    double latency_ = 0;
+    double critical_path_ = 0;
+    // the time at which the value assigned to a variable is ready, in the
+    // scope of the procedure that is being visited
+    std::map<std::string, double> ready_;
+};
+
+/// count the operations in an API method, and estimate its cost per instance
+CostEstimate estimate_cost(APIMethod* method, CostModel const& model);
+
+/// a short human readable report of the estimate
+std::string cost_report(CostEstimate const& c, CostModel const& model);
@@ -1,4 +1,7 @@
 #include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
 
 #include "cprinter.hpp"
 #include "lexer.hpp"
@@ -7,17 +10,805 @@
                               CPrinter driver
 ******************************************************************************/
 
+// the smallest tolerance for which a field may be stored in single precision
+// the tolerance is an absolute error, and single precision has a relative
+// error of about 6e-8, so this leaves a margin for fields of order 1, e.g.
+// gating variables
+constexpr double single_precision_tolerance = 1e-6;
+
+// a field can be stored in single precision if its tolerance annotation is
+// loose enough, and if it is either a state or a read only parameter
+static bool is_single_precision(VariableExpression* var) {
+    if(!var->is_range() || !var->has_tolerance()) return false;
+    if(!var->is_state() && var->access()!=accessKind::read) return false;
+
+    auto tol = var->tolerance();
+    if(tol < single_precision_tolerance) return false;
+
+    // the rounding error of the default value has to be within tolerance
+    auto val = var->value();
+    if(val==val && std::fabs(val)*std::numeric_limits<float>::epsilon() > tol) {
+        return false;
+    }
+    return true;
+}
+
+static CPrinterOptions default_options(bool optimize) {
+    CPrinterOptions opts;
+    opts.optimize = optimize;
+    return opts;
+}
+
+// Fork-join pool of worker threads used by the parallel entry points.
+// It is printed once at the top of every generated header that uses it, so
+// it is guarded against multiple definition when several headers are included.
+static const char* thread_pool_source = R"(#ifndef MODCC_THREAD_POOL
+#define MODCC_THREAD_POOL
+namespace modcc {
+
+// the first instance of part k, when n instances are split into
+// num_parts contiguous parts of (almost) equal size
+inline int partition_begin(int n, int num_parts, int k) {
+    return static_cast<int>((static_cast<long long>(n)*k)/num_parts);
+}
+
+// a minimal pool of worker threads that is shared by all mechanisms
+class thread_pool {
+public:
+    static thread_pool& instance() {
+        static thread_pool pool;
+        return pool;
+    }
+
+    // call f(k) for k in [0, num_tasks), and return when all tasks have
+    // finished. Task 0 is run on the calling thread and task k on worker k-1,
+    // so that the same range of instances is always handled by the same
+    // thread, which keeps the pages first touched by that thread local to it.
+    void run(int num_tasks, std::function<void(int)> const& f) {
+        std::lock_guard<std::mutex> guard(run_mutex_);
+        if(num_tasks<=1) {
+            if(num_tasks==1) f(0);
+            return;
+        }
+        while(int(workers_.size())<num_tasks-1) {
+            int w = workers_.size();
+            unsigned g = generation_;
+            workers_.emplace_back([this, w, g] {work(w, g);});
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            task_ = &f;
+            num_tasks_ = num_tasks;
+            pending_ = num_tasks-1;
+            ++generation_;
+        }
+        wake_.notify_all();
+        f(0);
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] {return pending_==0;});
+        task_ = nullptr;
+    }
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            quit_ = true;
+        }
+        wake_.notify_all();
+        for(auto& t: workers_) t.join();
+    }
+
+private:
+    void work(int w, unsigned seen) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while(true) {
+            wake_.wait(lock, [this, seen] {return quit_ || generation_!=seen;});
+            if(quit_) return;
+            seen = generation_;
+            if(w+1<num_tasks_) {
+                auto f = task_;
+                lock.unlock();
+                (*f)(w+1);
+                lock.lock();
+                if(--pending_==0) done_.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::mutex run_mutex_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::function<void(int)> const* task_ = nullptr;
+    int num_tasks_ = 0;
+    int pending_ = 0;
+    unsigned generation_ = 0;
+    bool quit_ = false;
+};
+
+// split [0, n) into num_threads contiguous ranges and call f(begin, end)
+// for each range on its own thread
+template <typename F>
+void parallel_for_ranges(int n, int num_threads, F&& f) {
+    num_threads = std::max(1, std::min(num_threads, n));
+    std::function<void(int)> task = [&](int k) {
+        f(partition_begin(n, num_threads, k), partition_begin(n, num_threads, k+1));
+    };
+    thread_pool::instance().run(num_threads, task);
+}
+
+} // namespace modcc
+#endif)";
+
+// Multi-ISA kernels are only generated for x86 compilers that support the
+// target attribute and __builtin_cpu_supports, otherwise the generic kernel
+// is used. Defining MODCC_X86_DISPATCH=0 also disables them.
+static const char* isa_dispatch_source = R"(#ifndef MODCC_X86_DISPATCH
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define MODCC_X86_DISPATCH 1
+#else
+#define MODCC_X86_DISPATCH 0
+#endif
+#endif)";
+
+// the instruction sets for which kernels are generated, in order of
+// preference, with the target attribute and the run time test for each
+struct isa_target {
+    const char* suffix;
+    const char* target;
+    const char* condition;
+};
+
+static const isa_target isa_targets[] = {
+    {"avx512", "avx512f,avx512cd,avx2,fma",
+               "__builtin_cpu_supports(\"avx512f\") && __builtin_cpu_supports(\"avx512cd\")"},
+    {"avx2",   "avx2,fma",
+               "__builtin_cpu_supports(\"avx2\") && __builtin_cpu_supports(\"fma\")"},
+    {"sse42",  "sse4.2",
+               "__builtin_cpu_supports(\"sse4.2\")"},
+};
+
+// Per-kernel instrumentation, compiled in when the generated code is built
+// with MODCC_PROFILE defined, and empty otherwise.
+// Every kernel counts its calls, the instances it processed and the time it
+// took in a registry that is shared by all mechanisms. The registry is written
+// at exit to the file in MODCC_PROFILE_OUTPUT (JSON if the name ends in .json,
+// CSV otherwise), or to stderr.
+static const char* profile_source = R"(#ifndef MODCC_PROFILE_REGISTRY
+#define MODCC_PROFILE_REGISTRY
+#ifdef MODCC_PROFILE
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+namespace modcc {
+namespace profile {
+
+// time stamp counter cycles on x86, nanoseconds elsewhere
+#if defined(__x86_64__) || defined(__i386__)
+inline unsigned long long ticks() { return __rdtsc(); }
+inline const char* tick_unit() { return "tsc"; }
+#else
+inline unsigned long long ticks() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+inline const char* tick_unit() { return "ns"; }
+#endif
+
+struct kernel_record {
+    const char* mechanism;
+    const char* kernel;
+    std::atomic<unsigned long long> calls;
+    std::atomic<unsigned long long> instances;
+    std::atomic<unsigned long long> ticks;
+    kernel_record* next;
+};
+
+// records are pushed on a lock free list when a kernel is first called, and
+// are owned by the registry, which writes them out when it is destroyed at exit
+class registry {
+public:
+    static registry& instance() {
+        static registry r;
+        return r;
+    }
+
+    kernel_record* add(const char* mechanism, const char* kernel) {
+        auto r = new kernel_record{mechanism, kernel, {0}, {0}, {0}, nullptr};
+        r->next = head_.load();
+        while(!head_.compare_exchange_weak(r->next, r));
+        return r;
+    }
+
+    void write(std::FILE* f, bool json) const {
+        if(json) std::fprintf(f, "{\"tick_unit\": \"%s\", \"kernels\": [", tick_unit());
+        else     std::fprintf(f, "mechanism,kernel,calls,instances,ticks\n");
+        bool first = true;
+        for(auto r = head_.load(); r; r = r->next) {
+            auto fmt = json
+                ? "%s\n  {\"mechanism\": \"%s\", \"kernel\": \"%s\", \"calls\": %llu, \"instances\": %llu, \"ticks\": %llu}"
+                : "%s%s,%s,%llu,%llu,%llu\n";
+            std::fprintf(f, fmt, (json && !first) ? "," : "", r->mechanism, r->kernel,
+                         r->calls.load(), r->instances.load(), r->ticks.load());
+            first = false;
+        }
+        if(json) std::fprintf(f, "\n]}\n");
+    }
+
+    ~registry() {
+        auto name = std::getenv("MODCC_PROFILE_OUTPUT");
+        auto f = name ? std::fopen(name, "w") : stderr;
+        if(f) {
+            auto n = name ? std::strlen(name) : 0;
+            write(f, n>5 && std::strcmp(name+n-5, ".json")==0);
+            if(f!=stderr) std::fclose(f);
+        }
+        for(auto r = head_.load(); r;) {
+            auto next = r->next;
+            delete r;
+            r = next;
+        }
+    }
+
+private:
+    std::atomic<kernel_record*> head_{nullptr};
+};
+
+// adds the time between construction and destruction to a record
+class kernel_timer {
+public:
+    kernel_timer(kernel_record* r, int n): record_(r), start_(ticks()) {
+        record_->calls.fetch_add(1, std::memory_order_relaxed);
+        record_->instances.fetch_add(n, std::memory_order_relaxed);
+    }
+    ~kernel_timer() {
+        record_->ticks.fetch_add(ticks()-start_, std::memory_order_relaxed);
+    }
+private:
+    kernel_record* record_;
+    unsigned long long start_;
+};
+
+} // namespace profile
+} // namespace modcc
+#define MODCC_PROFILE_KERNEL(mechanism, kernel, n) \
+    static ::modcc::profile::kernel_record* modcc_record_ = \
+        ::modcc::profile::registry::instance().add(mechanism, kernel); \
+    ::modcc::profile::kernel_timer modcc_timer_(modcc_record_, n)
+#else
+#define MODCC_PROFILE_KERNEL(mechanism, kernel, n)
+#endif
+#endif)";
+
+// Capture of the arrays read and written by kernels, compiled in when the
+// generated code is built with MODCC_CAPTURE defined, and empty otherwise.
+// The calls listed in MODCC_CAPTURE_CALLS, a comma separated list of call
+// numbers that are counted from 0 for each kernel of each mechanism, are
+// written to a binary trace in MODCC_CAPTURE_DIR (default the working
+// directory), which can be replayed by the driver printed for the replay target.
+static const char* capture_source = R"(#ifndef MODCC_CAPTURE_TRACE
+#define MODCC_CAPTURE_TRACE
+#ifdef MODCC_CAPTURE
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+namespace modcc {
+namespace capture {
+
+enum array_kind : std::uint32_t {field = 0, indexed = 1, scalar = 2};
+
+// the values of an array of a mechanism before and after a kernel, where
+// indexed arrays are stored as seen by the instances through their index
+struct array {
+    std::string name;
+    std::uint32_t kind;
+    std::vector<double> before;
+    std::vector<double> after;
+};
+
+// one call of a kernel
+struct trace {
+    std::string mechanism;
+    std::string kernel;
+    std::uint64_t call = 0;
+    std::vector<std::int64_t> node_index;
+    std::vector<array> arrays;
+
+    array const* find(std::string const& name) const {
+        for(auto const& a: arrays) {
+            if(a.name==name) return &a;
+        }
+        return nullptr;
+    }
+};
+
+// traces are stored in host byte order:
+//   "MODCCTR1" mechanism kernel call node_index num_arrays
+//   {name kind before after}...
+// where strings and vectors are prefixed by their size as a 64 bit integer
+template <typename T>
+void write_value(std::ostream& o, T const& v) {
+    o.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+template <typename T>
+void write_vector(std::ostream& o, std::vector<T> const& v) {
+    write_value(o, std::uint64_t(v.size()));
+    o.write(reinterpret_cast<const char*>(v.data()), v.size()*sizeof(T));
+}
+
+inline void write_string(std::ostream& o, std::string const& s) {
+    write_value(o, std::uint64_t(s.size()));
+    o.write(s.data(), s.size());
+}
+
+template <typename T>
+void read_value(std::istream& i, T& v) {
+    i.read(reinterpret_cast<char*>(&v), sizeof(T));
+}
+
+template <typename T>
+void read_vector(std::istream& i, std::vector<T>& v) {
+    std::uint64_t n = 0;
+    read_value(i, n);
+    v.clear();
+    T x;
+    while(i && v.size()<n) {
+        read_value(i, x);
+        v.push_back(x);
+    }
+}
+
+inline void read_string(std::istream& i, std::string& s) {
+    std::uint64_t n = 0;
+    read_value(i, n);
+    s.clear();
+    char c;
+    while(i && s.size()<n && i.get(c)) s += c;
+}
+
+inline bool write(trace const& t, std::string const& filename) {
+    std::ofstream o(filename, std::ios::binary);
+    o.write("MODCCTR1", 8);
+    write_string(o, t.mechanism);
+    write_string(o, t.kernel);
+    write_value(o, t.call);
+    write_vector(o, t.node_index);
+    write_value(o, std::uint64_t(t.arrays.size()));
+    for(auto const& a: t.arrays) {
+        write_string(o, a.name);
+        write_value(o, a.kind);
+        write_vector(o, a.before);
+        write_vector(o, a.after);
+    }
+    return bool(o);
+}
+
+inline bool read(trace& t, std::string const& filename) {
+    std::ifstream i(filename, std::ios::binary);
+    char magic[8];
+    if(!i.read(magic, 8) || std::string(magic, 8)!="MODCCTR1") return false;
+    read_string(i, t.mechanism);
+    read_string(i, t.kernel);
+    read_value(i, t.call);
+    read_vector(i, t.node_index);
+    std::uint64_t n = 0;
+    read_value(i, n);
+    t.arrays.clear();
+    while(i && t.arrays.size()<n) {
+        array a;
+        read_string(i, a.name);
+        read_value(i, a.kind);
+        read_vector(i, a.before);
+        read_vector(i, a.after);
+        t.arrays.push_back(std::move(a));
+    }
+    return bool(i);
+}
+
+// copies the arrays listed by the capture_arrays member of a mechanism into a
+// trace, first before the kernel and then, in the same order, after it
+class gather {
+public:
+    gather(trace& t, bool after): trace_(t), after_(after) {}
+
+    template <typename Index>
+    void nodes(Index const& index) {
+        if(after_) return;
+        trace_.node_index.resize(index.size());
+        for(std::size_t i=0; i<index.size(); ++i) trace_.node_index[i] = index[i];
+    }
+
+    template <typename T>
+    void field(const char* name, T const* p, std::size_t n) {
+        values(name, array_kind::field).assign(p, p+n);
+    }
+
+    template <typename View, typename Index>
+    void indexed(const char* name, View const& v, Index const& index) {
+        auto& x = values(name, array_kind::indexed);
+        x.resize(index.size());
+        for(std::size_t i=0; i<x.size(); ++i) x[i] = v[index[i]];
+    }
+
+    template <typename T>
+    void scalar(const char* name, T const& v) {
+        values(name, array_kind::scalar).assign(1, double(v));
+    }
+
+private:
+    std::vector<double>& values(const char* name, std::uint32_t kind) {
+        if(after_) return trace_.arrays[next_++].after;
+        trace_.arrays.push_back(array{name, kind, {}, {}});
+        return trace_.arrays.back().before;
+    }
+
+    trace& trace_;
+    bool after_;
+    std::size_t next_ = 0;
+};
+
+// writes the values of a trace before the kernel into the arrays of a
+// mechanism, the names of the arrays that are not in the trace, or have a
+// different size, are recorded in missing
+class scatter {
+public:
+    explicit scatter(trace const& t): trace_(t) {}
+
+    template <typename Index>
+    void nodes(Index const&) {}
+
+    template <typename T>
+    void field(const char* name, T* p, std::size_t n) {
+        if(auto a = find(name, n)) std::copy(a->before.begin(), a->before.end(), p);
+    }
+
+    template <typename View, typename Index>
+    void indexed(const char* name, View& v, Index const& index) {
+        if(auto a = find(name, index.size())) {
+            for(std::size_t i=0; i<index.size(); ++i) v[index[i]] = a->before[i];
+        }
+    }
+
+    template <typename T>
+    void scalar(const char* name, T& v) {
+        if(auto a = find(name, 1)) v = a->before[0];
+    }
+
+    std::vector<std::string> missing;
+
+private:
+    array const* find(const char* name, std::size_t n) {
+        auto a = trace_.find(name);
+        if(!a || a->before.size()!=n) {
+            missing.push_back(name);
+            return nullptr;
+        }
+        return a;
+    }
+
+    trace const& trace_;
+};
+
+inline std::set<std::uint64_t> const& selected_calls() {
+    static const std::set<std::uint64_t> calls = [] {
+        std::set<std::uint64_t> c;
+        if(auto s = std::getenv("MODCC_CAPTURE_CALLS")) {
+            std::stringstream list(s);
+            std::string call;
+            while(std::getline(list, call, ',')) {
+                if(call.size()) c.insert(std::strtoull(call.c_str(), nullptr, 10));
+            }
+        }
+        return c;
+    }();
+    return calls;
+}
+
+// <dir>/<mechanism>.<kernel>.<call>.<n>.trace, where n counts the traces
+// written by the process, to tell apart the mechanisms with the same name
+inline std::string trace_name(trace const& t) {
+    static std::atomic<unsigned> count{0};
+    auto dir = std::getenv("MODCC_CAPTURE_DIR");
+    std::stringstream s;
+    s << (dir ? dir : ".") << "/" << t.mechanism << "." << t.kernel << "."
+      << t.call << "." << count++ << ".trace";
+    return s.str();
+}
+
+// the number of calls of each kernel of a mechanism
+class call_counter {
+public:
+    std::uint64_t next(const char* kernel) {
+        return counts_[kernel]++;
+    }
+private:
+    std::map<std::string, std::uint64_t> counts_;
+};
+
+// captures the arrays of a mechanism before and after a kernel, if the call
+// of the kernel is selected
+template <typename Mechanism>
+class scope {
+public:
+    scope(Mechanism& m, const char* kernel): mechanism_(m) {
+        auto call = m.capture_calls_.next(kernel);
+        if(!selected_calls().count(call)) return;
+        active_ = true;
+        trace_.mechanism = m.name();
+        trace_.kernel = kernel;
+        trace_.call = call;
+        gather g(trace_, false);
+        m.capture_arrays(g);
+    }
+
+    ~scope() {
+        if(!active_) return;
+        gather g(trace_, true);
+        mechanism_.capture_arrays(g);
+        auto name = trace_name(trace_);
+        if(!write(trace_, name)) {
+            std::fprintf(stderr, "unable to write kernel trace %s\n", name.c_str());
+        }
+    }
+
+private:
+    Mechanism& mechanism_;
+    bool active_ = false;
+    trace trace_;
+};
+
+} // namespace capture
+} // namespace modcc
+#define MODCC_CAPTURE_KERNEL(kernel) \
+    ::modcc::capture::scope<typename std::remove_reference<decltype(*this)>::type> \
+        modcc_capture_(*this, kernel)
+#else
+#define MODCC_CAPTURE_KERNEL(kernel)
+#endif
+#endif)";
+
+// Storage helpers used for NUMA aware first touch initialization.
+// Guarded in the same way as the thread pool.
+static const char* first_touch_source = R"(#ifndef MODCC_FIRST_TOUCH
+#define MODCC_FIRST_TOUCH
+namespace modcc {
+
+// the number of threads used to initialize mechanism storage, which is also
+// the number of threads that should be passed to the parallel kernels:
+// MODCC_NUM_THREADS if set in the environment, else the number of hardware threads
+inline int default_num_threads() {
+    if(auto s = std::getenv("MODCC_NUM_THREADS")) {
+        int n = std::atoi(s);
+        if(n>0) return n;
+    }
+    return std::max(1, int(std::thread::hardware_concurrency()));
+}
+
+// a buffer of n values that is mapped, but not touched, on allocation, so that
+// each page is placed on the NUMA node of the thread that first writes to it.
+// If MODCC_HUGE_PAGES is defined the buffer is aligned to, and advised to be
+// backed by, 2 MB transparent huge pages.
+template <typename T>
+class untouched_buffer {
+public:
+    untouched_buffer() = default;
+
+    explicit untouched_buffer(std::size_t n): size_(n) {
+        if(!n) return;
+        bytes_ = n*sizeof(T);
+#ifdef MODCC_HUGE_PAGES
+        const std::size_t huge_page = 2*1024*1024;
+        bytes_ += huge_page;
+#endif
+        void* p = mmap(nullptr, bytes_, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if(p==MAP_FAILED) throw std::bad_alloc();
+        base_ = p;
+        auto address = reinterpret_cast<std::uintptr_t>(p);
+#ifdef MODCC_HUGE_PAGES
+        address = (address+huge_page-1)/huge_page*huge_page;
+        madvise(reinterpret_cast<void*>(address), n*sizeof(T), MADV_HUGEPAGE);
+#endif
+        data_ = reinterpret_cast<T*>(address);
+    }
+
+    untouched_buffer(untouched_buffer&& other) {
+        swap(other);
+    }
+
+    untouched_buffer& operator=(untouched_buffer&& other) {
+        swap(other);
+        return *this;
+    }
+
+    ~untouched_buffer() {
+        if(base_) munmap(base_, bytes_);
+    }
+
+    T* data() {return data_;}
+    const T* data() const {return data_;}
+    std::size_t size() const {return size_;}
+
+    // mmap returns page aligned memory
+    static constexpr std::size_t alignment() {return 64;}
+
+private:
+    void swap(untouched_buffer& other) {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(base_, other.base_);
+        std::swap(bytes_, other.bytes_);
+    }
+
+    T* data_ = nullptr;
+    std::size_t size_ = 0;
+    void* base_ = nullptr;
+    std::size_t bytes_ = 0;
+};
+
+} // namespace modcc
+#endif)";
+
+// A table of the values of a function at n+1 evenly spaced points between
+// from and to, which are built by the procedures of TABLE statements.
+// The lookup interpolates linearly between the points, and is clamped to the
+// values at the ends of the table, without branches so that it vectorizes.
+static const char* lookup_table_source = R"(#ifndef MODCC_LOOKUP_TABLE
+#define MODCC_LOOKUP_TABLE
+namespace modcc {
+
+template <typename T>
+struct lookup_table {
+    lookup_table(T from, T to, int n):
+        from(from), step((to-from)/n), scale(n/(to-from)), n(n), values(n+1)
+    {}
+
+    // the point of entry j
+    T x(int j) const {return from + j*step;}
+
+    T operator()(T x) const {
+        T p = std::min(std::max((x-from)*scale, T(0)), T(n));
+        int j = std::min(int(p), n-1);
+        T theta = p - j;
+        return values[j] + theta*(values[j+1] - values[j]);
+    }
+
+    T from, step, scale;
+    int n;
+    std::vector<T> values;
+};
+
+} // namespace modcc
+#endif)";
+
+// Counter-based random numbers for the intrinsics random_uniform(),
+// random_exponential() and random_normal(). A draw is the Philox4x32-10
+// cipher of a counter made of the instance, the site of the draw in the
+// mechanism and either the number of kernel calls or the number of events
+// that the instance has received, with the seed as key. It depends on
+// nothing else, so the streams are the same for any number of threads, any
+// vector width and any order of delivery of the events of other instances,
+// and the loops that draw numbers vectorize.
+static const char* random_source = R"(#ifndef MODCC_RANDOM
+#define MODCC_RANDOM
+namespace modcc {
+
+struct philox_block {
+    std::uint32_t v[4];
+};
+
+inline philox_block philox(philox_block c, std::uint32_t k0, std::uint32_t k1) {
+    for(int r=0; r<10; ++r) {
+        std::uint64_t p0 = std::uint64_t(0xD2511F53u)*c.v[0];
+        std::uint64_t p1 = std::uint64_t(0xCD9E8D57u)*c.v[2];
+        c = philox_block{{std::uint32_t(p1>>32)^c.v[1]^k0, std::uint32_t(p1),
+                          std::uint32_t(p0>>32)^c.v[3]^k1, std::uint32_t(p0)}};
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+    return c;
+}
+
+inline philox_block random_block(std::uint64_t seed, std::uint64_t counter, int instance, int site) {
+    return philox(
+        philox_block{{std::uint32_t(instance), std::uint32_t(site),
+                      std::uint32_t(counter), std::uint32_t(counter>>32)}},
+        std::uint32_t(seed), std::uint32_t(seed>>32));
+}
+
+// the counter of the n'th event of an instance, which is never the counter
+// of a kernel call
+inline std::uint64_t random_event(std::uint64_t n) {
+    return n | (std::uint64_t(1)<<63);
+}
+
+// uniform in [0, 1) with 53 random bits
+inline double random_unit(std::uint32_t hi, std::uint32_t lo) {
+    return ((std::uint64_t(hi)<<21) | (lo>>11))*(1./9007199254740992.);
+}
+
+inline double random_uniform(std::uint64_t seed, std::uint64_t counter, int instance, int site) {
+    auto b = random_block(seed, counter, instance, site);
+    return random_unit(b.v[0], b.v[1]);
+}
+
+// exponential with mean 1
+inline double random_exponential(std::uint64_t seed, std::uint64_t counter, int instance, int site) {
+    auto b = random_block(seed, counter, instance, site);
+    return -std::log(1. - random_unit(b.v[0], b.v[1]));
+}
+
+// normal with mean 0 and variance 1, by the Box-Muller transform
+inline double random_normal(std::uint64_t seed, std::uint64_t counter, int instance, int site) {
+    auto b = random_block(seed, counter, instance, site);
+    auto r = std::sqrt(-2.*std::log(1. - random_unit(b.v[0], b.v[1])));
+    return r*std::cos(6.283185307179586*random_unit(b.v[2], b.v[3]));
+}
+
+} // namespace modcc
+#endif)";
+
 CPrinter::CPrinter(Module &m, bool o)
+:   CPrinter(m, default_options(o))
+{}
+
+CPrinter::CPrinter(Module &m, CPrinterOptions const& opts)
 :   module_(&m),
-    optimize_(o)
+    optimize_(opts.optimize),
+    max_streams_(opts.max_streams),
+    mixed_precision_(opts.mixed_precision),
+    threads_(opts.threads || opts.first_touch),
+    first_touch_(opts.first_touch),
+    multi_isa_(opts.multi_isa),
+    ensemble_(opts.ensemble),
+    fused_(opts.fused)
 {
+    if(opts.line_directives) {
+        line_directives_ = LineDirectives(
+            m.file_name(), opts.output_name.size() ? opts.output_name : m.name()+".hpp");
+    }
+
     // make a list of vector types, both parameters and assigned
     // and a list of all scalar types
+    // in mixed precision mode the vector types are split into those stored
+    // in double and single precision
     std::vector<VariableExpression*> scalar_variables;
     std::vector<VariableExpression*> array_variables;
+    std::vector<VariableExpression*> single_variables;
     for(auto& sym: m.symbols()) {
+        auto proc = sym.second->is_procedure();
+        if(proc && proc->kind()==procedureKind::table) {
+            table_builders_.push_back(proc);
+        }
+        if(proc && proc->kind()==procedureKind::dt_cache) {
+            dt_cache_ = proc;
+        }
+        if(proc && proc->kind()==procedureKind::advance) {
+            advance_ = proc;
+        }
+        if(proc && proc->kind()==procedureKind::net_receive) {
+            net_receive_ = proc;
+        }
         if(auto var = sym.second->is_variable()) {
-            if(var->is_range()) {
+            if(mixed_precision_ && is_single_precision(var)) {
+                single_variables.push_back(var);
+            }
+            else if(var->is_range()) {
                 array_variables.push_back(var);
             }
             else {
@@ -32,12 +823,88 @@ CPrinter::CPrinter(Module &m, bool o)
     text_.add_line();
     text_.add_line("#include <cmath>");
     text_.add_line("#include <limits>");
+    if(threads_ || table_builders_.size()) {
+        text_.add_line("#include <algorithm>");
+    }
+    if(threads_) {
+        text_.add_line("#include <condition_variable>");
+        text_.add_line("#include <functional>");
+        text_.add_line("#include <mutex>");
+        text_.add_line("#include <thread>");
+    }
+    if(first_touch_ || m.random_sites()) {
+        text_.add_line("#include <cstdint>");
+    }
+    if(first_touch_) {
+        text_.add_line("#include <cstdlib>");
+        text_.add_line("#include <new>");
+        text_.add_line("#include <utility>");
+        text_.add_line();
+        text_.add_line("#include <sys/mman.h>");
+    }
+    if(single_variables.size() || threads_ || table_builders_.size()) {
+        text_.add_line("#include <vector>");
+    }
     text_.add_line();
     text_.add_line("#include <mechanism.hpp>");
     text_.add_line("#include <mechanism_interface.hpp>");
     text_.add_line("#include <algorithms.hpp>");
     text_.add_line();
 
+    {
+        std::istringstream profile(profile_source);
+        std::string line;
+        while(std::getline(profile, line)) {
+            text_.add_line(line);
+        }
+        text_.add_line();
+        std::istringstream capture(capture_source);
+        while(std::getline(capture, line)) {
+            text_.add_line(line);
+        }
+        text_.add_line();
+    }
+    if(threads_) {
+        std::istringstream pool(thread_pool_source);
+        std::string line;
+        while(std::getline(pool, line)) {
+            text_.add_line(line);
+        }
+        text_.add_line();
+    }
+    if(multi_isa_) {
+        std::istringstream dispatch(isa_dispatch_source);
+        std::string line;
+        while(std::getline(dispatch, line)) {
+            text_.add_line(line);
+        }
+        text_.add_line();
+    }
+    if(first_touch_) {
+        std::istringstream helpers(first_touch_source);
+        std::string line;
+        while(std::getline(helpers, line)) {
+            text_.add_line(line);
+        }
+        text_.add_line();
+    }
+    if(table_builders_.size()) {
+        std::istringstream table(lookup_table_source);
+        std::string line;
+        while(std::getline(table, line)) {
+            text_.add_line(line);
+        }
+        text_.add_line();
+    }
+    if(m.random_sites()) {
+        std::istringstream random(random_source);
+        std::string line;
+        while(std::getline(random, line)) {
+            text_.add_line(line);
+        }
+        text_.add_line();
+    }
+
     //////////////////////////////////////////////
     //////////////////////////////////////////////
     std::string class_name = "mechanism_" + m.name();
@@ -59,6 +926,13 @@ CPrinter::CPrinter(Module &m, bool o)
     text_.add_line("using indexed_view_type= typename base::indexed_view_type;");
     text_.add_line("using ion_type = typename base::ion_type;");
     text_.add_line();
+    if(ensemble_>1) {
+        text_.add_line("// the parameter sets simulated by every instance, the lane k of node n");
+        text_.add_line("// is stored at ensemble_size*n+k in the voltage, current and ion arrays");
+        text_.add_gutter() << "static constexpr int ensemble_size = " << ensemble_ << ";";
+        text_.end_line();
+        text_.add_line();
+    }
 
     //////////////////////////////////////////////
     //////////////////////////////////////////////
@@ -93,17 +967,27 @@ CPrinter::CPrinter(Module &m, bool o)
     text_.end_line();
 
     text_.add_line();
+    // with first touch the fields are raw pointers into an untouched buffer
+    bool pointer_fields = optimize_ || first_touch_;
+    std::string buffer_type = first_touch_
+        ? "modcc::untouched_buffer<value_type>" : "vector_type";
+
+    // every field has one value for each lane of each instance
+    std::string field_values = ensemble_>1 ? "ensemble_size*size()" : "size()";
+
     text_.add_line("// calculate the padding required to maintain proper alignment of sub arrays");
     text_.add_line("auto alignment  = data_.alignment();");
-    text_.add_line("auto field_size_in_bytes = sizeof(value_type)*size();");
+    text_.add_line("auto field_size_in_bytes = sizeof(value_type)*" + field_values + ";");
     text_.add_line("auto remainder  = field_size_in_bytes % alignment;");
     text_.add_line("auto padding    = remainder ? (alignment - remainder)/sizeof(value_type) : 0;");
-    text_.add_line("auto field_size = size()+padding;");
+    text_.add_line("auto field_size = " + field_values + "+padding;");
 
     text_.add_line();
     text_.add_line("// allocate memory");
-    text_.add_line("data_ = vector_type(field_size * num_fields);");
-    text_.add_line("data_(memory::all) = std::numeric_limits<value_type>::quiet_NaN();");
+    text_.add_line("data_ = " + buffer_type + "(field_size * num_fields);");
+    if(!first_touch_) {
+        text_.add_line("data_(memory::all) = std::numeric_limits<value_type>::quiet_NaN();");
+    }
 
     // assign the sub-arrays
     // replace this : data_(1*n, 2*n);
@@ -114,33 +998,111 @@ CPrinter::CPrinter(Module &m, bool o)
     for(int i=0; i<num_vars; ++i) {
         char namestr[128];
         sprintf(namestr, "%-15s", array_variables[i]->name().c_str());
-        if(optimize_) {
+        if(pointer_fields) {
             text_.add_gutter() << namestr << " = data_.data() + "
                                << i << "*field_size;";
         }
         else {
             text_.add_gutter() << namestr << " = data_("
-                               << i << "*field_size, " << i+1 << "*size());";
+                               << i << "*field_size, " << i << "*field_size+"
+                               << field_values << ");";
+        }
+        text_.end_line();
+    }
+
+    // single precision fields are stored in a separate buffer
+    // each field is padded to a multiple of 16 values, i.e. 64 bytes
+    int num_single = single_variables.size();
+    if(num_single) {
+        text_.add_line();
+        text_.add_line("// allocate memory for single precision fields");
+        text_.add_line("auto single_field_size = (size()+15)/16*16;");
+        if(first_touch_) {
+            text_.add_gutter()
+                << "data_single_ = modcc::untouched_buffer<float>(single_field_size * "
+                << num_single << ");";
+        }
+        else {
+            text_.add_gutter()
+                << "data_single_ = std::vector<float>(single_field_size * "
+                << num_single << ", std::numeric_limits<float>::quiet_NaN());";
         }
         text_.end_line();
+        for(int i=0; i<num_single; ++i) {
+            char namestr[128];
+            sprintf(namestr, "%-15s", single_variables[i]->name().c_str());
+            text_.add_gutter() << namestr << " = data_single_.data() + "
+                               << i << "*single_field_size;";
+            text_.end_line();
+        }
     }
 
     text_.add_line();
-    text_.add_line("// set initial values for variables and parameters");
-    for(auto const& var : array_variables) {
-        double val = var->value();
-        // only non-NaN fields need to be initialized, because data_
-        // is NaN by default
-        std::string pointer_name = var->name();
-        if(!optimize_) pointer_name += ".data()";
-        if(val == val) {
-            text_.add_gutter() << "std::fill(" << pointer_name << ", "
-                                               << pointer_name << "+size(), "
-                                               << val << ");";
+    if(first_touch_) {
+        // every field is written here, including those that are NaN, because
+        // nothing has been written to the buffers yet
+        text_.add_line("// set initial values for variables and parameters, using the same");
+        text_.add_line("// partition of instances over threads as the parallel kernels, so that");
+        text_.add_line("// the pages of each range are placed on the NUMA node of its thread");
+        text_.add_line("modcc::parallel_for_ranges(size(), modcc::default_num_threads(),");
+        text_.increase_indentation();
+        text_.add_line("[this](int begin_, int end_) {");
+        text_.increase_indentation();
+        auto print_fill = [this] (VariableExpression* var, std::string const& type) {
+            double val = var->value();
+            text_.add_gutter() << "std::fill(" << var->name() << "+begin_, "
+                               << var->name() << "+end_, ";
+            if(val == val) text_ << val;
+            else           text_ << "std::numeric_limits<" << type << ">::quiet_NaN()";
+            text_ << ");";
             text_.end_line();
+        };
+        for(auto const& var : array_variables) {
+            print_fill(var, "value_type");
+        }
+        for(auto const& var : single_variables) {
+            print_fill(var, "float");
+        }
+        text_.decrease_indentation();
+        text_.add_line("});");
+        text_.decrease_indentation();
+    }
+    else {
+        text_.add_line("// set initial values for variables and parameters");
+        for(auto const& var : array_variables) {
+            double val = var->value();
+            // only non-NaN fields need to be initialized, because data_
+            // is NaN by default
+            std::string pointer_name = var->name();
+            if(!pointer_fields) pointer_name += ".data()";
+            if(val == val) {
+                text_.add_gutter() << "std::fill(" << pointer_name << ", "
+                                                   << pointer_name << "+" << field_values << ", "
+                                                   << val << ");";
+                text_.end_line();
+            }
+        }
+        for(auto const& var : single_variables) {
+            double val = var->value();
+            if(val == val) {
+                text_.add_gutter() << "std::fill(" << var->name() << ", "
+                                                   << var->name() << "+size(), "
+                                                   << val << ");";
+                text_.end_line();
+            }
         }
     }
 
+    if(has_random_events()) {
+        text_.add_line("random_events_.assign(size(), 0);");
+    }
+
+    if(multi_isa_) {
+        text_.add_line();
+        text_.add_line("// select the kernels for the instruction set of the host");
+        text_.add_line("select_kernels();");
+    }
+
     text_.add_line();
     text_.decrease_indentation();
     text_.add_line("}");
@@ -156,6 +1118,9 @@ CPrinter::CPrinter(Module &m, bool o)
     text_.increase_indentation();
     text_.add_line("auto s = std::size_t{0};");
     text_.add_line("s += data_.size()*sizeof(value_type);");
+    if(num_single) {
+        text_.add_line("s += data_single_.size()*sizeof(float);");
+    }
     for(auto& ion: m.neuron_block().ions) {
         text_.add_line("s += ion_" + ion.name + ".memory();");
     }
@@ -168,9 +1133,59 @@ CPrinter::CPrinter(Module &m, bool o)
     text_.increase_indentation();
     text_.add_line("t = t_;");
     text_.add_line("dt = dt_;");
+    if(table_builders_.size()) {
+        text_.add_line("update_tables_();");
+    }
+    if(dt_cache_) {
+        text_.add_line("update_dt_cache_();");
+    }
+    text_.decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
+
+    // the arrays and scalars that are read or written by the kernels, for the
+    // capture of kernel calls and their replay
+    text_.add_line("#ifdef MODCC_CAPTURE");
+    if(ensemble_>1) {
+        text_.add_line("#error \"the capture of kernel calls doesn't support ensembles\"");
+    }
+    text_.add_line("template <typename F>");
+    text_.add_line("void capture_arrays(F& f) {");
+    text_.increase_indentation();
+    text_.add_line("f.nodes(node_index_);");
+    text_.add_line("f.indexed(\"vec_v\", vec_v_, node_index_);");
+    text_.add_line("f.indexed(\"vec_i\", vec_i_, node_index_);");
+    text_.add_line("f.indexed(\"vec_g\", vec_g_, node_index_);");
+    text_.add_line("f.indexed(\"vec_area\", vec_area_, node_index_);");
+    for(auto& ion: m.neuron_block().ions) {
+        auto store = "ion_" + ion.name;
+        auto print_view = [&] (Token const& field) {
+            auto view = store + "." + field.spelling;
+            text_.add_line("f.indexed(\"" + view + "\", " + view + ", " + store + ".index);");
+        };
+        for(auto& field : ion.read) print_view(field);
+        for(auto& field : ion.write) print_view(field);
+    }
+    for(auto var: array_variables) {
+        auto pointer_name = var->name() + (pointer_fields ? "" : ".data()");
+        text_.add_line("f.field(\"" + var->name() + "\", " + pointer_name + ", size());");
+    }
+    for(auto var: single_variables) {
+        text_.add_line("f.field(\"" + var->name() + "\", " + var->name() + ", size());");
+    }
+    for(auto var: scalar_variables) {
+        text_.add_line("f.scalar(\"" + var->name() + "\", " + var->name() + ");");
+    }
+    if(m.random_sites()) {
+        text_.add_line("f.scalar(\"random_seed_\", random_seed_);");
+        text_.add_line("f.scalar(\"random_counter_\", random_counter_);");
+    }
     text_.decrease_indentation();
     text_.add_line("}");
     text_.add_line();
+    text_.add_line("::modcc::capture::call_counter capture_calls_;");
+    text_.add_line("#endif");
+    text_.add_line();
 
     text_.add_line("std::string name() const override {");
     text_.increase_indentation();
@@ -308,7 +1323,10 @@ CPrinter::CPrinter(Module &m, bool o)
         return
             k == procedureKind::normal
                  || k == procedureKind::api
-                 || k == procedureKind::net_receive;
+                 || k == procedureKind::net_receive
+                 || k == procedureKind::table
+                 || k == procedureKind::dt_cache
+                 || k == procedureKind::advance;
     };
     for(auto &var : m.symbols()) {
         auto isproc = var.second->kind()==symbolKind::procedure;
@@ -321,21 +1339,61 @@ CPrinter::CPrinter(Module &m, bool o)
         }
     }
 
+    if(table_builders_.size()) {
+        print_table_update();
+    }
+
+    if(dt_cache_) {
+        print_dt_cache_update();
+    }
+
+    if(advance_) {
+        print_advance();
+    }
+
+    if(net_receive_) {
+        print_deliver_events();
+    }
+
+    if(multi_isa_) {
+        print_kernel_selection();
+    }
+
     //////////////////////////////////////////////
     //////////////////////////////////////////////
 
-    text_.add_line("vector_type data_;");
+    text_.add_line(buffer_type + " data_;");
     for(auto var: array_variables) {
         if(optimize_) {
             text_.add_line(
                 "__declspec(align(vector_type::alignment())) value_type *"
                 + var->name() + ";");
         }
+        else if(first_touch_) {
+            text_.add_line("value_type *" + var->name() + ";");
+        }
         else {
             text_.add_line("view_type " + var->name() + ";");
         }
     }
 
+    for(auto const& name: dispatched_kernels_) {
+        text_.add_line("void (" + class_name + "::*" + name + "_kernel_)(int, int) = nullptr;");
+    }
+
+    for(auto const& name: partial_buffers_) {
+        text_.add_line("std::vector<value_type> " + name + ";");
+    }
+
+    if(num_single) {
+        text_.add_line(first_touch_
+            ? "modcc::untouched_buffer<float> data_single_;"
+            : "std::vector<float> data_single_;");
+        for(auto var: single_variables) {
+            text_.add_line("float *" + var->name() + ";");
+        }
+    }
+
     for(auto var: scalar_variables) {
         double val = var->value();
         // test the default value for NaN
@@ -349,14 +1407,47 @@ CPrinter::CPrinter(Module &m, bool o)
         }
     }
 
+    // the lookup tables, and the values of the scalars that they depend on
+    // when they were last built
+    for(auto builder: table_builders_) {
+        auto table = builder->table();
+        for(auto const& lookup: table->lookups()) {
+            text_.add_gutter() << "modcc::lookup_table<value_type> " << lookup
+                               << "{" << table->from() << ", " << table->to()
+                               << ", " << table->n() << "};";
+            text_.end_line();
+        }
+        text_.add_line("bool " + builder->name() + "valid_ = false;");
+        for(auto const& name: table->depends()) {
+            text_.add_line("value_type " + builder->name() + name + "_ = 0;");
+        }
+    }
+
+    // the time step for which the cached decay factors were computed
+    if(dt_cache_) {
+        text_.add_line("value_type dt_cache_dt_ = std::numeric_limits<value_type>::quiet_NaN();");
+    }
+
+    // the key of the random streams, and the counter of kernel calls, which
+    // is incremented before the numbers are drawn
+    if(m.random_sites()) {
+        text_.add_line("std::uint64_t random_seed_ = 0;");
+        text_.add_line("std::uint64_t random_counter_ = 0;");
+    }
+    // the number of events that each instance has received, which is
+    // incremented after the numbers are drawn
+    if(has_random_events()) {
+        text_.add_line("std::vector<std::uint64_t> random_events_;");
+    }
+
     text_.add_line();
     text_.add_line("using base::vec_v_;");
     text_.add_line("using base::vec_i_;");
+    text_.add_line("using base::vec_g_;");
     text_.add_line("using base::vec_area_;");
     text_.add_line("using base::node_index_;");
 
     text_.add_line();
-    //text_.add_line("DATA_PROFILE");
     text_.decrease_indentation();
     text_.add_line("};");
     text_.add_line();
@@ -431,7 +1522,7 @@ void CPrinter::visit(Symbol *e) {
 void CPrinter::visit(LocalVariable *e) {
     std::string const& name = e->name();
     text_ << name;
-    if(is_ghost_local(e)) {
+    if(is_ghost_local(e) || is_scratch_local(e)) {
         text_ << "[j_]";
     }
 }
@@ -440,6 +1531,14 @@ void CPrinter::visit(NumberExpression *e) {
     text_ << " " << e->value();
 }
 
+// the draws of an event are counted by the events of the instance, the
+// draws of a kernel by the calls of the kernel
+void CPrinter::visit(RandomExpression *e) {
+    auto counter = in_event_ ? "modcc::random_event(random_events_[i_])" : "random_counter_";
+    text_ << "modcc::" << token_string(e->op())
+          << "(random_seed_, " << counter << ", " << lane_index("i_") << ", " << e->site() << ")";
+}
+
 void CPrinter::visit(IdentifierExpression *e) {
     e->symbol()->accept(this);
 }
@@ -447,12 +1546,27 @@ void CPrinter::visit(IdentifierExpression *e) {
 void CPrinter::visit(VariableExpression *e) {
     text_ << e->name();
     if(e->is_range()) {
-        text_ << "[i_]";
+        text_ << "[" << lane_index("i_") << "]";
     }
 }
 
 void CPrinter::visit(IndexedVariable *e) {
-    text_ << e->index_name() << "[i_]";
+    if(ensemble_>1) {
+        // the lanes of a node are contiguous, so the index is gathered once
+        // for all lanes of the instance
+        // the area of a node is shared by all lanes
+        auto channel = e->ion_channel();
+        auto index = channel==ionKind::none ? "node_index_" : ion_store(channel)+".index";
+        if(e->index_name()=="vec_area") {
+            text_ << e->index_name() << "[" << index << "[i_]]";
+        }
+        else {
+            text_ << e->index_name() << "[" << lane_index(index + "[i_]") << "]";
+        }
+    }
+    else {
+        text_ << e->index_name() << "[i_]";
+    }
 }
 
 void CPrinter::visit(UnaryExpression *e) {
@@ -524,14 +1638,47 @@ void CPrinter::visit(BlockExpression *e) {
         if(stmt->is_local_declaration()) continue;
 
         // these all must be handled
-        text_.add_gutter();
-        stmt->accept(this);
-        text_.end_line(";");
+        print_statement(stmt.get());
+    }
+
+    if(!e->is_nested()) {
+        line_directives_.restore(text_);
     }
 }
 
-void CPrinter::visit(IfExpression *e) {
-    // for now we remove the brackets around the condition because
+// the loop over the lanes of an ensemble, which is not printed if there is
+// only one lane
+// The lanes of an instance never touch the same memory, so the lane loops of
+// the kernels are marked simd, which GCC needs to vectorize them (compile with
+// -fopenmp-simd or -fopenmp).
+void CPrinter::open_lane_loop(bool simd) {
+    if(ensemble_>1) {
+        if(simd) text_.add_line("#pragma omp simd");
+        text_.add_line("for(int k_=0; k_<ensemble_size; ++k_) {");
+        increase_indentation();
+    }
+}
+
+void CPrinter::close_lane_loop() {
+    if(ensemble_>1) {
+        decrease_indentation();
+        text_.add_line("}");
+    }
+}
+
+std::string CPrinter::lane_index(std::string const& i) const {
+    return ensemble_>1 ? "ensemble_size*" + i + "+k_" : i;
+}
+
+void CPrinter::print_statement(Expression* stmt) {
+    line_directives_.source(text_, stmt->location());
+    text_.add_gutter();
+    stmt->accept(this);
+    text_.end_line(";");
+}
+
+void CPrinter::visit(IfExpression *e) {
+    // for now we remove the brackets around the condition because
     // the binary expression printer adds them, and we want to work
     // around the -Wparentheses-equality warning
     text_ << "if(";
@@ -542,15 +1689,176 @@ void CPrinter::visit(IfExpression *e) {
     decrease_indentation();
     text_.add_gutter();
     text_ << "}";
+
+    // the false branch is either a block, or the if statement of an else if
+    if(auto f = e->false_branch()) {
+        text_ << " else ";
+        if(f->is_if()) {
+            f->accept(this);
+        }
+        else {
+            text_ << "{\n";
+            increase_indentation();
+            f->accept(this);
+            decrease_indentation();
+            text_.add_gutter();
+            text_ << "}";
+        }
+    }
+}
+
+void CPrinter::visit(TableLookupExpression *e) {
+    text_ << e->name() << "(";
+    e->expression()->accept(this);
+    text_ << ")";
+}
+
+// the tables are built when the mechanism is initialized, and are built again
+// when one of the scalars that they depend on has changed
+void CPrinter::print_table_update() {
+    text_.add_line("void update_tables_() {");
+    increase_indentation();
+    for(auto builder: table_builders_) {
+        auto table = builder->table();
+        auto const& name = builder->name();
+        text_.add_gutter() << "if(!" << name << "valid_";
+        for(auto const& dep: table->depends()) {
+            text_ << " || " << name << dep << "_!=" << dep;
+        }
+        text_.end_line(") {");
+        increase_indentation();
+        text_.add_gutter() << "for(int j_=0; j_<=" << table->n() << "; ++j_) {";
+        text_.end_line();
+        increase_indentation();
+        text_.add_line(name + "(j_, " + table->lookups().front() + ".x(j_));");
+        decrease_indentation();
+        text_.add_line("}");
+        for(auto const& dep: table->depends()) {
+            text_.add_line(name + dep + "_ = " + dep + ";");
+        }
+        text_.add_line(name + "valid_ = true;");
+        decrease_indentation();
+        text_.add_line("}");
+    }
+    decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
+}
+
+// the decay factors are computed for every instance when the mechanism is
+// initialized, and again when dt changes, which is rare
+void CPrinter::print_dt_cache_update() {
+    // the factors are scalars if they depend only on scalar parameters
+    auto range = false;
+    for(auto& s : *dt_cache_->body()) {
+        auto lhs = s->is_assignment()->lhs()->is_identifier();
+        range = range || lhs->symbol()->is_variable()->is_range();
+    }
+
+    text_.add_line("void update_dt_cache_(bool force_=false) {");
+    increase_indentation();
+    text_.add_line("if(force_ || dt!=dt_cache_dt_) {");
+    increase_indentation();
+    if(range) {
+        text_.add_line("for(int i_=0; i_<int(size()); ++i_) {");
+        increase_indentation();
+        open_lane_loop();
+        text_.add_line(dt_cache_->name() + "(" + (ensemble_>1 ? "i_, k_" : "i_") + ");");
+        close_lane_loop();
+        decrease_indentation();
+        text_.add_line("}");
+    }
+    else {
+        text_.add_line(dt_cache_->name() + "(" + (ensemble_>1 ? "0, 0" : "0") + ");");
+    }
+    text_.add_line("dt_cache_dt_ = dt;");
+    decrease_indentation();
+    text_.add_line("}");
+    decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
+}
+
+// advance(k) is the same as k calls of nrn_state, for every instance, and
+// advance(i_, k) advances only the instance i_, so that instances that
+// receive no events can be updated lazily, with the same time step
+void CPrinter::print_advance() {
+    text_.add_line("void advance(int k) {");
+    increase_indentation();
+    text_.add_line("for(int i_=0; i_<int(size()); ++i_) {");
+    increase_indentation();
+    open_lane_loop();
+    text_.add_line(advance_->name() + "(" + (ensemble_>1 ? "i_, k_" : "i_") + ", k);");
+    close_lane_loop();
+    decrease_indentation();
+    text_.add_line("}");
+    decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
+}
+
+// Events are delivered in batches, with the body of NET_RECEIVE inlined in
+// one loop over the events, instead of a virtual call of net_receive for
+// every event. The arguments of the events are stored as a structure of
+// arrays, and the events are sorted by target instance, so that the fields
+// of the instances are accessed in order.
+void CPrinter::print_deliver_events() {
+    text_.add_line("// a batch of events sorted by the instance that they target, with one");
+    text_.add_line("// array for each argument of NET_RECEIVE");
+    text_.add_line("struct event_batch {");
+    increase_indentation();
+    text_.add_line("const I* target = nullptr;");
+    for(auto& arg : net_receive_->args()) {
+        text_.add_line("const value_type* " + arg->is_argument()->name() + " = nullptr;");
+    }
+    text_.add_line("int size = 0;");
+    decrease_indentation();
+    text_.add_line("};");
+    text_.add_line();
+
+    // the events are delivered in order, so that events with the same
+    // target have the same effect as calls of net_receive in that order
+    text_.add_line("void deliver_events(event_batch const& events) {");
+    increase_indentation();
+    text_.add_line("for(int j_=0; j_<events.size; ++j_) {");
+    increase_indentation();
+    text_.add_line("int i_ = events.target[j_];");
+    // every lane receives the event
+    open_lane_loop();
+    for(auto& arg : net_receive_->args()) {
+        auto const& name = arg->is_argument()->name();
+        text_.add_line("value_type " + name + " = events." + name + "[j_];");
+    }
+    in_event_ = true;
+    net_receive_->body()->accept(this);
+    in_event_ = false;
+    close_lane_loop();
+    if(has_random_events()) {
+        text_.add_line("++random_events_[i_];");
+    }
+    decrease_indentation();
+    text_.add_line("}");
+    decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
 }
 
 void CPrinter::visit(ProcedureExpression *e) {
     // ------------- print prototype ------------- //
+    // the procedures called from the kernels are called for one lane, and the
+    // table builders and net_receive are called for every lane
+    bool per_lane = e->kind()!=procedureKind::table
+                 && e->kind()!=procedureKind::net_receive;
     text_.add_gutter() << "void " << e->name() << "(int i_";
+    if(ensemble_>1 && per_lane) {
+        text_ << ", int k_";
+    }
     for(auto& arg : e->args()) {
         text_ << ", value_type " << arg->is_argument()->name();
     }
-    if(e->kind() == procedureKind::net_receive) {
+    // the runtime interface takes a single weight, other signatures are
+    // called through deliver_events
+    if(e->kind() == procedureKind::net_receive && e->args().size()==1) {
         text_.end_line(") override {");
     }
     else {
@@ -566,7 +1874,28 @@ void CPrinter::visit(ProcedureExpression *e) {
 
     increase_indentation();
 
-    e->body()->accept(this);
+    if(e->kind()==procedureKind::net_receive) {
+        open_lane_loop();
+        in_event_ = true;
+        e->body()->accept(this);
+        in_event_ = false;
+        close_lane_loop();
+        // every event of an instance draws new random numbers
+        if(has_random_events()) {
+            text_.add_line("++random_events_[i_];");
+        }
+    }
+    else {
+        e->body()->accept(this);
+    }
+
+    // a procedure that builds tables stores the tabulated values of the
+    // entry i_
+    if(auto table = e->table()) {
+        for(auto i=0u; i<table->names().size(); ++i) {
+            text_.add_line(table->lookups()[i] + ".values[i_] = " + table->names()[i] + ";");
+        }
+    }
 
     // ------------- close up ------------- //
     decrease_indentation();
@@ -576,10 +1905,6 @@ void CPrinter::visit(ProcedureExpression *e) {
 }
 
 void CPrinter::visit(APIMethod *e) {
-    // ------------- print prototype ------------- //
-    text_.add_gutter() << "void " << e->name() << "() override {";
-    text_.end_line();
-
     if(!e->scope()) { // error: semantic analysis has not been performed
         throw compiler_exception(
             "CPrinter attempt to print APIMethod " + e->name()
@@ -587,36 +1912,185 @@ void CPrinter::visit(APIMethod *e) {
             e->location());
     }
 
-    // only print the body if it has contents
-    if(e->is_api_method()->body()->statements().size()) {
-        increase_indentation();
+    // ------------- serial entry point ------------- //
+    // the override processes all instances on the calling thread
+    text_.add_gutter() << "void " << e->name() << "() override {";
+    text_.end_line();
+    increase_indentation();
+    // the entry points are profiled, not the range kernels, so that a call
+    // of a threaded kernel is counted once, with the wall time of the call
+    text_.add_line(
+        "MODCC_PROFILE_KERNEL(\"" + module_->name() + "\", \"" + e->name() + "\", node_index_.size());");
+    if(module_->random_sites()) {
+        text_.add_line("++random_counter_;");
+    }
+    text_.add_line("MODCC_CAPTURE_KERNEL(\"" + e->name() + "\");");
+    if(e->name()=="nrn_init" && table_builders_.size()) {
+        text_.add_line("update_tables_();");
+    }
+    if(e->name()=="nrn_init" && dt_cache_) {
+        text_.add_line("update_dt_cache_(true);");
+    }
+    text_.add_line(e->name() + "(0, node_index_.size());");
+    decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
 
-        // create local indexed views
-        for(auto &symbol : e->scope()->locals()) {
-            auto var = symbol.second->is_local_variable();
-            if(var->is_indexed()) {
-                auto const& name = var->name();
-                auto const& index_name = var->external_variable()->index_name();
-                text_.add_gutter();
-                if(var->is_read()) text_ << "const ";
-                text_ << "indexed_view_type " + index_name;
-                auto channel = var->external_variable()->ion_channel();
+    // ------------- parallel entry point ------------- //
+    if(threads_) {
+        print_APIMethod_parallel(e);
+    }
+
+    // ------------- range entry point ------------- //
+    print_APIMethod_range(e, e->name());
+
+    // ------------- one instance, for mechanism groups ------------- //
+    if(fused_ && (e->name()=="nrn_state" || e->name()=="nrn_current")) {
+        print_APIMethod_fused(e);
+    }
+}
+
+void CPrinter::print_indexed_views(APIMethod* e, bool inputs, bool outputs) {
+    for(auto &symbol : e->scope()->locals()) {
+        auto var = symbol.second->is_local_variable();
+        if(var->is_indexed()) {
+            if(!inputs && var->is_read()) continue;
+            if(!outputs && var->is_write()) continue;
+            auto const& name = var->name();
+            auto const& index_name = var->external_variable()->index_name();
+            auto channel = var->external_variable()->ion_channel();
+            text_.add_gutter();
+            if(var->is_read()) text_ << "const ";
+            if(ensemble_>1) {
+                // the ensemble kernels compute the index of each lane, so
+                // they use the underlying array instead of an indexed view
+                text_ << "value_type* " << index_name << " = ";
                 if(channel==ionKind::none) {
-                    text_ << "(" + index_name + "_, node_index_);\n";
+                    text_ << index_name << "_.data();\n";
                 }
                 else {
-                    auto iname = ion_store(channel);
-                    text_ << "(" << iname << "." << name << ", "
-                          << ion_store(channel) << ".index);\n";
+                    text_ << ion_store(channel) << "." << name << ".data();\n";
                 }
+                continue;
+            }
+            text_ << "indexed_view_type " + index_name;
+            if(channel==ionKind::none) {
+                text_ << "(" + index_name + "_, node_index_);\n";
             }
+            else {
+                auto iname = ion_store(channel);
+                text_ << "(" << iname << "." << name << ", "
+                      << ion_store(channel) << ".index);\n";
+            }
+        }
+    }
+}
+
+std::vector<LocalVariable*> indexed_inputs(APIMethod* e) {
+    std::vector<LocalVariable*> ins;
+    for(auto &symbol : e->scope()->locals()) {
+        auto var = symbol.second->is_local_variable();
+        if(var->is_local() && var->is_indexed() && var->is_read()) {
+            ins.push_back(var);
+        }
+    }
+    return ins;
+}
+
+std::vector<LocalVariable*> indexed_outputs(APIMethod* e) {
+    std::vector<LocalVariable*> outs;
+    for(auto &symbol : e->scope()->locals()) {
+        auto var = symbol.second->is_local_variable();
+        if(var->is_local() && var->is_indexed() && var->is_write()) {
+            outs.push_back(var);
+        }
+    }
+    return outs;
+}
+
+std::vector<LocalVariable*> CPrinter::outputs(APIMethod* e) {
+    return indexed_outputs(e);
+}
+
+// print the kernel for the instances in the range [begin_, end_)
+void CPrinter::print_APIMethod_range(APIMethod* e, std::string const& name) {
+    if(!multi_isa_) {
+        print_APIMethod_kernel(e, name);
+        return;
+    }
+
+    // the range entry point calls the kernel selected in the constructor
+    dispatched_kernels_.push_back(name);
+    text_.add_gutter() << "void " << name << "(int begin_, int end_) {";
+    text_.end_line();
+    increase_indentation();
+    text_.add_line("(this->*" + name + "_kernel_)(begin_, end_);");
+    decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
+
+    text_.add_line("#if MODCC_X86_DISPATCH");
+    for(auto const& isa: isa_targets) {
+        print_APIMethod_kernel(
+            e, name + "_" + isa.suffix,
+            std::string("__attribute__((target(\"") + isa.target + "\"))) ");
+    }
+    text_.add_line("#endif");
+    text_.add_line();
+    print_APIMethod_kernel(e, name + "_generic");
+}
+
+void CPrinter::print_kernel_selection() {
+    auto class_name = "mechanism_" + module_->name();
+
+    text_.add_line("void select_kernels() {");
+    increase_indentation();
+    for(auto const& name: dispatched_kernels_) {
+        text_.add_line(name + "_kernel_ = &" + class_name + "::" + name + "_generic;");
+    }
+    text_.add_line("#if MODCC_X86_DISPATCH");
+    text_.add_line("__builtin_cpu_init();");
+    bool first = true;
+    for(auto const& isa: isa_targets) {
+        text_.add_gutter() << (first ? "if(" : "else if(") << isa.condition << ") {";
+        text_.end_line();
+        increase_indentation();
+        for(auto const& name: dispatched_kernels_) {
+            text_.add_line(name + "_kernel_ = &" + class_name + "::" + name + "_" + isa.suffix + ";");
         }
+        decrease_indentation();
+        text_.add_line("}");
+        first = false;
+    }
+    text_.add_line("#endif");
+    decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
+}
+
+void CPrinter::print_APIMethod_kernel(
+    APIMethod* e, std::string const& name, std::string const& attributes)
+{
+    // ------------- print prototype ------------- //
+    text_.add_gutter() << attributes << "void " << name << "(int begin_, int end_) {";
+    text_.end_line();
+
+    // only print the body if it has contents
+    if(e->is_api_method()->body()->statements().size()) {
+        increase_indentation();
+
+        // create local indexed views
+        // partial kernels write to partial buffers instead of output views
+        print_indexed_views(e, true, !partial_output_);
 
-        // ------------- get loop dimensions ------------- //
-        text_.add_line("int n_ = node_index_.size();");
+        // split the loop if it touches more arrays than the stream budget
+        auto groups = fission_api_method(e, max_streams_);
 
         // hand off printing of loops to optimized or unoptimized backend
-        if(optimize_) {
+        if(groups.size()>1 && !partial_output_) {
+            print_APIMethod_fission(e, groups);
+        }
+        else if(optimize_ && !partial_output_) {
             print_APIMethod_optimized(e);
         }
         else {
@@ -629,15 +2103,119 @@ void CPrinter::visit(APIMethod *e) {
     text_.add_line();
 }
 
+// print a multi-threaded entry point, which splits the instances into one
+// contiguous range per thread
+void CPrinter::print_APIMethod_parallel(APIMethod* e) {
+    auto outs = outputs(e);
+
+    // Density mechanisms have at most one instance per node, so the ranges can
+    // update the indexed arrays concurrently. The instances of point processes
+    // may share nodes, so their outputs are stored per instance in partial
+    // buffers by the threads, and accumulated afterwards in instance order.
+    // This gives the same result as the serial kernel, independent of the
+    // number of threads.
+    bool use_partials = is_point_process() && outs.size()>0;
+
+    text_.add_gutter() << "void " << e->name() << "_parallel(int num_threads) {";
+    text_.end_line();
+    increase_indentation();
+    text_.add_line(
+        "MODCC_PROFILE_KERNEL(\"" + module_->name() + "\", \"" + e->name() + "_parallel\", node_index_.size());");
+    if(module_->random_sites()) {
+        text_.add_line("++random_counter_;");
+    }
+    text_.add_line("MODCC_CAPTURE_KERNEL(\"" + e->name() + "\");");
+    if(e->name()=="nrn_init" && table_builders_.size()) {
+        text_.add_line("update_tables_();");
+    }
+    if(e->name()=="nrn_init" && dt_cache_) {
+        text_.add_line("update_dt_cache_(true);");
+    }
+    text_.add_line("int n_ = node_index_.size();");
+    if(use_partials) {
+        for(auto out: outs) {
+            auto buffer = "partial_" + out->external_variable()->index_name() + "_";
+            partial_buffers_.insert(buffer);
+            text_.add_line(buffer + (ensemble_>1 ? ".resize(n_*ensemble_size);" : ".resize(n_);"));
+        }
+    }
+    text_.add_line("modcc::parallel_for_ranges(n_, num_threads,");
+    increase_indentation();
+    text_.add_gutter() << "[this](int begin_, int end_) {"
+                       << e->name() << (use_partials ? "_partial" : "")
+                       << "(begin_, end_);});";
+    text_.end_line();
+    decrease_indentation();
+
+    if(use_partials) {
+        text_.add_line();
+        text_.add_line("// accumulate the partial results in instance order");
+        print_indexed_views(e, false, true);
+        text_.add_line("for(int i_=0; i_<n_; ++i_) {");
+        increase_indentation();
+        open_lane_loop(true);
+        for(auto out: outs) {
+            auto ext = out->external_variable();
+            text_.add_gutter();
+            ext->accept(this);
+            text_ << (ext->op() == tok::plus ? " += " : " -= ");
+            text_ << "partial_" << ext->index_name() << "_[" << lane_index("i_") << "];";
+            text_.end_line();
+        }
+        close_lane_loop();
+        decrease_indentation();
+        text_.add_line("}");
+    }
+    decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
+
+    if(use_partials) {
+        partial_output_ = true;
+        print_APIMethod_range(e, e->name() + "_partial");
+        partial_output_ = false;
+    }
+}
+
+// Print the body of the kernel for the instance i_, for the fused kernels of
+// a mechanism group. The group loads the indexed inputs once for all of its
+// mechanisms and passes them as arguments, and every mechanism adds its
+// contributions to accumulators, which the group adds to the indexed arrays.
+void CPrinter::print_APIMethod_fused(APIMethod* e) {
+    text_.add_gutter() << "void " << e->name() << "_fused_(int i_";
+    for(auto in: indexed_inputs(e)) {
+        text_ << ", value_type " << in->name();
+    }
+    for(auto out: indexed_outputs(e)) {
+        text_ << ", value_type& " << out->external_variable()->index_name();
+    }
+    text_.end_line(") {");
+    increase_indentation();
+
+    e->body()->accept(this);
+
+    for(auto out: indexed_outputs(e)) {
+        auto ext = out->external_variable();
+        text_.add_gutter() << ext->index_name()
+                           << (ext->op() == tok::plus ? " += " : " -= ");
+        out->accept(this);
+        text_.end_line(";");
+    }
+
+    decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
+}
+
 void CPrinter::print_APIMethod_unoptimized(APIMethod* e) {
-    //text_.add_line("START_PROFILE");
 
     // there can not be more than 1 instance of a density channel per grid point,
     // so we can assert that aliasing will not occur.
     if(optimize_) text_.add_line("#pragma ivdep");
 
-    text_.add_line("for(int i_=0; i_<n_; ++i_) {");
+    text_.add_line("for(int i_=begin_; i_<end_; ++i_) {");
     text_.increase_indentation();
+    open_lane_loop(true);
 
     // loads from external indexed arrays
     for(auto &symbol : e->scope()->locals()) {
@@ -661,17 +2239,22 @@ void CPrinter::print_APIMethod_unoptimized(APIMethod* e) {
         if(is_output(var)) {
             auto ext = var->external_variable();
             text_.add_gutter();
-            ext->accept(this);
-            text_ << (ext->op() == tok::plus ? " += " : " -= ");
+            if(partial_output_) {
+                text_ << "partial_" << ext->index_name() << "_[" << lane_index("i_") << "] = ";
+            }
+            else {
+                ext->accept(this);
+                text_ << (ext->op() == tok::plus ? " += " : " -= ");
+            }
             var->accept(this);
             text_.end_line(";");
         }
     }
 
+    close_lane_loop();
     text_.decrease_indentation();
     text_.add_line("}");
 
-    //text_.add_line("STOP_PROFILE");
     decrease_indentation();
 
     return;
@@ -710,17 +2293,16 @@ void CPrinter::print_APIMethod_optimized(APIMethod* e) {
     // ------------- block loop ------------- //
 
     text_.add_line("constexpr int BSIZE = 4;");
-    text_.add_line("int NB = n_/BSIZE;");
+    text_.add_line("int NB = (end_-begin_)/BSIZE;");
     for(auto out: aliased_variables) {
         text_.add_line(
             "__declspec(align(vector_type::alignment())) value_type "
             + out->name() +  "[BSIZE];");
     }
-    //text_.add_line("START_PROFILE");
 
     text_.add_line("for(int b_=0; b_<NB; ++b_) {");
     text_.increase_indentation();
-    text_.add_line("int BSTART = BSIZE*b_;");
+    text_.add_line("int BSTART = begin_ + BSIZE*b_;");
     text_.add_line("int i_ = BSTART;");
 
 
@@ -771,7 +2353,7 @@ void CPrinter::print_APIMethod_optimized(APIMethod* e) {
 
     text_.add_line("int j_ = 0;");
     text_.add_line("#pragma ivdep");
-    text_.add_line("for(int i_=NB*BSIZE; i_<n_; ++j_, ++i_) {");
+    text_.add_line("for(int i_=begin_+NB*BSIZE; i_<end_; ++j_, ++i_) {");
     text_.increase_indentation();
 
     for(auto &symbol : e->scope()->locals()) {
@@ -791,7 +2373,7 @@ void CPrinter::print_APIMethod_optimized(APIMethod* e) {
     text_.decrease_indentation();
     text_.add_line("}"); // end inner compute loop
     text_.add_line("j_ = 0;");
-    text_.add_line("for(int i_=NB*BSIZE; i_<n_; ++j_, ++i_) {");
+    text_.add_line("for(int i_=begin_+NB*BSIZE; i_<end_; ++j_, ++i_) {");
     text_.increase_indentation();
 
     for(auto out: aliased_variables) {
@@ -806,15 +2388,130 @@ void CPrinter::print_APIMethod_optimized(APIMethod* e) {
     text_.decrease_indentation();
     text_.add_line("}"); // end block tail loop
 
-    //text_.add_line("STOP_PROFILE");
     decrease_indentation();
 
     aliased_output_ = false;
     return;
 }
 
+void CPrinter::print_APIMethod_fission(
+    APIMethod* e, std::vector<FissionGroup> const& groups)
+{
+    // locals referenced in more than one loop, and the outputs that are
+    // written back after the last loop, are carried in scratch buffers
+    std::map<Symbol*, int> use_count;
+    for(auto const& g : groups) {
+        for(auto var : g.locals) {
+            use_count[var]++;
+        }
+    }
+    std::vector<LocalVariable*> scratch;
+    std::vector<LocalVariable*> outputs;
+    for(auto &symbol : e->scope()->locals()) {
+        auto var = symbol.second->is_local_variable();
+        if(is_output(var)) {
+            outputs.push_back(var);
+            scratch.push_back(var);
+        }
+        else if(!is_input(var) && use_count[var]>1) {
+            scratch.push_back(var);
+        }
+    }
+    scratch_locals_.insert(scratch.begin(), scratch.end());
+
+    // ------------- scratch buffers ------------- //
+    text_.add_gutter() << "// loop fission: " << groups.size()
+                       << " loops with at most " << max_streams_ << " streams";
+    text_.end_line();
+    text_.add_line("constexpr int BSIZE = 64;");
+    for(auto var: scratch) {
+        if(optimize_) {
+            text_.add_line(
+                "__declspec(align(vector_type::alignment())) value_type "
+                + var->name() +  "[BSIZE];");
+        }
+        else {
+            text_.add_line("value_type " + var->name() + "[BSIZE];");
+        }
+    }
+
+    // ------------- block loop ------------- //
+    text_.add_line("for(int b_=begin_; b_<end_; b_+=BSIZE) {");
+    text_.increase_indentation();
+    text_.add_line("int bn_ = end_-b_<BSIZE ? end_-b_ : BSIZE;");
+
+    for(auto const& g : groups) {
+        text_.add_gutter() << "// " << g.streams.size() << " streams";
+        text_.end_line();
+        if(optimize_) text_.add_line("#pragma ivdep");
+        text_.add_line("for(int j_=0; j_<bn_; ++j_) {");
+        text_.increase_indentation();
+        text_.add_line("int i_ = b_+j_;");
+
+        // loads from external indexed arrays, and declarations of locals that
+        // are only used in this loop
+        std::vector<std::string> names;
+        for(auto &symbol : e->scope()->locals()) {
+            auto var = symbol.second->is_local_variable();
+            if(!g.locals.count(var) || is_scratch_local(var)) continue;
+            if(is_input(var)) {
+                auto ext = var->external_variable();
+                text_.add_gutter() << "value_type ";
+                var->accept(this);
+                text_ << " = ";
+                ext->accept(this);
+                text_.end_line(";");
+            }
+            else if(is_stack_local(var)) {
+                names.push_back(var->name());
+            }
+        }
+        if(names.size()>0) {
+            text_.add_gutter() << "value_type " << *(names.begin());
+            for(auto it=names.begin()+1; it!=names.end(); ++it) {
+                text_ << ", " << *it;
+            }
+            text_.end_line(";");
+        }
+
+        for(auto stmt : g.statements) {
+            print_statement(stmt);
+        }
+        line_directives_.restore(text_);
+
+        text_.decrease_indentation();
+        text_.add_line("}");
+    }
+
+    // ------------- write back ------------- //
+    // not vectorized, because the outputs of point processes can alias
+    if(outputs.size()) {
+        text_.add_line("for(int j_=0; j_<bn_; ++j_) {");
+        text_.increase_indentation();
+        text_.add_line("int i_ = b_+j_;");
+        for(auto out: outputs) {
+            text_.add_gutter();
+            auto ext = out->external_variable();
+            ext->accept(this);
+            text_ << (ext->op() == tok::plus ? " += " : " -= ");
+            out->accept(this);
+            text_.end_line(";");
+        }
+        text_.decrease_indentation();
+        text_.add_line("}");
+    }
+
+    text_.decrease_indentation();
+    text_.add_line("}"); // end outer block loop
+
+    decrease_indentation();
+
+    scratch_locals_.clear();
+    return;
+}
+
 void CPrinter::visit(CallExpression *e) {
-    text_ << e->name() << "(i_";
+    text_ << e->name() << (ensemble_>1 ? "(i_, k_" : "(i_");
     for(auto& arg: e->args()) {
         text_ << ", ";
         arg->accept(this);
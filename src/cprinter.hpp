@@ -1,15 +1,51 @@
 #pragma once
 
+#include <set>
 #include <sstream>
 
+#include "linedirectives.hpp"
+#include "loopfission.hpp"
 #include "module.hpp"
 #include "textbuffer.hpp"
 #include "visitor.hpp"
 
+/// options that control the code generated by CPrinter
+struct CPrinterOptions {
+    bool optimize = false;
+    // maximum number of arrays touched by one loop, 0 disables loop fission
+    int max_streams = 0;
+    // store fields whose tolerance annotation allows it in single precision
+    bool mixed_precision = false;
+    // generate multi-threaded entry points for the API methods
+    bool threads = false;
+    // initialize storage with the same partition of instances over threads
+    // as the parallel kernels, implies threads
+    bool first_touch = false;
+    // generate a version of each kernel for every supported x86 instruction
+    // set, and select one at run time
+    bool multi_isa = false;
+    // print #line directives that map the statements in kernels to the
+    // .mod file, output_name is the name of the generated file
+    bool line_directives = false;
+    std::string output_name;
+    // number of parameter sets simulated at once, stored in the inner
+    // dimension of every field and indexed array
+    int ensemble = 1;
+    // print versions of nrn_state and nrn_current that process one instance,
+    // which are called by the fused kernels of a mechanism group
+    bool fused = false;
+};
+
+/// the local variables of an API method that are loaded from indexed arrays
+/// before the body of the kernel, and accumulated in indexed arrays after it
+std::vector<LocalVariable*> indexed_inputs(APIMethod* e);
+std::vector<LocalVariable*> indexed_outputs(APIMethod* e);
+
 class CPrinter : public Visitor {
 public:
     CPrinter() {}
     CPrinter(Module &m, bool o=false);
+    CPrinter(Module &m, CPrinterOptions const& opts);
 
     void visit(Expression *e)           override;
     void visit(UnaryExpression *e)      override;
@@ -17,6 +53,7 @@ public:
     void visit(AssignmentExpression *e) override;
     void visit(PowBinaryExpression *e)  override;
     void visit(NumberExpression *e)     override;
+    void visit(RandomExpression *e)     override;
     void visit(VariableExpression *e)   override;
 
     void visit(Symbol *e)               override;
@@ -26,6 +63,7 @@ public:
     void visit(IdentifierExpression *e) override;
     void visit(CallExpression *e)       override;
     void visit(ProcedureExpression *e)  override;
+    void visit(TableLookupExpression *e) override;
     void visit(APIMethod *e)            override;
     void visit(LocalDeclaration *e)     override;
     void visit(BlockExpression *e)      override;
@@ -48,6 +86,22 @@ private:
 
     void print_APIMethod_optimized(APIMethod* e);
     void print_APIMethod_unoptimized(APIMethod* e);
+    void print_APIMethod_fission(APIMethod* e, std::vector<FissionGroup> const& groups);
+    void print_APIMethod_range(APIMethod* e, std::string const& name);
+    void print_APIMethod_kernel(APIMethod* e, std::string const& name, std::string const& attributes="");
+    void print_kernel_selection();
+    void print_APIMethod_parallel(APIMethod* e);
+    void print_APIMethod_fused(APIMethod* e);
+    void print_table_update();
+    void print_dt_cache_update();
+    void print_advance();
+    void print_deliver_events();
+    void print_indexed_views(APIMethod* e, bool inputs=true, bool outputs=true);
+    void print_statement(Expression* stmt);
+    void open_lane_loop(bool simd=false);
+    void close_lane_loop();
+    std::string lane_index(std::string const& i) const;
+    std::vector<LocalVariable*> outputs(APIMethod* e);
 
     Module *module_ = nullptr;
     tok parent_op_ = tok::eq;
@@ -55,6 +109,42 @@ private:
     bool optimize_ = false;
     bool aliased_output_ = false;
 
+    // maximum number of arrays touched by one loop when loop fission is
+    // enabled, 0 disables loop fission
+    int max_streams_ = 0;
+    // locals carried between loops in block sized scratch buffers
+    std::set<Symbol*> scratch_locals_;
+    bool mixed_precision_ = false;
+    bool threads_ = false;
+    bool first_touch_ = false;
+    bool multi_isa_ = false;
+    // range entry points that dispatch to an instruction set specific kernel
+    std::vector<std::string> dispatched_kernels_;
+    // procedures that build the lookup tables of TABLE statements
+    std::vector<ProcedureExpression*> table_builders_;
+    // computes the decay factors that depend only on dt and parameters
+    ProcedureExpression* dt_cache_ = nullptr;
+    // advances the states of an instance by k time steps
+    ProcedureExpression* advance_ = nullptr;
+    // the NET_RECEIVE block of a point process
+    ProcedureExpression* net_receive_ = nullptr;
+    // printing the body of NET_RECEIVE, whose random draws are counted by
+    // the events of the instance
+    bool in_event_ = false;
+    bool has_random_events() const {
+        return net_receive_ && module_->random_sites();
+    }
+    LineDirectives line_directives_;
+    // write outputs to per-instance partial buffers instead of accumulating
+    // them in the indexed arrays, used by the parallel point process kernels
+    bool partial_output_ = false;
+    // names of the partial buffers used by the parallel kernels
+    std::set<std::string> partial_buffers_;
+    // number of ensemble lanes, the lane k_ of instance i_ is stored at
+    // ensemble_size*i_+k_
+    int ensemble_ = 1;
+    bool fused_ = false;
+
     bool is_input(Symbol *s) {
         if(auto l = s->is_local_variable() ) {
             if(l->is_local()) {
@@ -103,6 +193,10 @@ private:
         return is_output(s);
     }
 
+    bool is_scratch_local(Symbol *s) {
+        return scratch_locals_.count(s)>0;
+    }
+
     bool is_stack_local(Symbol *s) {
         if(is_arg_local(s))    return false;
         return !is_ghost_local(s);
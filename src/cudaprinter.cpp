@@ -7,7 +7,12 @@
 ******************************************************************************/
 
 CUDAPrinter::CUDAPrinter(Module &m, bool o)
-    :   module_(&m)
+    :   CUDAPrinter(m, o, "")
+{}
+
+CUDAPrinter::CUDAPrinter(Module &m, bool o, std::string const& output_name)
+    :   module_(&m),
+        line_directives_(m.file_name(), output_name)
 {
     // make a list of vector types, both parameters and assigned
     // and a list of all scalar types
@@ -82,6 +87,9 @@ CUDAPrinter::CUDAPrinter(Module &m, bool o)
     param_pack.push_back("vec_v_.data()");
     param_pack.push_back("vec_i_.data()");
 
+    text_.add_line("T* vec_g;");
+    param_pack.push_back("vec_g_.data()");
+
     text_.add_line("T* vec_area;");
     param_pack.push_back("vec_area_.data()");
 
@@ -476,6 +484,7 @@ CUDAPrinter::CUDAPrinter(Module &m, bool o)
 
     text_.add_line("using base::vec_v_;");
     text_.add_line("using base::vec_i_;");
+    text_.add_line("using base::vec_g_;");
     text_.add_line("using base::vec_area_;");
     text_.add_line("using base::node_index_;");
     text_.add_line();
@@ -499,6 +508,11 @@ void CUDAPrinter::visit(NumberExpression *e) {
     text_ << " " << e->value();
 }
 
+void CUDAPrinter::visit(RandomExpression *e) {
+    throw compiler_exception(
+        "the gpu target doesn't support " + e->to_string(), e->location());
+}
+
 void CUDAPrinter::visit(IdentifierExpression *e) {
     e->symbol()->accept(this);
 }
@@ -608,10 +622,15 @@ void CUDAPrinter::visit(BlockExpression *e) {
     for(auto& stmt : e->statements()) {
         if(stmt->is_local_declaration()) continue;
         // these all must be handled
+        line_directives_.source(text_, stmt->location());
         text_.add_gutter();
         stmt->accept(this);
         text_.end_line(";");
     }
+
+    if(!e->is_nested()) {
+        line_directives_.restore(text_);
+    }
 }
 
 void CUDAPrinter::visit(IfExpression *e) {
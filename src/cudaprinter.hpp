@@ -2,6 +2,7 @@
 
 #include <sstream>
 
+#include "linedirectives.hpp"
 #include "module.hpp"
 #include "textbuffer.hpp"
 #include "visitor.hpp"
@@ -10,6 +11,10 @@ class CUDAPrinter : public Visitor {
 public:
     CUDAPrinter() {}
     CUDAPrinter(Module &m, bool o=false);
+    // print #line directives that map the statements in kernels to the .mod
+    // file, where output_name is the name of the generated file, or no
+    // directives if it is empty
+    CUDAPrinter(Module &m, bool o, std::string const& output_name);
 
     void visit(Expression *e)           override;
     void visit(UnaryExpression *e)      override;
@@ -17,6 +22,7 @@ public:
     void visit(AssignmentExpression *e) override;
     void visit(PowBinaryExpression *e)  override;
     void visit(NumberExpression *e)     override;
+    void visit(RandomExpression *e)     override;
     void visit(VariableExpression *e)   override;
 
     void visit(Symbol *e)               override;
@@ -104,6 +110,7 @@ private:
     Module *module_ = nullptr;
     tok parent_op_ = tok::eq;
     TextBuffer text_;
+    LineDirectives line_directives_;
     //bool optimize_ = false;
 };
 
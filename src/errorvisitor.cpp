@@ -55,6 +55,26 @@ void ErrorVisitor::visit(InitialBlock* e) {
     print_error(e);
 }
 
+// a reaction in a KINETIC block
+void ErrorVisitor::visit(ReactionExpression *e) {
+    for(auto& expression : e->lhs()) {
+        expression->accept(this);
+    }
+    for(auto& expression : e->rhs()) {
+        expression->accept(this);
+    }
+    e->fwd_rate()->accept(this);
+    e->bwd_rate()->accept(this);
+
+    print_error(e);
+}
+
+void ErrorVisitor::visit(ConserveExpression *e) {
+    e->lhs()->accept(this);
+    e->rhs()->accept(this);
+    print_error(e);
+}
+
 // unary expresssion
 void ErrorVisitor::visit(UnaryExpression *e) {
     e->expression()->accept(this);
@@ -20,6 +20,8 @@ public:
     void visit(BlockExpression *e)      override;
     void visit(InitialBlock *e)         override;
     void visit(IfExpression *e)         override;
+    void visit(ReactionExpression *e)   override;
+    void visit(ConserveExpression *e)   override;
 
     int num_errors()   {return num_errors_;}
     int num_warnings() {return num_warnings_;}
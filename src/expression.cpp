@@ -34,6 +34,14 @@ std::string to_string(procedureKind k) {
             return "breakpoint";
         case procedureKind::derivative  :
             return "derivative";
+        case procedureKind::kinetic     :
+            return "kinetic";
+        case procedureKind::table       :
+            return "table";
+        case procedureKind::dt_cache    :
+            return "dt_cache";
+        case procedureKind::advance     :
+            return "advance";
         default :
             return "undefined";
     }
@@ -131,6 +139,16 @@ expression_ptr NumberExpression::clone() const {
     return make_expression<NumberExpression>(location_, value_);
 }
 
+/*******************************************************************************
+  RandomExpression
+*******************************************************************************/
+
+expression_ptr RandomExpression::clone() const {
+    auto e = make_expression<RandomExpression>(location_, op_);
+    e->is_random()->site(site_);
+    return e;
+}
+
 /*******************************************************************************
   LocalDeclaration
 *******************************************************************************/
@@ -530,6 +548,14 @@ expression_ptr UnaryExpression::clone() const {
     return unary_expression(location_, op_, expression_->clone());
 }
 
+/*******************************************************************************
+  TableLookupExpression
+*******************************************************************************/
+
+expression_ptr TableLookupExpression::clone() const {
+    return make_expression<TableLookupExpression>(location_, name_, expression_->clone());
+}
+
 /*******************************************************************************
   BinaryExpression
 *******************************************************************************/
@@ -632,6 +658,102 @@ expression_ptr ConductanceExpression::clone() const {
     return expression_ptr{s};
 }
 
+/*******************************************************************************
+  ReactionExpression
+*******************************************************************************/
+
+std::string ReactionExpression::to_string() const {
+    auto side = [](std::vector<expression_ptr> const& species) {
+        std::string s;
+        for(auto& e : species) {
+            s += (s.size() ? " + " : "") + e->to_string();
+        }
+        return s;
+    };
+    return blue("reaction") + "(" + side(lhs_) + " <-> " + side(rhs_) + ", "
+        + fwd_rate_->to_string() + ", " + bwd_rate_->to_string() + ")";
+}
+
+void ReactionExpression::semantic(std::shared_ptr<scope_type> scp) {
+    scope_ = scp;
+
+    // the species on both sides of a reaction must be state variables
+    auto check_species = [this, scp] (std::vector<expression_ptr>& species) {
+        for(auto& e : species) {
+            e->semantic(scp);
+            if(e->has_error()) continue;
+            auto id  = e->is_identifier();
+            auto var = id && id->symbol() ? id->symbol()->is_variable() : nullptr;
+            if(!var || !var->is_state()) {
+                error("'" + e->to_string() + "' is not a STATE variable");
+            }
+        }
+    };
+    check_species(lhs_);
+    check_species(rhs_);
+
+    // the system of a reaction scheme is linear in the states only if all of
+    // the reactions are first order
+    if(lhs_.size()!=1 || rhs_.size()!=1) {
+        error("only first order reactions, with one STATE on each side, are supported");
+    }
+    else if(lhs_[0]->is_identifier()->spelling()==rhs_[0]->is_identifier()->spelling()) {
+        error("'" + lhs_[0]->to_string() + "' is on both sides of the reaction");
+    }
+
+    fwd_rate_->semantic(scp);
+    bwd_rate_->semantic(scp);
+}
+
+expression_ptr ReactionExpression::clone() const {
+    auto clone_species = [](std::vector<expression_ptr> const& species) {
+        std::vector<expression_ptr> c;
+        for(auto& e : species) {
+            c.emplace_back(e->clone());
+        }
+        return c;
+    };
+    return make_expression<ReactionExpression>(
+            location_, clone_species(lhs_), clone_species(rhs_),
+            fwd_rate_->clone(), bwd_rate_->clone());
+}
+
+/*******************************************************************************
+  ConserveExpression
+*******************************************************************************/
+
+void ConserveExpression::semantic(std::shared_ptr<scope_type> scp) {
+    scope_ = scp;
+    lhs_->semantic(scp);
+    rhs_->semantic(scp);
+}
+
+expression_ptr ConserveExpression::clone() const {
+    return make_expression<ConserveExpression>(location_, lhs_->clone(), rhs_->clone());
+}
+
+/*******************************************************************************
+  TableExpression
+*******************************************************************************/
+
+std::string TableExpression::to_string() const {
+    auto list = [] (std::vector<std::string> const& names) {
+        std::string s;
+        for(auto& name : names) {
+            s += (s.size() ? ", " : "") + yellow(name);
+        }
+        return s;
+    };
+    return blue("table") + "(" + list(names_) + "; " + blue("depend") + " "
+        + list(depends_) + "; " + pprintf("% to % with %", from_, to_, n_) + ")";
+}
+
+expression_ptr TableExpression::clone() const {
+    auto e = make_expression<TableExpression>(location_, names_, depends_, from_, to_, n_);
+    e->is_table_statement()->lookups() = lookups_;
+    return e;
+}
+
 /*******************************************************************************
   BlockExpression
 *******************************************************************************/
@@ -734,6 +856,15 @@ void SolveExpression::accept(Visitor *v) {
 void ConductanceExpression::accept(Visitor *v) {
     v->visit(this);
 }
+void ReactionExpression::accept(Visitor *v) {
+    v->visit(this);
+}
+void ConserveExpression::accept(Visitor *v) {
+    v->visit(this);
+}
+void TableExpression::accept(Visitor *v) {
+    v->visit(this);
+}
 void DerivativeExpression::accept(Visitor *v) {
     v->visit(this);
 }
@@ -776,6 +907,12 @@ void UnaryExpression::accept(Visitor *v) {
 void NegUnaryExpression::accept(Visitor *v) {
     v->visit(this);
 }
+void TableLookupExpression::accept(Visitor *v) {
+    v->visit(this);
+}
+void RandomExpression::accept(Visitor *v) {
+    v->visit(this);
+}
 void ExpUnaryExpression::accept(Visitor *v) {
     v->visit(this);
 }
@@ -48,6 +48,11 @@ class PowBinaryExpression;
 class ConditionalExpression;
 class SolveExpression;
 class ConductanceExpression;
+class ReactionExpression;
+class ConserveExpression;
+class TableExpression;
+class TableLookupExpression;
+class RandomExpression;
 class Symbol;
 class LocalVariable;
 
@@ -77,7 +82,11 @@ enum class procedureKind {
     initial,     ///< INITIAL
     net_receive, ///< NET_RECEIVE
     breakpoint,  ///< BREAKPOINT
-    derivative   ///< DERIVATIVE
+    derivative,  ///< DERIVATIVE
+    kinetic,     ///< KINETIC
+    table,       ///< builds the lookup tables of a TABLE statement
+    dt_cache,    ///< computes the coefficients that depend only on dt
+    advance      ///< advances the states of linear ODEs by k time steps
 };
 std::string to_string(procedureKind k);
 
@@ -93,13 +102,17 @@ std::string to_string(symbolKind k);
 
 /// methods for time stepping state
 enum class solverMethod {
-    cnexp, // the only method we have at the moment
+    cnexp,          // DERIVATIVE blocks with linear ODEs
+    sparse,         // KINETIC blocks, or DERIVATIVE blocks solved implicitly
+    derivimplicit,  // DERIVATIVE blocks solved implicitly
     none
 };
 
 static std::string to_string(solverMethod m) {
     switch(m) {
         case solverMethod::cnexp : return std::string("cnexp");
+        case solverMethod::sparse: return std::string("sparse");
+        case solverMethod::derivimplicit: return std::string("derivimplicit");
         case solverMethod::none  : return std::string("none");
     }
     return std::string("<error : undefined solverMethod>");
@@ -165,6 +178,10 @@ public:
     virtual SolveExpression*       is_solve_statement()   {return nullptr;}
     virtual Symbol*                is_symbol()            {return nullptr;}
     virtual ConductanceExpression* is_conductance_statement() {return nullptr;}
+    virtual ReactionExpression*    is_reaction()          {return nullptr;}
+    virtual ConserveExpression*    is_conserve_statement() {return nullptr;}
+    virtual TableExpression*       is_table_statement()   {return nullptr;}
+    virtual RandomExpression*      is_random()            {return nullptr;}
 
     virtual bool is_lvalue() {return false;}
 
@@ -324,6 +341,39 @@ private:
     long double value_;
 };
 
+// a random number drawn with one of the intrinsics random_uniform(),
+// random_exponential() or random_normal()
+class RandomExpression : public Expression {
+public:
+    RandomExpression(Location loc, tok op)
+    :   Expression(loc), op_(op)
+    {}
+
+    /// the distribution that is drawn from
+    tok op() const {return op_;}
+
+    /// The draw sites of a module are numbered, so that every site draws
+    /// from a different stream of random numbers. The number is -1 until
+    /// the module has numbered the sites.
+    int site() const {return site_;}
+    void site(int s) {site_ = s;}
+
+    std::string to_string() const override {
+        return blue(token_string(op_)) + "()";
+    }
+
+    // do nothing for semantic analysis
+    void semantic(std::shared_ptr<scope_type> scp) override {};
+    expression_ptr clone() const override;
+
+    RandomExpression* is_random() override {return this;}
+
+    void accept(Visitor *v) override;
+private:
+    tok op_;
+    int site_ = -1;
+};
+
 // declaration of a LOCAL variable
 class LocalDeclaration : public Expression {
 public:
@@ -438,6 +488,11 @@ public:
     double value()       const {return value_;}
     void value(double v) {value_ = v;}
 
+    // tolerance annotation, NaN if the variable has no annotation
+    double tolerance()       const {return tolerance_;}
+    void tolerance(double t) {tolerance_ = t;}
+    bool has_tolerance()     const {return tolerance_ == tolerance_;}
+
     void accept(Visitor *v) override;
     VariableExpression* is_variable() override {return this;}
 
@@ -451,6 +506,7 @@ protected:
     rangeKind      range_kind_  = rangeKind::range;
     ionKind        ion_channel_ = ionKind::none;
     double         value_       = std::numeric_limits<double>::quiet_NaN();
+    double         tolerance_   = std::numeric_limits<double>::quiet_NaN();
 };
 
 // an indexed variable
@@ -674,6 +730,145 @@ private:
     ionKind ion_channel_;
 };
 
+// a reaction in a KINETIC block
+//      ~ lhs <-> rhs (fwd, bwd)
+// where lhs and rhs are the state variables on each side of the reaction,
+// and fwd and bwd are the forward and backward rates
+class ReactionExpression : public Expression {
+public:
+    ReactionExpression(
+            Location loc,
+            std::vector<expression_ptr>&& lhs,
+            std::vector<expression_ptr>&& rhs,
+            expression_ptr&& fwd,
+            expression_ptr&& bwd)
+    :   Expression(loc), lhs_(std::move(lhs)), rhs_(std::move(rhs)),
+        fwd_rate_(std::move(fwd)), bwd_rate_(std::move(bwd))
+    {}
+
+    std::string to_string() const override;
+
+    std::vector<expression_ptr>& lhs() {
+        return lhs_;
+    }
+
+    std::vector<expression_ptr>& rhs() {
+        return rhs_;
+    }
+
+    Expression* fwd_rate() {
+        return fwd_rate_.get();
+    }
+
+    Expression* bwd_rate() {
+        return bwd_rate_.get();
+    }
+
+    void replace_fwd_rate(expression_ptr&& e) {
+        fwd_rate_ = std::move(e);
+    }
+
+    void replace_bwd_rate(expression_ptr&& e) {
+        bwd_rate_ = std::move(e);
+    }
+
+    ReactionExpression* is_reaction() override {
+        return this;
+    }
+
+    expression_ptr clone() const override;
+
+    void semantic(std::shared_ptr<scope_type> scp) override;
+    void accept(Visitor *v) override;
+
+    ~ReactionExpression() {}
+private:
+    std::vector<expression_ptr> lhs_;
+    std::vector<expression_ptr> rhs_;
+    expression_ptr fwd_rate_;
+    expression_ptr bwd_rate_;
+};
+
+// a CONSERVE statement in a KINETIC block
+//      CONSERVE lhs = rhs
+class ConserveExpression : public Expression {
+public:
+    ConserveExpression(Location loc, expression_ptr&& lhs, expression_ptr&& rhs)
+    :   Expression(loc), lhs_(std::move(lhs)), rhs_(std::move(rhs))
+    {}
+
+    std::string to_string() const override {
+        return blue("conserve") + "(" + lhs_->to_string() + ", "
+            + rhs_->to_string() + ")";
+    }
+
+    Expression* lhs() {
+        return lhs_.get();
+    }
+
+    Expression* rhs() {
+        return rhs_.get();
+    }
+
+    ConserveExpression* is_conserve_statement() override {
+        return this;
+    }
+
+    expression_ptr clone() const override;
+
+    void semantic(std::shared_ptr<scope_type> scp) override;
+    void accept(Visitor *v) override;
+
+    ~ConserveExpression() {}
+private:
+    expression_ptr lhs_;
+    expression_ptr rhs_;
+};
+
+// a TABLE statement in a FUNCTION or PROCEDURE
+//      TABLE names DEPEND depends FROM from TO to WITH n
+// the names are empty for a FUNCTION, whose value is tabulated
+class TableExpression : public Expression {
+public:
+    TableExpression(Location loc,
+                    std::vector<std::string> names,
+                    std::vector<std::string> depends,
+                    double from, double to, int n)
+    :   Expression(loc),
+        names_(std::move(names)), depends_(std::move(depends)),
+        from_(from), to_(to), n_(n)
+    {}
+
+    std::string to_string() const override;
+
+    std::vector<std::string>& names()   {return names_;}
+    std::vector<std::string>& depends() {return depends_;}
+    double from() const {return from_;}
+    double to()   const {return to_;}
+    int    n()    const {return n_;}
+
+    /// the names of the lookup tables of the names, which are set when the
+    /// TABLE is lowered
+    std::vector<std::string>& lookups() {return lookups_;}
+
+    TableExpression* is_table_statement() override {
+        return this;
+    }
+
+    expression_ptr clone() const override;
+
+    void accept(Visitor *v) override;
+
+    ~TableExpression() {}
+private:
+    std::vector<std::string> names_;
+    std::vector<std::string> depends_;
+    std::vector<std::string> lookups_;
+    double from_;
+    double to_;
+    int n_;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // recursive if statement
 // requires a BlockExpression that is a simple wrapper around a std::list
@@ -867,11 +1062,20 @@ public:
     /// from a special block, e.g. BREAKPOINT, INITIAL, NET_RECEIVE, etc
     procedureKind kind() const {return kind_;}
 
+    /// the TABLE of a procedure that builds lookup tables
+    TableExpression* table() {
+        return table_ ? table_->is_table_statement() : nullptr;
+    }
+    void table(expression_ptr&& t) {
+        table_ = std::move(t);
+    }
+
 protected:
     Symbol* symbol_;
 
     std::vector<expression_ptr> args_;
     expression_ptr body_;
+    expression_ptr table_;
     procedureKind kind_ = procedureKind::normal;
 };
 
@@ -1052,6 +1256,28 @@ public:
     void accept(Visitor *v) override;
 };
 
+/// lookup with linear interpolation in a table that is built from a TABLE
+/// statement, i.e. lookup(name, x)
+class TableLookupExpression : public UnaryExpression {
+public:
+    TableLookupExpression(Location loc, std::string name, expression_ptr e)
+    :   UnaryExpression(loc, tok::table, std::move(e)),
+        name_(std::move(name))
+    {}
+
+    std::string to_string() const override {
+        return pprintf("(% % %)", green("lookup"), yellow(name_), expression_->to_string());
+    }
+
+    /// the name of the lookup table
+    std::string const& name() const {return name_;}
+
+    expression_ptr clone() const override;
+    void accept(Visitor *v) override;
+private:
+    std::string name_;
+};
+
 ////////////////////////////////////////////////////////////
 // binary expressions
 
@@ -18,6 +18,11 @@ void ExpressionClassifierVisitor::visit(NumberExpression *e) {
     coefficient_ = e->clone();
 }
 
+// a random draw doesn't depend on the symbol
+void ExpressionClassifierVisitor::visit(RandomExpression *e) {
+    coefficient_ = e->clone();
+}
+
 // identifier expresssion
 void ExpressionClassifierVisitor::visit(IdentifierExpression *e) {
     // check if symbol of identifier matches the identifier
@@ -48,6 +53,7 @@ void ExpressionClassifierVisitor::visit(UnaryExpression *e) {
             case tok::cos :
             case tok::sin :
             case tok::log :
+            case tok::table :
                 is_linear_ = false;
                 return;
             default :
@@ -37,6 +37,7 @@ public:
     void visit(UnaryExpression *e)      override;
     void visit(BinaryExpression *e)     override;
     void visit(NumberExpression *e)     override;
+    void visit(RandomExpression *e)     override;
     void visit(IdentifierExpression *e) override;
     void visit(CallExpression *e)       override;
 
@@ -122,6 +122,32 @@ void VariableReplacer::visit(BinaryExpression *e) {
     }
 }
 
+void VariableReplacer::visit(CallExpression *e) {
+    for(auto& arg : e->args()) {
+        auto id = arg->is_identifier();
+        if(id && id->spelling()==source_) {
+            arg = make_expression<IdentifierExpression>(id->location(), target_);
+        }
+        else if(!id) {
+            arg->accept(this);
+        }
+    }
+}
+
+void VariableReplacer::visit(IfExpression *e) {
+    e->condition()->accept(this);
+    e->true_branch()->accept(this);
+    if(e->false_branch()) {
+        e->false_branch()->accept(this);
+    }
+}
+
+void VariableReplacer::visit(BlockExpression *e) {
+    for(auto& s : *e) {
+        s->accept(this);
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //  value inliner
 ///////////////////////////////////////////////////////////////////////////////
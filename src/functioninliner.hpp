@@ -19,7 +19,12 @@ public:
     void visit(Expression *e)           override;
     void visit(UnaryExpression *e)      override;
     void visit(BinaryExpression *e)     override;
+    void visit(CallExpression *e)       override;
+    void visit(IfExpression *e)         override;
+    void visit(BlockExpression *e)      override;
     void visit(NumberExpression *e)     override {};
+    void visit(RandomExpression *e)     override {};
+    void visit(LocalDeclaration *e)     override {};
 
     ~VariableReplacer() {}
 
@@ -42,6 +47,7 @@ public:
     void visit(UnaryExpression *e)      override;
     void visit(BinaryExpression *e)     override;
     void visit(NumberExpression *e)     override {};
+    void visit(RandomExpression *e)     override {};
 
     ~ValueInliner() {}
 
@@ -0,0 +1,357 @@
+#include <map>
+#include <set>
+#include <string>
+
+#include "groupprinter.hpp"
+
+/******************************************************************************
+                              GroupPrinter
+******************************************************************************/
+
+static APIMethod* find_api_method(Module* m, std::string const& name) {
+    auto it = m->symbols().find(name);
+    if(it==m->symbols().end()) return nullptr;
+    return it->second->is_api_method();
+}
+
+static std::string member_name(Module* m) {
+    return m->name() + "_";
+}
+
+// the kernels that are fused
+static const char* fused_methods[] = {"nrn_state", "nrn_current"};
+
+std::string GroupPrinter::check(std::vector<Module*> const& modules) {
+    // the contributions to the indexed arrays are added after all of the
+    // mechanisms have run, so no mechanism may read an array that another
+    // mechanism writes in the same kernel
+    for(auto method: fused_methods) {
+        for(auto writer: modules) {
+            auto w = find_api_method(writer, method);
+            if(!w) continue;
+            for(auto out: indexed_outputs(w)) {
+                auto const& index_name = out->external_variable()->index_name();
+                for(auto reader: modules) {
+                    auto r = find_api_method(reader, method);
+                    if(reader==writer || !r) continue;
+                    for(auto in: indexed_inputs(r)) {
+                        if(in->external_variable()->index_name()==index_name) {
+                            return std::string(method) + " of " + reader->name()
+                                + " reads " + index_name + ", which is written by "
+                                + writer->name();
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return "";
+}
+
+GroupPrinter::GroupPrinter(
+    std::vector<Module*> const& modules, std::string const& name,
+    CPrinterOptions const& opts)
+:   modules_(modules),
+    name_(name),
+    options_(opts)
+{
+    options_.fused = true;
+
+    // the mechanisms are printed one after the other, with the include guard
+    // of the first one
+    bool first = true;
+    for(auto m: modules_) {
+        std::istringstream mechanism(CPrinter(*m, options_).text());
+        std::string line;
+        while(std::getline(mechanism, line)) {
+            if(line=="#pragma once" && !first) continue;
+            text_.add_line(line);
+        }
+        text_.add_line();
+        first = false;
+    }
+
+    print_group();
+}
+
+void GroupPrinter::print_group() {
+    std::string class_name = "mechanism_" + name_;
+
+    text_.add_line("namespace nest{ namespace mc{ namespace mechanisms{ namespace " + name_ + "{");
+    text_.add_line();
+    text_.add_gutter() << "// the mechanisms";
+    for(auto m: modules_) {
+        text_ << " " << m->name();
+    }
+    text_.end_line(" on the same nodes, with kernels that");
+    text_.add_line("// load the voltage and ion values once for all of the mechanisms");
+    text_.add_line("template<typename T, typename I>");
+    text_.add_line("class " + class_name + " : public mechanism<T, I> {");
+    text_.add_line("public:");
+    text_.increase_indentation();
+    text_.add_line("using base = mechanism<T, I>;");
+    text_.add_line("using value_type  = typename base::value_type;");
+    text_.add_line("using size_type   = typename base::size_type;");
+    text_.add_line("using view_type   = typename base::view_type;");
+    text_.add_line("using const_index_view  = typename base::const_index_view;");
+    text_.add_line("using indexed_view_type= typename base::indexed_view_type;");
+    text_.add_line("using ion_type = typename base::ion_type;");
+    text_.add_line();
+
+    //////////////////////////////////////////////
+    // constructor
+    //////////////////////////////////////////////
+    text_.add_line(class_name + "(view_type vec_v, view_type vec_i, const_index_view node_index)");
+    text_.add_line(":   base(vec_v, vec_i, node_index),");
+    for(auto i=0u; i<modules_.size(); ++i) {
+        text_.add_line("    " + member_name(modules_[i]) + "(vec_v, vec_i, node_index)"
+                       + (i+1<modules_.size() ? "," : ""));
+    }
+    text_.add_line("{}");
+    text_.add_line();
+    text_.add_line("using base::size;");
+    text_.add_line();
+
+    // prints a method that calls the same method of every mechanism
+    auto print_forward = [this] (std::string const& signature, std::string const& call) {
+        text_.add_line(signature + " {");
+        text_.increase_indentation();
+        for(auto m: modules_) {
+            text_.add_line(member_name(m) + "." + call + ";");
+        }
+        text_.decrease_indentation();
+        text_.add_line("}");
+        text_.add_line();
+    };
+
+    text_.add_line("std::size_t memory() const override {");
+    text_.increase_indentation();
+    text_.add_line("auto s = std::size_t{0};");
+    for(auto m: modules_) {
+        text_.add_line("s += " + member_name(m) + ".memory();");
+    }
+    text_.add_line("return s;");
+    text_.decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
+
+    print_forward("void set_params(value_type t_, value_type dt_) override", "set_params(t_, dt_)");
+
+    text_.add_line("std::string name() const override {");
+    text_.increase_indentation();
+    text_.add_line("return \"" + name_ + "\";");
+    text_.decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
+
+    text_.add_line("mechanismKind kind() const override {");
+    text_.increase_indentation();
+    text_.add_line("return mechanismKind::density;");
+    text_.decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
+
+    text_.add_line("bool uses_ion(ionKind k) const override {");
+    text_.increase_indentation();
+    text_.add_gutter() << "return ";
+    for(auto i=0u; i<modules_.size(); ++i) {
+        text_ << (i ? " || " : "") << member_name(modules_[i]) << ".uses_ion(k)";
+    }
+    text_.end_line(";");
+    text_.decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
+
+    text_.add_line("void set_ion(ionKind k, ion_type& i) override {");
+    text_.increase_indentation();
+    for(auto m: modules_) {
+        text_.add_line("if(" + member_name(m) + ".uses_ion(k)) " + member_name(m) + ".set_ion(k, i);");
+    }
+    text_.decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
+
+    // the initial conditions are not fused, because nrn_init also builds the
+    // tables and the decay factors of every mechanism
+    print_forward("void nrn_init() override", "nrn_init()");
+
+    for(auto method: fused_methods) {
+        print_kernel(method);
+    }
+
+    //////////////////////////////////////////////
+    //////////////////////////////////////////////
+    for(auto m: modules_) {
+        text_.add_line(m->name() + "::mechanism_" + m->name() + "<T, I> " + member_name(m) + ";");
+    }
+    text_.add_line();
+    text_.add_line("using base::vec_v_;");
+    text_.add_line("using base::vec_i_;");
+    text_.add_line("using base::vec_g_;");
+    text_.add_line("using base::node_index_;");
+    text_.add_line();
+    text_.decrease_indentation();
+    text_.add_line("};");
+    text_.add_line();
+
+    // the helper type that provides the bridge from the group to the calling
+    // code, as for a single mechanism
+    text_.add_line("template<typename T, typename I>");
+    text_.add_line("struct helper : public mechanism_helper<T, I> {");
+    text_.increase_indentation();
+    text_.add_line("using base = mechanism_helper<T, I>;");
+    text_.add_line("using index_view  = typename base::index_view;");
+    text_.add_line("using view_type  = typename base::view_type;");
+    text_.add_line("using mechanism_ptr_type  = typename base::mechanism_ptr_type;");
+    text_.add_line("using mechanism_type = " + class_name + "<T, I>;");
+    text_.add_line();
+    text_.add_line("std::string");
+    text_.add_line("name() const override");
+    text_.add_line("{");
+    text_.add_line("    return \"" + name_ + "\";");
+    text_.add_line("}");
+    text_.add_line();
+    text_.add_line("mechanism_ptr<T,I>");
+    text_.add_line("new_mechanism(view_type vec_v, view_type vec_i, index_view node_index) const override");
+    text_.add_line("{");
+    text_.add_line("    return nest::mc::mechanisms::make_mechanism<mechanism_type>(vec_v, vec_i, node_index);");
+    text_.add_line("}");
+    text_.add_line();
+    text_.add_line("void");
+    text_.add_line("set_parameters(mechanism_ptr_type&, parameter_list const&) const override");
+    text_.add_line("{");
+    text_.add_line("}");
+    text_.add_line();
+    text_.decrease_indentation();
+    text_.add_line("};");
+    text_.add_line();
+    text_.add_line("}}}} // namespaces");
+}
+
+// print the entry points and the fused kernel of one API method
+void GroupPrinter::print_kernel(std::string const& method) {
+    // the indexed arrays that are read and written by the mechanisms, with
+    // the name of the local variable that holds the value of the instance,
+    // and the mechanism that holds the ion views
+    struct indexed_array {
+        LocalVariable* var;
+        Module* module;
+        bool read;
+        bool write;
+    };
+    std::map<std::string, indexed_array> arrays;
+    std::vector<std::string> inputs;
+    std::vector<std::string> outputs;
+    // members without the method take no part in the kernel, as in check()
+    for(auto m: modules_) {
+        auto e = find_api_method(m, method);
+        if(!e) continue;
+        for(auto in: indexed_inputs(e)) {
+            auto const& index_name = in->external_variable()->index_name();
+            if(!arrays.count(index_name)) {
+                arrays[index_name] = {in, m, false, false};
+            }
+            if(!arrays[index_name].read) {
+                inputs.push_back(index_name);
+            }
+            arrays[index_name].read = true;
+        }
+        for(auto out: indexed_outputs(e)) {
+            auto const& index_name = out->external_variable()->index_name();
+            if(!arrays.count(index_name)) {
+                arrays[index_name] = {out, m, false, false};
+            }
+            if(!arrays[index_name].write) {
+                outputs.push_back(index_name);
+            }
+            arrays[index_name].write = true;
+        }
+    }
+
+    // the random numbers of every call of a kernel are different
+    auto print_random_counters = [this] () {
+        for(auto m: modules_) {
+            if(m->random_sites()) {
+                text_.add_line("++" + member_name(m) + ".random_counter_;");
+            }
+        }
+    };
+
+    // ------------- serial entry point ------------- //
+    text_.add_line("void " + method + "() override {");
+    text_.increase_indentation();
+    text_.add_line("MODCC_PROFILE_KERNEL(\"" + name_ + "\", \"" + method + "\", node_index_.size());");
+    print_random_counters();
+    text_.add_line(method + "(0, node_index_.size());");
+    text_.decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
+
+    // ------------- parallel entry point ------------- //
+    // the instances of density mechanisms are on different nodes, so the
+    // ranges can update the indexed arrays concurrently
+    if(options_.threads || options_.first_touch) {
+        text_.add_line("void " + method + "_parallel(int num_threads) {");
+        text_.increase_indentation();
+        text_.add_line("MODCC_PROFILE_KERNEL(\"" + name_ + "\", \"" + method + "_parallel\", node_index_.size());");
+        print_random_counters();
+        text_.add_line("int n_ = node_index_.size();");
+        text_.add_line("modcc::parallel_for_ranges(n_, num_threads,");
+        text_.add_line("    [this](int begin_, int end_) {" + method + "(begin_, end_);});");
+        text_.decrease_indentation();
+        text_.add_line("}");
+        text_.add_line();
+    }
+
+    // ------------- range entry point ------------- //
+    text_.add_line("void " + method + "(int begin_, int end_) {");
+    text_.increase_indentation();
+    for(auto const& a: arrays) {
+        auto const& index_name = a.first;
+        auto var = a.second.var;
+        auto channel = var->external_variable()->ion_channel();
+        text_.add_gutter();
+        if(!a.second.write) text_ << "const ";
+        text_ << "indexed_view_type " << index_name;
+        if(channel==ionKind::none) {
+            text_ << "(" << index_name << "_, node_index_);";
+        }
+        else {
+            auto store = member_name(a.second.module) + "." + ion_store(channel);
+            text_ << "(" << store << "." << var->name() << ", " << store << ".index);";
+        }
+        text_.end_line();
+    }
+    text_.add_line("for(int i_=begin_; i_<end_; ++i_) {");
+    text_.increase_indentation();
+    for(auto const& index_name: inputs) {
+        text_.add_line("value_type " + arrays[index_name].var->name() + " = " + index_name + "[i_];");
+    }
+    if(outputs.size()) {
+        text_.add_gutter() << "value_type ";
+        for(auto i=0u; i<outputs.size(); ++i) {
+            text_ << (i ? ", " : "") << arrays[outputs[i]].var->name() << " = 0";
+        }
+        text_.end_line(";");
+    }
+    for(auto m: modules_) {
+        auto e = find_api_method(m, method);
+        if(!e) continue;
+        text_.add_gutter() << member_name(m) << "." << method << "_fused_(i_";
+        for(auto in: indexed_inputs(e)) {
+            text_ << ", " << arrays[in->external_variable()->index_name()].var->name();
+        }
+        for(auto out: indexed_outputs(e)) {
+            text_ << ", " << arrays[out->external_variable()->index_name()].var->name();
+        }
+        text_.end_line(");");
+    }
+    for(auto const& index_name: outputs) {
+        text_.add_line(index_name + "[i_] += " + arrays[index_name].var->name() + ";");
+    }
+    text_.decrease_indentation();
+    text_.add_line("}");
+    text_.decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "cprinter.hpp"
+#include "module.hpp"
+#include "textbuffer.hpp"
+
+/// Prints a mechanism group: the density mechanisms as printed by CPrinter,
+/// followed by a mechanism that holds one instance of each of them on the same
+/// nodes. The nrn_state and nrn_current kernels of the group load the voltage
+/// and ion values once for all of the mechanisms, call the body of each
+/// mechanism for the instance, and add the sum of the currents to the indexed
+/// arrays once.
+class GroupPrinter {
+public:
+    GroupPrinter(std::vector<Module*> const& modules, std::string const& name,
+                 CPrinterOptions const& opts);
+
+    std::string text() const {
+        return text_.str();
+    }
+
+    /// the reason why the kernels of the modules can't be fused, or an empty
+    /// string if they can be
+    static std::string check(std::vector<Module*> const& modules);
+
+private:
+    void print_group();
+    void print_kernel(std::string const& method);
+
+    std::vector<Module*> modules_;
+    std::string name_;
+    CPrinterOptions options_;
+    TextBuffer text_;
+};
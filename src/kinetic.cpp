@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "kinetic.hpp"
+#include "linearsolve.hpp"
+#include "parser.hpp"
+#include "util.hpp"
+
+void lower_reaction_rates(BlockExpression* body) {
+    auto& statements = body->statements();
+    auto id = [] (std::string const& name, Location loc) {
+        return make_expression<IdentifierExpression>(loc, name);
+    };
+
+    auto n = 0;
+    for(auto e=statements.begin(); e!=statements.end(); ++e) {
+        auto reaction = (*e)->is_reaction();
+        if(!reaction) continue;
+
+        auto loc = reaction->location();
+        auto kf = pprintf("kf%_", n);
+        auto kb = pprintf("kb%_", n);
+        ++n;
+
+        std::list<expression_ptr> rates;
+        rates.push_back(make_expression<LocalDeclaration>(loc, kf));
+        rates.push_back(make_expression<LocalDeclaration>(loc, kb));
+        rates.push_back(binary_expression(loc, tok::eq, id(kf, loc), reaction->fwd_rate()->clone()));
+        rates.push_back(binary_expression(loc, tok::eq, id(kb, loc), reaction->bwd_rate()->clone()));
+        reaction->replace_fwd_rate(id(kf, loc));
+        reaction->replace_bwd_rate(id(kb, loc));
+
+        statements.splice(e, rates);
+    }
+}
+
+std::list<expression_ptr> kinetic_update(ProcedureExpression* kinetic) {
+    std::list<expression_ptr> body;
+
+    // the statements of the solve are given the location of the KINETIC
+    // block, which is used by #line directives
+    auto loc = kinetic->location();
+    auto statement = [&body, loc] (std::string const& s) {
+        auto e = Parser(s).parse_line_expression();
+        auto ass = e->is_assignment();
+        body.push_back(binary_expression(
+            loc, tok::eq, ass->lhs()->clone(), ass->rhs()->clone()));
+    };
+    auto local = [&body, loc] (std::string const& name) {
+        body.push_back(make_expression<LocalDeclaration>(loc, name));
+    };
+
+    // the unknowns are the states in the reactions, in order of appearance
+    std::vector<std::string> species;
+    auto index = [&species] (expression_ptr const& e) {
+        auto const& name = e->is_identifier()->spelling();
+        auto it = std::find(species.begin(), species.end(), name);
+        if(it!=species.end()) return int(it-species.begin());
+        species.push_back(name);
+        return int(species.size())-1;
+    };
+
+    // the rates that contribute to each entry of the matrix
+    //      A = I - dt*M
+    // the reaction x_i <-> x_j has the flux kf*x_i - kb*x_j from x_i to x_j,
+    // which adds dt*kf and dt*kb to the diagonal entries of x_i and x_j,
+    // and subtracts them from the off diagonal entries
+    std::map<std::pair<int, int>, std::vector<std::string>> rates;
+    for(auto& e : *kinetic->body()) {
+        if(auto reaction = e->is_reaction()) {
+            auto i = index(reaction->lhs()[0]);
+            auto j = index(reaction->rhs()[0]);
+            auto const& kf = reaction->fwd_rate()->is_identifier()->spelling();
+            auto const& kb = reaction->bwd_rate()->is_identifier()->spelling();
+            rates[{i, i}].push_back(kf);
+            rates[{j, i}].push_back(kf);
+            rates[{j, j}].push_back(kb);
+            rates[{i, j}].push_back(kb);
+        }
+        // backward Euler conserves the sum of the states in a closed scheme,
+        // so CONSERVE statements are not needed
+        else if(!e->is_conserve_statement()) {
+            body.push_back(e->clone());
+        }
+    }
+
+    int n = species.size();
+    if(n==0) return body;
+
+    auto x = linear_solve_x;
+    auto a = linear_solve_a;
+    auto sum = [] (std::vector<std::string> const& terms) {
+        std::string s;
+        for(auto& t : terms) {
+            s += (s.size() ? "+" : "") + t;
+        }
+        return terms.size()>1 ? "(" + s + ")" : s;
+    };
+
+    matrix_structure nonzero(n, std::vector<bool>(n, false));
+    for(auto i=0; i<n; ++i) {
+        nonzero[i][i] = true;
+    }
+    for(auto& r : rates) {
+        nonzero[r.first.first][r.first.second] = true;
+    }
+    auto fill = linear_solve_fill(nonzero);
+
+    // copy the states to the right hand side
+    for(auto i=0; i<n; ++i) {
+        local(x(i));
+        statement(x(i) + " = " + species[i]);
+    }
+
+    // assemble the matrix
+    for(auto i=0; i<n; ++i) {
+        for(auto j=0; j<n; ++j) {
+            if(fill[i][j]) local(a(i, j));
+        }
+    }
+    local("f_");
+    for(auto i=0; i<n; ++i) {
+        for(auto j=0; j<n; ++j) {
+            if(!nonzero[i][j]) continue;
+            auto it = rates.find({i, j});
+            if(i==j) {
+                statement(a(i, i) + " = 1"
+                    + (it==rates.end() ? "" : " + dt*" + sum(it->second)));
+            }
+            else {
+                statement(a(i, j) + " = -dt*" + sum(it->second));
+            }
+        }
+    }
+
+    // Gaussian elimination without pivoting is stable, because A is
+    // diagonally dominant by columns: the off diagonal entries of a column
+    // sum to the rates of the diagonal entry, which is 1 + dt*rates
+    body.splice(body.end(), linear_solve(nonzero, loc));
+
+    // update the states
+    for(auto i=0; i<n; ++i) {
+        statement(species[i] + " = " + x(i));
+    }
+
+    return body;
+}
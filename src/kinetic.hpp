@@ -0,0 +1,31 @@
+#pragma once
+
+#include <list>
+
+#include "expression.hpp"
+
+/// Assign the forward and backward rates of the reactions in the body of a
+/// KINETIC block to local variables, so that the rates are analysed and their
+/// function calls are inlined like any other statement
+///     ~ A <-> B (alpha(v), beta(v))
+/// becomes
+///     LOCAL kf0_, kb0_
+///     kf0_ = alpha(v)
+///     kb0_ = beta(v)
+///     ~ A <-> B (kf0_, kb0_)
+void lower_reaction_rates(BlockExpression* body);
+
+/// The statements that advance the states of a KINETIC block by one time step.
+///
+/// The first order reactions make a linear system of ODEs
+///     x' = M x
+/// which is integrated with backward Euler, by solving the linear system
+///     (I - dt*M) x_new = x
+/// for every instance. The structure of the matrix, and the fill-in of the
+/// elimination, are known at compile time, so the solve is unrolled into
+/// straight line code that is vectorized across instances like the other
+/// statements of nrn_state, with statements only for the nonzero entries.
+/// The statements in the block that are not reactions are kept, in order,
+/// before the solve.
+/// Expects a block on which lower_reaction_rates has been called.
+std::list<expression_ptr> kinetic_update(ProcedureExpression* kinetic);
@@ -167,7 +167,12 @@ Token Lexer::parse() {
             // comparison binary operators
             case '<': {
                 t.spelling += character();
-                if(*current_=='=') {
+                if(current_[0]=='-' && current_[1]=='>') {
+                    t.spelling += character();
+                    t.spelling += character();
+                    t.type = tok::arrow;
+                }
+                else if(*current_=='=') {
                     t.spelling += character();
                     t.type = tok::lte;
                 }
@@ -187,6 +192,10 @@ Token Lexer::parse() {
                 }
                 return t;
             }
+            case '~':
+                t.type = tok::tilde;
+                t.spelling += character();
+                return t;
             case '\'':
                 t.type = tok::prime;
                 t.spelling += character();
@@ -256,6 +265,11 @@ std::string Lexer::number() {
             uses_scientific_notation++;
             str += c;
             current_++;
+            // the exponent may be signed, e.g. 1e-4
+            if(*current_=='-' || *current_=='+') {
+                str += *current_;
+                current_++;
+            }
         }
         else {
             break;
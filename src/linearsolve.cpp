@@ -0,0 +1,71 @@
+#include "linearsolve.hpp"
+#include "parser.hpp"
+#include "util.hpp"
+
+std::string linear_solve_a(int i, int j) {
+    return pprintf("a%_%_", i, j);
+}
+
+std::string linear_solve_x(int i) {
+    return pprintf("x%_", i);
+}
+
+matrix_structure linear_solve_fill(matrix_structure const& nonzero) {
+    int n = nonzero.size();
+    auto fill = nonzero;
+    for(auto k=0; k<n; ++k) {
+        for(auto i=k+1; i<n; ++i) {
+            if(!fill[i][k]) continue;
+            for(auto j=k+1; j<n; ++j) {
+                if(fill[k][j]) fill[i][j] = true;
+            }
+        }
+    }
+    return fill;
+}
+
+std::list<expression_ptr> linear_solve(matrix_structure const& nonzero, Location loc) {
+    std::list<expression_ptr> body;
+    auto statement = [&body, loc] (std::string const& s) {
+        auto e = Parser(s).parse_line_expression();
+        auto ass = e->is_assignment();
+        body.push_back(binary_expression(
+            loc, tok::eq, ass->lhs()->clone(), ass->rhs()->clone()));
+    };
+    auto a = linear_solve_a;
+    auto x = linear_solve_x;
+
+    int n = nonzero.size();
+    auto fill = linear_solve_fill(nonzero);
+
+    // forward elimination
+    auto assigned = nonzero;
+    for(auto k=0; k<n; ++k) {
+        for(auto i=k+1; i<n; ++i) {
+            if(!fill[i][k]) continue;
+            statement("f_ = " + a(i, k) + "/" + a(k, k));
+            for(auto j=k+1; j<n; ++j) {
+                if(!fill[k][j]) continue;
+                if(assigned[i][j]) {
+                    statement(a(i, j) + " = " + a(i, j) + " - f_*" + a(k, j));
+                }
+                else {
+                    statement(a(i, j) + " = -f_*" + a(k, j));
+                    assigned[i][j] = true;
+                }
+            }
+            statement(x(i) + " = " + x(i) + " - f_*" + x(k));
+        }
+    }
+
+    // back substitution
+    for(auto i=n-1; i>=0; --i) {
+        std::string rhs = x(i);
+        for(auto j=i+1; j<n; ++j) {
+            if(fill[i][j]) rhs += " - " + a(i, j) + "*" + x(j);
+        }
+        statement(x(i) + " = (" + rhs + ")/" + a(i, i));
+    }
+
+    return body;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include "expression.hpp"
+
+/// the structure of the nonzero entries of a small matrix, known at compile time
+using matrix_structure = std::vector<std::vector<bool>>;
+
+/// the names of the local variables that hold the entries of the matrix A,
+/// and of the right hand side x, of a linear_solve
+std::string linear_solve_a(int i, int j);
+std::string linear_solve_x(int i);
+
+/// the structure of a matrix after Gaussian elimination, i.e. its nonzero
+/// entries and the fill-in of the elimination
+matrix_structure linear_solve_fill(matrix_structure const& nonzero);
+
+/// Statements that solve the linear system
+///     A x = b
+/// of every instance with Gaussian elimination, unrolled for the structure
+/// of A, so that the solve is straight line code that is vectorized across
+/// instances, with statements for the nonzero entries only.
+/// The nonzero entries of A have to be assigned to the locals linear_solve_a,
+/// and b to linear_solve_x, which is overwritten with the solution. The
+/// locals for the entries in linear_solve_fill(nonzero), and the multiplier
+/// f_, have to be declared.
+/// There is no pivoting, so A has to be diagonally dominant, or close to the
+/// identity.
+std::list<expression_ptr> linear_solve(matrix_structure const& nonzero, Location loc);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+
+#include "location.hpp"
+#include "textbuffer.hpp"
+
+/// Prints #line directives in generated code, so that compiler diagnostics,
+/// debuggers and profilers attribute the generated statements to the lines
+/// of the .mod file that they come from.
+/// The name of the generated file is needed to switch back to the generated
+/// file after the statements, and directives are only printed if it is given.
+class LineDirectives {
+public:
+    LineDirectives() = default;
+
+    LineDirectives(std::string const& source, std::string const& output)
+    :   source_(quote(source)),
+        output_(output.size() ? quote(output) : "")
+    {}
+
+    bool enabled() const {
+        return output_.size()>0;
+    }
+
+    /// the lines that follow come from loc in the .mod file
+    /// statements generated by the compiler are parsed from a single line
+    /// of text, so they have no line in the .mod file and keep the line of
+    /// the statement before them
+    void source(TextBuffer& text, Location loc) {
+        if(!enabled() || loc.line<=1) return;
+        text.add_line("#line " + std::to_string(loc.line) + " " + source_);
+        in_source_ = true;
+    }
+
+    /// the lines that follow come from the generated file
+    void restore(TextBuffer& text) {
+        if(!enabled() || !in_source_) return;
+        // the directive is on line n+1, and refers to the line after it
+        auto s = text.str();
+        auto n = std::count(s.begin(), s.end(), '\n');
+        text.add_line("#line " + std::to_string(n+2) + " " + output_);
+        in_source_ = false;
+    }
+
+private:
+    static std::string quote(std::string const& s) {
+        std::string q = "\"";
+        for(auto c : s) {
+            if(c=='"' || c=='\\') q += '\\';
+            q += c;
+        }
+        return q + "\"";
+    }
+
+    std::string source_;
+    std::string output_;
+    bool in_source_ = false;
+};
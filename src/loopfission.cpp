@@ -0,0 +1,117 @@
+#include "loopfission.hpp"
+#include "perfvisitor.hpp"
+
+/******************************************************************************
+                              LocalReferenceVisitor
+******************************************************************************/
+
+void LocalReferenceVisitor::visit(UnaryExpression *e) {
+    e->expression()->accept(this);
+}
+
+void LocalReferenceVisitor::visit(BinaryExpression *e) {
+    e->lhs()->accept(this);
+    e->rhs()->accept(this);
+}
+
+void LocalReferenceVisitor::visit(AssignmentExpression *e) {
+    if(auto id = e->lhs()->is_identifier()) {
+        if(auto var = id->symbol()->is_local_variable()) {
+            written_.insert(var);
+        }
+    }
+    e->lhs()->accept(this);
+    e->rhs()->accept(this);
+}
+
+void LocalReferenceVisitor::visit(IdentifierExpression *e) {
+    if(auto var = e->symbol()->is_local_variable()) {
+        locals_.insert(var);
+    }
+}
+
+void LocalReferenceVisitor::visit(CallExpression *e) {
+    for(auto& arg : e->args()) {
+        arg->accept(this);
+    }
+}
+
+void LocalReferenceVisitor::visit(BlockExpression *e) {
+    for(auto& stmt : *e) {
+        stmt->accept(this);
+    }
+}
+
+void LocalReferenceVisitor::visit(IfExpression *e) {
+    e->condition()->accept(this);
+    e->true_branch()->accept(this);
+    if(e->false_branch()) {
+        e->false_branch()->accept(this);
+    }
+}
+
+/******************************************************************************
+                              fission_api_method
+******************************************************************************/
+
+std::vector<FissionGroup> fission_api_method(APIMethod* e, int max_streams) {
+    std::vector<FissionGroup> groups(1);
+    if(max_streams<=0) {
+        for(auto& stmt : *(e->body())) {
+            if(!stmt->is_local_declaration()) {
+                groups.back().statements.push_back(stmt.get());
+            }
+        }
+        return groups;
+    }
+
+    // only locals declared at APIMethod scope have to be carried between loops
+    std::set<Symbol*> scope_locals;
+    for(auto& l : e->scope()->locals()) {
+        scope_locals.insert(l.second.get());
+    }
+
+    bool can_split = true;
+    for(auto& stmt : *(e->body())) {
+        if(stmt->is_local_declaration()) continue;
+
+        auto memops = make_unique<MemOpVisitor>();
+        stmt->accept(memops.get());
+        auto streams = memops->streams();
+
+        auto refs = make_unique<LocalReferenceVisitor>();
+        stmt->accept(refs.get());
+
+        // values loaded from indexed arrays are reloaded in every loop that
+        // uses them, which is only valid if they are never modified
+        for(auto var : refs->written()) {
+            if(var->is_indexed() && var->is_read()) {
+                can_split = false;
+            }
+        }
+
+        auto& current = groups.back();
+        if(current.statements.size()) {
+            auto merged = current.streams;
+            merged.insert(streams.begin(), streams.end());
+            if((int)merged.size() > max_streams) {
+                groups.emplace_back();
+            }
+        }
+
+        auto& group = groups.back();
+        group.statements.push_back(stmt.get());
+        group.streams.insert(streams.begin(), streams.end());
+        for(auto var : refs->locals()) {
+            if(scope_locals.count(var)) {
+                group.locals.insert(var);
+            }
+        }
+    }
+
+    if(!can_split && groups.size()>1) {
+        return fission_api_method(e, 0);
+    }
+
+    return groups;
+}
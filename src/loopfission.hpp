@@ -0,0 +1,45 @@
+#pragma once
+
+#include <set>
+#include <vector>
+
+#include "visitor.hpp"
+
+/// a run of consecutive top level statements in the body of an APIMethod
+/// that are printed together in one loop over a block of instances
+struct FissionGroup {
+    std::vector<Expression*> statements;
+    // the distinct arrays read or written by the statements
+    std::set<Symbol*> streams;
+    // local variables of the APIMethod referenced by the statements
+    std::set<LocalVariable*> locals;
+};
+
+/// Split the body of an APIMethod into groups of statements, such that each
+/// group touches at most max_streams distinct arrays.
+/// A single statement that on its own exceeds the budget is put in a group
+/// of its own. If the body can not be split, or does not have to be split,
+/// a single group with all of the statements is returned.
+std::vector<FissionGroup> fission_api_method(APIMethod* e, int max_streams);
+
+/// collects the local variables referenced in an expression
+/// does not descend into the bodies of called procedures, which have
+/// their own scope
+class LocalReferenceVisitor : public Visitor {
+public:
+    void visit(Expression *e)           override {}
+    void visit(UnaryExpression *e)      override;
+    void visit(BinaryExpression *e)     override;
+    void visit(AssignmentExpression *e) override;
+    void visit(IdentifierExpression *e) override;
+    void visit(CallExpression *e)       override;
+    void visit(BlockExpression *e)      override;
+    void visit(IfExpression *e)         override;
+
+    std::set<LocalVariable*> const& locals()  const { return locals_;  }
+    std::set<LocalVariable*> const& written() const { return written_; }
+
+private:
+    std::set<LocalVariable*> locals_;
+    std::set<LocalVariable*> written_;
+};
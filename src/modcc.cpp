@@ -1,43 +1,269 @@
 #include <chrono>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <set>
+#include <vector>
 
 #include <tclap/include/CmdLine.h>
 
+#include "analysis.hpp"
+#include "benchprinter.hpp"
+#include "costmodel.hpp"
 #include "cprinter.hpp"
 #include "cudaprinter.hpp"
+#include "groupprinter.hpp"
 #include "lexer.hpp"
 #include "module.hpp"
 #include "parser.hpp"
 #include "perfvisitor.hpp"
+#include "replayprinter.hpp"
+#include "roofline.hpp"
 #include "util.hpp"
+#include "vectorizationvisitor.hpp"
 
 //#define VERBOSE
 
-enum class targetKind {cpu, gpu};
+enum class targetKind {cpu, gpu, bench, replay};
 
 struct Options {
-    std::string filename;
+    std::vector<std::string> filenames;
     std::string outputname;
     bool has_output = false;
     bool verbose = true;
     bool optimize = false;
     bool analysis = false;
+    bool json = false;
+    int max_streams = 0;
+    bool mixed_precision = false;
+    bool threads = false;
+    bool first_touch = false;
+    bool multi_isa = false;
+    bool line_directives = false;
+    int ensemble = 1;
+    // the name of the mechanism group of the input files, if they are fused
+    std::string group;
+    std::string machine_file;
+    MachineModel machine;
+    CostModel const* cost_model = nullptr;
     targetKind target = targetKind::cpu;
 
-    void print() {
+    void print(std::string const& filename) {
         std::cout << cyan("." + std::string(60, '-') + ".") << std::endl;
         std::cout << cyan("| file     ") << filename << std::string(61-11-filename.size(),' ') << cyan("|") << std::endl;
         std::string outname = (outputname.size() ? outputname : "stdout");
         std::cout << cyan("| output   ") << outname << std::string(61-11-outname.size(),' ') << cyan("|") << std::endl;
         std::cout << cyan("| verbose  ") << (verbose  ? "yes" : "no ") << std::string(61-11-3,' ') << cyan("|") << std::endl;
         std::cout << cyan("| optimize ") << (optimize ? "yes" : "no ") << std::string(61-11-3,' ') << cyan("|") << std::endl;
-        std::cout << cyan("| target   ") << (target==targetKind::cpu? "cpu" : "gpu") << std::string(61-11-3,' ') << cyan("|") << std::endl;
+        std::string targstr = (target==targetKind::cpu ? "cpu" : target==targetKind::gpu ? "gpu"
+                             : target==targetKind::bench ? "bench" : "replay");
+        std::cout << cyan("| target   ") << targstr << std::string(61-11-targstr.size(),' ') << cyan("|") << std::endl;
         std::cout << cyan("| analysis ") << (analysis ? "yes" : "no ") << std::string(61-11-3,' ') << cyan("|") << std::endl;
+        std::cout << cyan("| machine  ") << machine.name << std::string(61-11-machine.name.size(),' ') << cyan("|") << std::endl;
+        std::cout << cyan("| cost     ") << cost_model->name << std::string(61-11-cost_model->name.size(),' ') << cyan("|") << std::endl;
+        std::string streams = (max_streams ? std::to_string(max_streams) : "off");
+        std::cout << cyan("| fission  ") << streams << std::string(61-11-streams.size(),' ') << cyan("|") << std::endl;
+        std::cout << cyan("| mixed    ") << (mixed_precision ? "yes" : "no ") << std::string(61-11-3,' ') << cyan("|") << std::endl;
+        std::cout << cyan("| threads  ") << (threads ? "yes" : "no ") << std::string(61-11-3,' ') << cyan("|") << std::endl;
+        std::cout << cyan("| numa     ") << (first_touch ? "yes" : "no ") << std::string(61-11-3,' ') << cyan("|") << std::endl;
+        std::cout << cyan("| isa      ") << (multi_isa ? "multi  " : "default") << std::string(61-11-7,' ') << cyan("|") << std::endl;
+        std::string lanes = (ensemble>1 ? std::to_string(ensemble) : "off");
+        std::cout << cyan("| ensemble ") << lanes << std::string(61-11-lanes.size(),' ') << cyan("|") << std::endl;
+        std::string groupstr = (group.size() ? group : "off");
+        std::cout << cyan("| group    ") << groupstr << std::string(61-11-groupstr.size(),' ') << cyan("|") << std::endl;
         std::cout << cyan("." + std::string(60, '-') + ".") << std::endl;
     }
 };
 
+CPrinterOptions printer_options(Options const& options) {
+    CPrinterOptions opts;
+    opts.optimize = options.optimize;
+    opts.max_streams = options.max_streams;
+    opts.mixed_precision = options.mixed_precision;
+    opts.threads = options.threads;
+    opts.first_touch = options.first_touch;
+    opts.multi_isa = options.multi_isa;
+    opts.line_directives = options.line_directives;
+    opts.ensemble = options.ensemble;
+    opts.output_name = options.has_output ? options.outputname : "";
+    return opts;
+}
+
+// Write the generated code to the output file, or to stdout.
+void write_output(std::string const& text, Options const& options) {
+    if(options.has_output) {
+        std::ofstream fout(options.outputname);
+        fout << text;
+        fout.close();
+    }
+    else {
+        std::cout << cyan("--------------------------------------") << std::endl;
+        std::cout << text;
+        std::cout << cyan("--------------------------------------") << std::endl;
+    }
+}
+
+// Compile one .mod file.
+// Returns the module after semantic analysis and optimization, or nullptr if
+// there was an error in the input.
+// With json analysis the JSON document is the only output on stdout, so the
+// generated code is only written if there is an output file, and messages
+// are written to stderr.
+std::unique_ptr<Module> compile(std::string const& filename, Options& options) {
+    std::ostream& out = options.json ? std::cerr : std::cout;
+
+    // load the module from file
+    auto m = make_unique<Module>(filename);
+
+    // check that the module is not empty
+    if(m->buffer().size()==0) {
+        out << red("error: ") << white(filename)
+           << " invalid or empty file" << std::endl;
+        return nullptr;
+    }
+
+    if(options.verbose) {
+        options.print(filename);
+    }
+
+    ////////////////////////////////////////////////////////////
+    // parsing
+    ////////////////////////////////////////////////////////////
+    if(options.verbose) std::cout << green("[") + "parsing" + green("]") << std::endl;
+
+    // initialize the parser
+    Parser p(*m, false);
+
+    // parse
+    p.parse();
+    if(p.status() == lexerStatus::error) return nullptr;
+
+    ////////////////////////////////////////////////////////////
+    // semantic analysis
+    ////////////////////////////////////////////////////////////
+    if(options.verbose)
+        std::cout << green("[") + "semantic analysis" + green("]") << "\n";
+
+    // the GPU kernels evaluate tabulated functions directly, because a
+    // lookup is a gather from global memory that costs more than the rates,
+    // and the CUDA printer does not update the coefficients cached for dt
+    m->use_tables(options.target!=targetKind::gpu);
+    m->use_dt_cache(options.target!=targetKind::gpu);
+    m->semantic();
+
+    if( m->has_error() || m->has_warning() ) {
+        out << m->error_string() << std::endl;
+    }
+
+    if(m->status() == lexerStatus::error) {
+        return nullptr;
+    }
+
+    // the random number intrinsics are only generated for the cpu
+    if(options.target==targetKind::gpu && m->random_sites()) {
+        out << red("error") << ": the gpu target doesn't support random_uniform(),"
+            << " random_exponential() and random_normal()" << std::endl;
+        return nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////
+    // optimize
+    ////////////////////////////////////////////////////////////
+    if(options.optimize) {
+        if(options.verbose) std::cout << green("[") + "optimize" + green("]") << std::endl;
+        m->optimize();
+        if(m->status() == lexerStatus::error) {
+            return nullptr;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////
+    // generate output
+    ////////////////////////////////////////////////////////////
+    if(options.json && !options.has_output) {
+        return m;
+    }
+
+    // the mechanisms of a group are printed together once all are compiled
+    if(options.group.size()) {
+        return m;
+    }
+
+    if(options.verbose) {
+        std::cout << green("[") + "code generation"
+                  << green("]") << std::endl;
+    }
+
+    std::string text;
+    auto opts = printer_options(options);
+    switch(options.target) {
+        case targetKind::cpu  :
+            text = CPrinter(*m, opts).text();
+            break;
+        case targetKind::bench  :
+            text = BenchPrinter(*m, opts).text();
+            break;
+        case targetKind::replay  :
+            text = ReplayPrinter(*m, opts).text();
+            break;
+        case targetKind::gpu  :
+            text = CUDAPrinter(*m, options.optimize,
+                               options.line_directives ? opts.output_name : "").text();
+            break;
+        default :
+            std::cerr << red("error") << ": unknown printer" << std::endl;
+            exit(1);
+    }
+
+    write_output(text, options);
+
+    out << yellow("successfully compiled ") << white(filename) << " -> " << white(options.outputname) << std::endl;
+
+    ////////////////////////////////////////////////////////////
+    // print module information
+    ////////////////////////////////////////////////////////////
+    if(options.analysis && !options.json) {
+        std::cout << green("performance analysis") << std::endl;
+        for(auto &symbol : m->symbols()) {
+            if(auto method = symbol.second->is_api_method()) {
+                std::cout << white("-------------------------") << std::endl;
+                std::cout << yellow("method " + method->name()) << std::endl;
+                std::cout << white("-------------------------") << std::endl;
+
+                auto flops = make_unique<FlopVisitor>();
+                method->accept(flops.get());
+                std::cout << white("FLOPS") << std::endl;
+                std::cout << flops->print() << std::endl;
+
+                std::cout << white("MEMOPS") << std::endl;
+                auto memops = make_unique<MemOpVisitor>();
+                method->accept(memops.get());
+                std::cout << memops->print() << std::endl;;
+
+                std::cout << white("ROOFLINE") << std::endl;
+                auto estimate = roofline(
+                    flops->flops, memops->bytes_per_instance(), options.machine);
+                std::cout << roofline_report(estimate, options.machine) << std::endl;
+
+                std::cout << white("COST") << std::endl;
+                auto cost = estimate_cost(method, *options.cost_model);
+                std::cout << cost_report(cost, *options.cost_model) << std::endl;
+
+                std::cout << white("VECTORIZATION") << std::endl;
+                auto vectorization = make_unique<VectorizationVisitor>(
+                    m->kind()==moduleKind::point, options.optimize);
+                method->accept(vectorization.get());
+                if(vectorization->diagnostics().empty()) {
+                    std::cout << "no statements that block vectorization" << std::endl;
+                }
+                std::cout << vectorization->print(filename) << std::endl;
+            }
+        }
+    }
+
+    return m;
+}
+
 int main(int argc, char **argv) {
 
     Options options;
@@ -46,34 +272,125 @@ int main(int argc, char **argv) {
     try {
         TCLAP::CmdLine cmd("welcome to mod2c", ' ', "0.1");
 
-        // input file name (to load multiple files we have to use UnlabeledMultiArg
-        TCLAP::UnlabeledValueArg<std::string>
-            fin_arg("input_file", "the name of the .mod file to compile", true, "", "filename");
+        // input file names
+        TCLAP::UnlabeledMultiArg<std::string>
+            fin_arg("input_file", "the names of the .mod files to compile", true, "filename");
         // output filename
         TCLAP::ValueArg<std::string>
             fout_arg("o","output","name of output file", false,"","filname");
         // output filename
         TCLAP::ValueArg<std::string>
-            target_arg("t","target","backend target={cpu,gpu}", true,"cpu","cpu/gpu");
+            target_arg("t","target","backend target={cpu,gpu,bench,replay}", true,"cpu","cpu/gpu/bench/replay");
         // verbose mode
         TCLAP::SwitchArg verbose_arg("V","verbose","toggle verbose mode", cmd, false);
         // analysis mode
         TCLAP::SwitchArg analysis_arg("A","analyse","toggle analysis mode", cmd, false);
+        // format of the analysis output
+        TCLAP::ValueArg<std::string>
+            analysis_format_arg("","analysis-format","format of the analysis={text,json}, json implies -A", false, "text", "text/json", cmd);
+        // machine description for the roofline model in analysis mode
+        TCLAP::ValueArg<std::string>
+            machine_arg("","machine","machine description file used by the roofline model in analysis mode", false, "", "filename", cmd);
+        // instruction costs used in analysis mode
+        TCLAP::ValueArg<std::string>
+            cost_model_arg("","cost-model","instruction costs used in analysis mode={haswell,skylake-x,zen2}", false, "haswell", "target", cmd);
         // optimization mode
         TCLAP::SwitchArg opt_arg("O","optimize","turn optimizations on", cmd, false);
+        // loop fission
+        TCLAP::ValueArg<int>
+            streams_arg("","max-streams","split kernel loops that touch more than this number of arrays (0 to disable)", false, 0, "integer", cmd);
+        // mixed precision storage
+        TCLAP::SwitchArg mixed_arg("","mixed-precision","store fields with a tolerance annotation of at least 1e-6 in single precision", cmd, false);
+        // multi-threaded entry points
+        TCLAP::SwitchArg threads_arg("","threads","generate multi-threaded nrn_*_parallel(num_threads) entry points", cmd, false);
+        // NUMA aware first touch initialization of storage
+        TCLAP::SwitchArg first_touch_arg("","first-touch","initialize storage in parallel with the partition used by the threaded kernels (implies --threads)", cmd, false);
+        // #line directives that map generated statements to the .mod file
+        TCLAP::SwitchArg line_directives_arg("","line-directives","print #line directives that attribute the statements in kernels to the .mod file", cmd, false);
+        // kernels for several instruction sets, selected at run time
+        TCLAP::SwitchArg multi_isa_arg("","multi-isa","generate SSE4.2, AVX2 and AVX-512 versions of each kernel, and select one at run time", cmd, false);
+        // one mechanism for several density mechanisms on the same nodes
+        TCLAP::ValueArg<std::string>
+            group_arg("","group","fuse the nrn_state and nrn_current kernels of the density mechanisms in the input files into one mechanism with this name", false, "", "name", cmd);
+        // ensembles of parameter sets that share the morphology
+        TCLAP::ValueArg<int>
+            ensemble_arg("","ensemble","simulate this number of parameter sets in the inner dimension of every field and indexed array", false, 1, "integer", cmd);
 
         cmd.add(fin_arg);
         cmd.add(fout_arg);
         cmd.add(target_arg);
 
-        cmd.parse(argc, argv);
+        // TCLAP expects the value of an option in a separate argument, so
+        // split long options given as --name=value
+        std::vector<std::string> args;
+        for(auto i=0; i<argc; ++i) {
+            std::string arg = argv[i];
+            auto pos = arg.find('=');
+            if(i>0 && arg.compare(0, 2, "--")==0 && pos!=std::string::npos) {
+                args.push_back(arg.substr(0, pos));
+                args.push_back(arg.substr(pos+1));
+            }
+            else {
+                args.push_back(arg);
+            }
+        }
+        cmd.parse(args);
 
         options.outputname = fout_arg.getValue();
         options.has_output = options.outputname.size()>0;
-        options.filename = fin_arg.getValue();
+        options.filenames = fin_arg.getValue();
         options.verbose = verbose_arg.getValue();
         options.optimize = opt_arg.getValue();
-        options.analysis = analysis_arg.getValue();
+        options.json = analysis_format_arg.getValue()=="json";
+        options.analysis = analysis_arg.getValue() || options.json;
+        options.max_streams = streams_arg.getValue();
+        options.mixed_precision = mixed_arg.getValue();
+        options.first_touch = first_touch_arg.getValue();
+        options.multi_isa = multi_isa_arg.getValue();
+        options.line_directives = line_directives_arg.getValue();
+        options.ensemble = ensemble_arg.getValue();
+        options.group = group_arg.getValue();
+        options.threads = threads_arg.getValue() || options.first_touch;
+        options.machine_file = machine_arg.getValue();
+        if(options.machine_file.size()) {
+            try {
+                options.machine = read_machine_model(options.machine_file);
+            }
+            catch(std::runtime_error& e) {
+                std::cerr << red("error") << " " << e.what() << std::endl;
+                return 1;
+            }
+        }
+        options.cost_model = CostModel::find(cost_model_arg.getValue());
+        if(!options.cost_model) {
+            std::cerr << red("error") << " cost-model must be one in {";
+            auto targets = CostModel::targets();
+            for(auto i=0u; i<targets.size(); ++i) {
+                std::cerr << (i ? ", " : "") << targets[i];
+            }
+            std::cerr << "}" << std::endl;
+            return 1;
+        }
+        if(!options.json && analysis_format_arg.getValue()!="text") {
+            std::cerr << red("error") << " analysis-format must be one in {text, json}" << std::endl;
+            return 1;
+        }
+        if(options.has_output && options.filenames.size()>1 && options.group.empty()) {
+            std::cerr << red("error") << " an output file can only be given for a single input file" << std::endl;
+            return 1;
+        }
+        if(options.json && options.verbose) {
+            std::cerr << red("error") << " verbose mode can't be used with json analysis" << std::endl;
+            return 1;
+        }
+        if(options.max_streams<0) {
+            std::cerr << red("error") << " max-streams must be non-negative" << std::endl;
+            return 1;
+        }
+        if(options.ensemble<1) {
+            std::cerr << red("error") << " ensemble must be positive" << std::endl;
+            return 1;
+        }
         auto targstr = target_arg.getValue();
         if(targstr == "cpu") {
             options.target = targetKind::cpu;
@@ -81,10 +398,40 @@ int main(int argc, char **argv) {
         else if(targstr == "gpu") {
             options.target = targetKind::gpu;
         }
+        else if(targstr == "bench") {
+            options.target = targetKind::bench;
+        }
+        else if(targstr == "replay") {
+            options.target = targetKind::replay;
+        }
         else {
-            std::cerr << red("error") << " target must be one in {cpu, gpu}" << std::endl;
+            std::cerr << red("error") << " target must be one in {cpu, gpu, bench, replay}" << std::endl;
             return 1;
         }
+        // the mechanisms of a group are printed in one file for the cpu
+        if(options.group.size()) {
+            if(options.target!=targetKind::cpu) {
+                std::cerr << red("error") << " group requires the cpu target" << std::endl;
+                return 1;
+            }
+            if(options.analysis || options.ensemble>1 || options.line_directives) {
+                std::cerr << red("error") << " group can't be used with analysis, ensemble"
+                          << " or line-directives" << std::endl;
+                return 1;
+            }
+        }
+        // the ensemble lanes are only added to the unoptimized cpu kernels
+        if(options.ensemble>1) {
+            if(options.target!=targetKind::cpu) {
+                std::cerr << red("error") << " ensemble requires the cpu target" << std::endl;
+                return 1;
+            }
+            if(options.optimize || options.max_streams || options.mixed_precision || options.first_touch) {
+                std::cerr << red("error") << " ensemble can't be used with optimize, max-streams,"
+                          << " mixed-precision or first-touch" << std::endl;
+                return 1;
+            }
+        }
     }
     // catch any exceptions in command line handling
     catch(TCLAP::ArgException &e) {
@@ -94,118 +441,55 @@ int main(int argc, char **argv) {
     }
 
     try {
-        // load the module from file passed as first argument
-        Module m(options.filename.c_str());
-
-        // check that the module is not empty
-        if(m.buffer().size()==0) {
-            std::cout << red("error: ") << white(argv[1])
-                      << " invalid or empty file" << std::endl;
-            return 1;
-        }
-
-        if(options.verbose) {
-            options.print();
-        }
-
-        ////////////////////////////////////////////////////////////
-        // parsing
-        ////////////////////////////////////////////////////////////
-        if(options.verbose) std::cout << green("[") + "parsing" + green("]") << std::endl;
-
-        // initialize the parser
-        Parser p(m, false);
-
-        // parse
-        p.parse();
-        if(p.status() == lexerStatus::error) return 1;
-
-        ////////////////////////////////////////////////////////////
-        // semantic analysis
-        ////////////////////////////////////////////////////////////
-        if(options.verbose)
-            std::cout << green("[") + "semantic analysis" + green("]") << "\n";
-
-        m.semantic();
-
-        if( m.has_error() || m.has_warning() ) {
-            std::cout << m.error_string() << std::endl;
-        }
-
-        if(m.status() == lexerStatus::error) {
-            return 1;
-        }
-
-        ////////////////////////////////////////////////////////////
-        // optimize
-        ////////////////////////////////////////////////////////////
-        if(options.optimize) {
-            if(options.verbose) std::cout << green("[") + "optimize" + green("]") << std::endl;
-            m.optimize();
-            if(m.status() == lexerStatus::error) {
+        std::vector<std::unique_ptr<Module>> modules;
+        for(auto const& filename : options.filenames) {
+            auto m = compile(filename, options);
+            if(!m) {
                 return 1;
             }
+            modules.push_back(std::move(m));
         }
 
-        ////////////////////////////////////////////////////////////
-        // generate output
-        ////////////////////////////////////////////////////////////
-        if(options.verbose) {
-            std::cout << green("[") + "code generation"
-                      << green("]") << std::endl;
-        }
-
-        std::string text;
-        switch(options.target) {
-            case targetKind::cpu  :
-                text = CPrinter(m, options.optimize).text();
-                break;
-            case targetKind::gpu  :
-                text = CUDAPrinter(m, options.optimize).text();
-                break;
-            default :
-                std::cerr << red("error") << ": unknown printer" << std::endl;
-                exit(1);
+        if(options.group.size()) {
+            std::vector<Module*> members;
+            std::set<std::string> names;
+            for(auto& m : modules) {
+                if(m->kind()!=moduleKind::density) {
+                    std::cerr << red("error") << " the point process " << m->name()
+                              << " can't be in a group" << std::endl;
+                    return 1;
+                }
+                if(m->name()==options.group) {
+                    std::cerr << red("error") << " the group can't have the name of the mechanism "
+                              << m->name() << std::endl;
+                    return 1;
+                }
+                if(!names.insert(m->name()).second) {
+                    std::cerr << red("error") << " the mechanism " << m->name()
+                              << " is in the group " << options.group << " twice" << std::endl;
+                    return 1;
+                }
+                members.push_back(m.get());
+            }
+            auto conflict = GroupPrinter::check(members);
+            if(conflict.size()) {
+                std::cerr << red("error") << " the kernels of the group " << options.group
+                          << " can't be fused: " << conflict << std::endl;
+                return 1;
+            }
+            write_output(GroupPrinter(members, options.group, printer_options(options)).text(), options);
+            std::cout << yellow("successfully compiled group ") << white(options.group)
+                      << " -> " << white(options.outputname) << std::endl;
         }
 
-        if(options.has_output) {
-            std::ofstream fout(options.outputname);
-            fout << text;
-            fout.close();
-        }
-        else {
-            std::cout << cyan("--------------------------------------") << std::endl;
-            std::cout << text;
-            std::cout << cyan("--------------------------------------") << std::endl;
-        }
-
-        std::cout << yellow("successfully compiled ") << white(options.filename) << " -> " << white(options.outputname) << std::endl;
-
-        ////////////////////////////////////////////////////////////
-        // print module information
-        ////////////////////////////////////////////////////////////
-        if(options.analysis) {
-            std::cout << green("performance analysis") << std::endl;
-            for(auto &symbol : m.symbols()) {
-                if(auto method = symbol.second->is_api_method()) {
-                    std::cout << white("-------------------------") << std::endl;
-                    std::cout << yellow("method " + method->name()) << std::endl;
-                    std::cout << white("-------------------------") << std::endl;
-
-                    auto flops = make_unique<FlopVisitor>();
-                    method->accept(flops.get());
-                    std::cout << white("FLOPS") << std::endl;
-                    std::cout << flops->print() << std::endl;
-
-                    std::cout << white("MEMOPS") << std::endl;
-                    auto memops = make_unique<MemOpVisitor>();
-                    method->accept(memops.get());
-                    std::cout << memops->print() << std::endl;;
-                }
+        if(options.json) {
+            std::vector<Module*> analysed;
+            for(auto& m : modules) {
+                analysed.push_back(m.get());
             }
+            std::cout << analysis_json(analysed, options.machine, *options.cost_model, options.optimize);
         }
     }
-
     catch(compiler_exception e) {
         std::cerr << red("internal compiler error: ")
                   << white("this means a bug in the compiler,"
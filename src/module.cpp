@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <cassert>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <set>
 
@@ -8,8 +9,12 @@
 #include "expressionclassifier.hpp"
 #include "functionexpander.hpp"
 #include "functioninliner.hpp"
+#include "kinetic.hpp"
 #include "module.hpp"
+#include "newton.hpp"
 #include "parser.hpp"
+#include "symdiff.hpp"
+#include "table.hpp"
 
 Module::Module(std::string const& fname)
 : fname_(fname)
@@ -141,6 +146,109 @@ bool Module::semantic() {
     std::cout << cyan("        Function Inlining\n");
     std::cout << white("===================================\n");
 #endif
+    // the rates of reactions are assigned to local variables before the
+    // semantic analysis, so that function calls in the rates are inlined
+    for(auto& e : symbols_) {
+        auto proc = e.second->is_procedure();
+        if(proc && proc->kind()==procedureKind::kinetic) {
+            lower_reaction_rates(proc->body());
+        }
+    }
+
+    // the statements of a FUNCTION or PROCEDURE with a TABLE are moved to a
+    // procedure that builds the tables, and replaced by lookups in the tables
+    std::vector<symbol_ptr> table_builders;
+    for(auto& e : symbols_) {
+        if(auto builder = lower_table(e.second.get(), *this)) {
+            table_builders.push_back(std::move(builder));
+        }
+    }
+    if(has_error()) return false;
+    if(!move_symbols(table_builders)) return false;
+
+    // lowers and inlines the function calls in a list of statements, and in
+    // the branches of the if statements in the list
+    std::function<void(std::list<expression_ptr>&)> inline_calls =
+        [&inline_calls] (std::list<expression_ptr>& b)
+    {
+        // lower function call sites so that all function calls are of
+        // the form : variable = call(<args>)
+        // e.g.
+        //      a = 2 + foo(2+x, y, 1)
+        // becomes
+        //      ll0_ = foo(2+x, y, 1)
+        //      a = 2 + ll0_
+        for(auto e=b.begin(); e!=b.end(); ++e) {
+            b.splice(e, lower_function_calls((*e).get()));
+        }
+#ifdef LOGGING
+        std::cout << "body after call site lowering\n";
+        for(auto& l : b) std::cout << "  " << l->to_string() << " @ " << l->location() << "\n";
+        std::cout << green("\n-argument lowering-\n\n");
+#endif
+
+        // lower function arguments that are not identifiers or literals
+        // e.g.
+        //      ll0_ = foo(2+x, y, 1)
+        //      a = 2 + ll0_
+        // becomes
+        //      ll1_ = 2+x
+        //      ll0_ = foo(ll1_, y, 1)
+        //      a = 2 + ll0_
+        for(auto e=b.begin(); e!=b.end(); ++e) {
+            if(auto be = (*e)->is_binary()) {
+                // only apply to assignment expressions where rhs is a
+                // function call because the function call lowering step
+                // above ensures that all function calls are of this form
+                if(auto rhs = be->rhs()->is_function_call()) {
+                    b.splice(e, lower_function_arguments(rhs->args()));
+                }
+            }
+        }
+
+#ifdef LOGGING
+        std::cout << "body after argument lowering\n";
+        for(auto& l : b) std::cout << "  " << l->to_string() << " @ " << l->location() << "\n";
+        std::cout << green("\n-inlining-\n\n");
+#endif
+
+        // Do the inlining, which currently only works for functions
+        // that have a single statement in their body
+        // e.g. if the function foo in the examples above is defined as follows
+        //
+        //  function foo(a, b, c) {
+        //      foo = a*(b + c)
+        //  }
+        //
+        // the full inlined example is
+        //      ll1_ = 2+x
+        //      ll0_ = ll1_*(y + 1)
+        //      a = 2 + ll0_
+        for(auto e=b.begin(); e!=b.end(); ++e) {
+            if(auto ass = (*e)->is_assignment()) {
+                if(ass->rhs()->is_function_call()) {
+                    ass->replace_rhs(inline_function_call(ass->rhs()));
+                }
+            }
+        }
+
+#ifdef LOGGING
+        std::cout << "body after inlining\n";
+        for(auto& l : b) std::cout << "  " << l->to_string() << " @ " << l->location() << "\n";
+#endif
+
+        for(auto& e : b) {
+            for(auto ife = e->is_if(); ife; ) {
+                inline_calls(ife->true_branch()->is_block()->statements());
+                auto f = ife->false_branch();
+                ife = f ? f->is_if() : nullptr;
+                if(f && !ife) {
+                    inline_calls(f->is_block()->statements());
+                }
+            }
+        }
+    };
+
     int errors = 0;
     for(auto& e : symbols_) {
         auto& s = e.second;
@@ -167,72 +275,14 @@ bool Module::semantic() {
                 auto &b = s->kind()==symbolKind::function ?
                     s->is_function()->body()->statements() :
                     s->is_procedure()->body()->statements();
+                inline_calls(b);
 
-                // lower function call sites so that all function calls are of
-                // the form : variable = call(<args>)
-                // e.g.
-                //      a = 2 + foo(2+x, y, 1)
-                // becomes
-                //      ll0_ = foo(2+x, y, 1)
-                //      a = 2 + ll0_
-                for(auto e=b.begin(); e!=b.end(); ++e) {
-                    b.splice(e, lower_function_calls((*e).get()));
-                }
-#ifdef LOGGING
-                std::cout << "body after call site lowering\n";
-                for(auto& l : b) std::cout << "  " << l->to_string() << " @ " << l->location() << "\n";
-                std::cout << green("\n-argument lowering-\n\n");
-#endif
-
-                // lower function arguments that are not identifiers or literals
-                // e.g.
-                //      ll0_ = foo(2+x, y, 1)
-                //      a = 2 + ll0_
-                // becomes
-                //      ll1_ = 2+x
-                //      ll0_ = foo(ll1_, y, 1)
-                //      a = 2 + ll0_
-                for(auto e=b.begin(); e!=b.end(); ++e) {
-                    if(auto be = (*e)->is_binary()) {
-                        // only apply to assignment expressions where rhs is a
-                        // function call because the function call lowering step
-                        // above ensures that all function calls are of this form
-                        if(auto rhs = be->rhs()->is_function_call()) {
-                            b.splice(e, lower_function_arguments(rhs->args()));
-                        }
-                    }
-                }
-
-#ifdef LOGGING
-                std::cout << "body after argument lowering\n";
-                for(auto& l : b) std::cout << "  " << l->to_string() << " @ " << l->location() << "\n";
-                std::cout << green("\n-inlining-\n\n");
-#endif
-
-                // Do the inlining, which currently only works for functions
-                // that have a single statement in their body
-                // e.g. if the function foo in the examples above is defined as follows
-                //
-                //  function foo(a, b, c) {
-                //      foo = a*(b + c)
-                //  }
-                //
-                // the full inlined example is
-                //      ll1_ = 2+x
-                //      ll0_ = ll1_*(y + 1)
-                //      a = 2 + ll0_
-                for(auto e=b.begin(); e!=b.end(); ++e) {
-                    if(auto ass = (*e)->is_assignment()) {
-                        if(ass->rhs()->is_function_call()) {
-                            ass->replace_rhs(inline_function_call(ass->rhs()));
-                        }
-                    }
+                // the procedures that build tables can only depend on their
+                // argument and scalars
+                auto proc = s->is_procedure();
+                if(proc && proc->kind()==procedureKind::table) {
+                    if(!check_table(proc, *this)) ++errors;
                 }
-
-#ifdef LOGGING
-                std::cout << "body after inlining\n";
-                for(auto& l : b) std::cout << "  " << l->to_string() << " @ " << l->location() << "\n";
-#endif
             }
         }
     }
@@ -375,6 +425,26 @@ bool Module::semantic() {
                      " state variables, in the BREAKPOINT block",
                      breakpoint->location());
         }
+        // a KINETIC block is lowered to a linear system that is solved for
+        // every instance
+        else if(solve_expression->procedure()->kind()==procedureKind::kinetic) {
+            if(solve_expression->method()!=solverMethod::sparse) {
+                error("KINETIC blocks must be solved with METHOD sparse",
+                      solve_expression->location());
+                return false;
+            }
+            api_state->body()->statements() =
+                kinetic_update(solve_expression->procedure());
+        }
+        // a DERIVATIVE block that is solved implicitly, which can have
+        // nonlinear ODEs, is integrated with Newton's method
+        else if(   solve_expression->method()==solverMethod::derivimplicit
+                || solve_expression->method()==solverMethod::sparse)
+        {
+            api_state->body()->statements() =
+                newton_update(solve_expression->procedure(), *this);
+            if(has_error()) return false;
+        }
         else {
             // get the DERIVATIVE block
             auto dblock = solve_expression->procedure();
@@ -386,6 +456,58 @@ bool Module::semantic() {
             auto has_provided_integration_method =
                 solve_expression->method() == solverMethod::cnexp;
 
+            // The decay factor exp(a*dt) of an ODE is the same in every time
+            // step if a depends only on parameters, which can't be assigned.
+            // It is then stored in a field, or a scalar if a does not depend
+            // on RANGE parameters, which the procedure dt_cache_ computes
+            // again only when dt changes, so that the exp is a load.
+            // Returns the name of the field, or an empty string if the
+            // factor has to be computed in every time step.
+            auto is_parameter = [dblock] (std::string const& name) {
+                auto s = dblock->scope()->find(name);
+                auto var = s ? s->is_variable() : nullptr;
+                return var && !var->is_state() && var->access()==accessKind::read && name!="t";
+            };
+            std::list<expression_ptr> dt_cache_body;
+            auto cache_decay = [&] (std::string const& state, expression_ptr&& exponent) {
+                auto name = state + "_decay_";
+                if(!use_dt_cache_ || has_symbol(name) || has_symbol("dt_cache_")) {
+                    return std::string();
+                }
+                if(random_draws(exponent.get()).size()) return std::string();
+                auto range = false;
+                for(auto const& dep : identifiers(exponent.get())) {
+                    if(!is_parameter(dep)) return std::string();
+                    range = range || symbols_[dep]->is_variable()->is_range();
+                }
+
+                auto field = new VariableExpression(Location(), name);
+                field->state(false);
+                field->linkage(linkageKind::local);
+                field->visibility(visibilityKind::local);
+                field->ion_channel(ionKind::none);
+                field->range(range ? rangeKind::range : rangeKind::scalar);
+                field->access(accessKind::readwrite);
+                symbols_[name] = symbol_ptr{field};
+
+                dt_cache_body.push_back(
+                    binary_expression(dblock->location(), tok::eq, id(name),
+                        unary_expression(Location(), tok::exp, std::move(exponent))));
+                return name;
+            };
+
+            // If every ODE is linear with coefficients that depend only on
+            // parameters, the exact solution after k time steps is
+            //      s = -b/a + (s+b/a)*exp(a*dt)^k
+            // and the procedure advance(k) jumps the states of an instance k
+            // steps at once, using the cached decay factors. This is used to
+            // update instances that receive no events lazily, e.g. synapses.
+            std::list<expression_ptr> advance_body;
+            auto can_advance = !has_symbol("advance");
+            auto advance = [&advance_body] (std::string const& e_string) {
+                advance_body.push_back(Parser(e_string).parse_line_expression());
+            };
+
             // loop over the statements in the SOLVE block from the mod file
             // put each statement into the new APIMethod, performing
             // transformations if necessary.
@@ -408,15 +530,38 @@ bool Module::semantic() {
                         auto sym  = deriv->symbol();
                         auto name = deriv->name();
 
+                        // give the generated update the location of the ODE,
+                        // which is used by #line directives
+                        auto at_ode = [ass] (expression_ptr&& e) {
+                            auto update = e->is_assignment();
+                            return binary_expression(
+                                ass->location(), tok::eq,
+                                update->lhs()->clone(), update->rhs()->clone());
+                        };
+
                         auto gating_vars = is_gating(rhs, name);
                         if(gating_vars.first && gating_vars.second) {
                             auto const& inf = gating_vars.second->spelling();
                             auto const& rate = gating_vars.first->spelling();
+                            auto decay = cache_decay(name,
+                                binary_expression(tok::divide,
+                                    unary_expression(Location(), tok::minus, id("dt")),
+                                    id(rate)));
+                            if(decay.empty()) {
+                                decay = "exp(-dt/" + rate + ")";
+                                can_advance = false;
+                            }
+                            else if(!is_parameter(inf)) {
+                                can_advance = false;
+                            }
+                            else {
+                                advance(name + "=" + inf + "+(" + name + "-" + inf + ")*"
+                                        + decay + "^k");
+                            }
                             auto e_string = name + "=" + inf
-                                            + "+(" + name + "-" + inf + ")*exp(-dt/"
-                                            + rate + ")";
+                                            + "+(" + name + "-" + inf + ")*" + decay;
                             auto stmt_update = Parser(e_string).parse_line_expression();
-                            body.emplace_back(std::move(stmt_update));
+                            body.emplace_back(at_ode(std::move(stmt_update)));
                             continue;
                         }
                         else {
@@ -426,7 +571,8 @@ bool Module::semantic() {
 
                             // quit if ODE is not linear
                             if( v->classify() != expressionClassification::linear ) {
-                                error("unable to integrate nonlinear state ODEs",
+                                error("unable to integrate nonlinear state ODEs"
+                                      " with METHOD cnexp, use METHOD derivimplicit",
                                       rhs->location());
                                 return false;
                             }
@@ -442,7 +588,7 @@ bool Module::semantic() {
 
                             // statement : a_ = a
                             auto stmt_a  =
-                                binary_expression(Location(),
+                                binary_expression(ass->location(),
                                                   tok::eq,
                                                   id("a_"),
                                                   v->linear_coefficient()->clone());
@@ -454,11 +600,41 @@ bool Module::semantic() {
                                                   v->constant_term()->clone(),
                                                   id("a_"));
                             // statement  : ba_ = b/a
-                            auto stmt_ba = binary_expression(Location(), tok::eq, id("ba_"), std::move(expr_ba));
+                            auto stmt_ba = binary_expression(ass->location(), tok::eq, id("ba_"), std::move(expr_ba));
 
                             // the update function
+                            auto decay = cache_decay(name,
+                                binary_expression(tok::times,
+                                    v->linear_coefficient()->clone(), id("dt")));
+                            if(decay.empty()) {
+                                decay = "exp(a_*dt)";
+                                can_advance = false;
+                            }
+                            // with b=0 and a cached decay factor, e.g. for
+                            // synapses, s decays without a_ and ba_
+                            //      s = s*decay
+                            else if(is_zero(v->constant_term())) {
+                                auto e_string = name + " = " + name + "*" + decay;
+                                auto stmt_update = Parser(e_string).parse_line_expression();
+                                body.emplace_back(at_ode(std::move(stmt_update)));
+                                advance(name + " = " + name + "*" + decay + "^k");
+                                continue;
+                            }
+                            else {
+                                for(auto const& dep : identifiers(v->constant_term())) {
+                                    if(!is_parameter(dep)) can_advance = false;
+                                }
+                                if(random_draws(v->constant_term()).size()) can_advance = false;
+                                if(can_advance) {
+                                    advance_body.push_back(Parser("LOCAL a_").parse_local());
+                                    advance_body.push_back(Parser("LOCAL ba_").parse_local());
+                                    advance_body.push_back(stmt_a->clone());
+                                    advance_body.push_back(stmt_ba->clone());
+                                    advance(name + "  = -ba_ + (" + name + " + ba_)*" + decay + "^k");
+                                }
+                            }
                             auto e_string = name + "  = -ba_ + "
-                                            "(" + name + " + ba_)*exp(a_*dt)";
+                                            "(" + name + " + ba_)*" + decay;
                             auto stmt_update = Parser(e_string).parse_line_expression();
 
                             // add declaration of local variables
@@ -467,16 +643,39 @@ bool Module::semantic() {
                             // add integration statements
                             body.emplace_back(std::move(stmt_a));
                             body.emplace_back(std::move(stmt_ba));
-                            body.emplace_back(std::move(stmt_update));
+                            body.emplace_back(at_ode(std::move(stmt_update)));
                             continue;
                         }
                     }
                     else {
                         body.push_back(e->clone());
+                        can_advance = false;
                         continue;
                     }
                 }
                 body.push_back(e->clone());
+                can_advance = false;
+            }
+
+            if(dt_cache_body.size()) {
+                auto loc = dblock->location();
+                symbols_["dt_cache_"] = make_symbol<ProcedureExpression>(
+                    loc, "dt_cache_", std::vector<expression_ptr>(),
+                    make_expression<BlockExpression>(loc, std::move(dt_cache_body), false),
+                    procedureKind::dt_cache);
+                symbols_["dt_cache_"]->semantic(symbols_);
+            }
+
+            if(can_advance && advance_body.size()) {
+                auto loc = dblock->location();
+                std::vector<expression_ptr> args;
+                args.push_back(make_expression<ArgumentExpression>(
+                    loc, Token(tok::identifier, "k", loc)));
+                symbols_["advance"] = make_symbol<ProcedureExpression>(
+                    loc, "advance", std::move(args),
+                    make_expression<BlockExpression>(loc, std::move(advance_body), false),
+                    procedureKind::advance);
+                symbols_["advance"]->semantic(symbols_);
             }
         }
 
@@ -505,19 +704,140 @@ bool Module::semantic() {
             return ionKind::none;
         };
 
+        // the conductance is the derivative of the currents with respect to
+        // v, found by symbolic differentiation of the current updates, so
+        // that it is computed in the same pass as the currents. The chain is
+        // followed through the assignments in the BREAKPOINT block.
+        // Variables that are set in if statements or PROCEDURE calls from
+        // values that depend on v have no derivative, and a current that
+        // uses them is an error.
+        auto dv_name = [] (std::string const& name) {
+            return "d" + name + "dv_";
+        };
+        std::map<std::string, std::string> dv;
+        std::set<std::string> no_dv;
+        std::vector<expression_ptr> derivatives;
+
+        // the variables that are assigned in a statement, and the values
+        // that they are computed from, including the bodies of the
+        // procedures that it calls. The conditions of if statements are
+        // not values: the derivative of a branch does not depend on them.
+        std::function<void(Expression*, std::set<std::string>&, std::set<std::string>&)>
+        dependencies = [&dependencies]
+            (Expression* e, std::set<std::string>& lhs, std::set<std::string>& rhs)
+        {
+            if(auto a = e->is_assignment()) {
+                if(auto id = a->lhs()->is_identifier()) {
+                    lhs.insert(id->spelling());
+                }
+                dependencies(a->rhs(), lhs, rhs);
+            }
+            else if(auto b = e->is_block()) {
+                for(auto& s : *b) dependencies(s.get(), lhs, rhs);
+            }
+            else if(auto i = e->is_if()) {
+                dependencies(i->true_branch(), lhs, rhs);
+                if(i->false_branch()) dependencies(i->false_branch(), lhs, rhs);
+            }
+            else if(auto c = e->is_procedure_call()) {
+                for(auto& a : c->args()) dependencies(a.get(), lhs, rhs);
+                dependencies(c->procedure()->body(), lhs, rhs);
+            }
+            else {
+                auto names = identifiers(e);
+                rhs.insert(names.begin(), names.end());
+            }
+        };
+
+        for(auto& e: *(breakpoint->body())) {
+            auto a = e->is_assignment();
+            if(!a || !a->lhs()->is_identifier()) {
+                std::set<std::string> lhs, rhs;
+                dependencies(e.get(), lhs, rhs);
+                bool depends_on_v = false;
+                for(auto& name : rhs) {
+                    if(name=="v" || dv.count(name) || no_dv.count(name)) {
+                        depends_on_v = true;
+                    }
+                }
+                for(auto& name : lhs) {
+                    dv.erase(name);
+                    no_dv.erase(name);
+                    if(depends_on_v) {
+                        no_dv.insert(name);
+                    }
+                }
+                derivatives.emplace_back(nullptr);
+                continue;
+            }
+            auto lhs = a->lhs()->is_identifier()->spelling();
+            auto d = symbolic_derivative(a->rhs(), "v", dv);
+            for(auto& name : identifiers(a->rhs())) {
+                if(no_dv.count(name)) d = nullptr;
+            }
+            if(is_ion_update(e.get())==ionKind::none) {
+                dv.erase(lhs);
+                no_dv.erase(lhs);
+                if(!d) {
+                    no_dv.insert(lhs);
+                }
+                else if(is_zero(d.get())) {
+                    d = nullptr;
+                }
+                else {
+                    dv[lhs] = dv_name(lhs);
+                }
+            }
+            derivatives.push_back(std::move(d));
+        }
+
+        // only the derivatives that contribute to the conductance are kept
+        std::set<std::string> needed;
+        auto statement = breakpoint->body()->statements().rbegin();
+        for(auto d=derivatives.rbegin(); d!=derivatives.rend(); ++d, ++statement) {
+            if(!*d) continue;
+            auto update = is_ion_update(statement->get())!=ionKind::none;
+            auto lhs = (*statement)->is_assignment()->lhs()->is_identifier()->spelling();
+            if(update || needed.count(dv_name(lhs))) {
+                auto names = identifiers(d->get());
+                needed.insert(names.begin(), names.end());
+            }
+            else {
+                d->reset();
+            }
+        }
+
         // add statements that initialize the reduction variables
         bool has_current_update = false;
+        bool has_conductance_update = false;
+        std::set<std::string> dv_locals;
+        auto derivative = derivatives.begin();
         for(auto& e: *(breakpoint->body())) {
+            auto& d = *derivative++;
+
             // ignore solve and conductance statements
             if(e->is_solve_statement())       continue;
             if(e->is_conductance_statement()) continue;
 
+            // the derivative of a variable is evaluated before the variable
+            // is assigned, because it can refer to the old value
+            auto channel = is_ion_update(e.get());
+            if(d && channel==ionKind::none) {
+                auto loc = e->location();
+                auto name = dv_name(e->is_assignment()->lhs()->is_identifier()->spelling());
+                if(!dv_locals.count(name)) {
+                    block.emplace_back(make_expression<LocalDeclaration>(loc, name));
+                    dv_locals.insert(name);
+                }
+                block.emplace_back(binary_expression(loc, tok::eq,
+                    make_expression<IdentifierExpression>(loc, name), d->clone()));
+            }
+
             // add the expression
             block.emplace_back(e->clone());
 
             // we are updating an ionic current
             // so keep track of current and conductance accumulation
-            auto channel = is_ion_update(e.get());
             if(channel != ionKind::none) {
                 auto lhs = e->is_assignment()->lhs()->is_identifier();
                 auto rhs = e->is_assignment()->rhs();
@@ -543,11 +863,39 @@ bool Module::semantic() {
                     return false;
                 }
                 has_current_update = true;
+
+                // add conductance update
+                if(!d) {
+                    std::string reason;
+                    for(auto& name : identifiers(rhs)) {
+                        if(no_dv.count(name)) {
+                            reason = " ('" + name + "' depends on v through an"
+                                     " if statement, a PROCEDURE call or a"
+                                     " function that can not be differentiated)";
+                        }
+                    }
+                    error("unable to differentiate the current update with"
+                          " respect to v to find the conductance : "
+                          + rhs->to_string() + reason, e->location());
+                    return false;
+                }
+                if(!is_zero(d.get())) {
+                    auto loc = e->location();
+                    auto g = make_expression<IdentifierExpression>(loc, "conductance_");
+                    if(has_conductance_update) {
+                        d = binary_expression(loc, tok::plus, g->clone(), std::move(d));
+                    }
+                    block.emplace_back(binary_expression(loc, tok::eq, std::move(g), std::move(d)));
+                    has_conductance_update = true;
+                }
             }
         }
         if(has_current_update && kind()==moduleKind::point) {
             block.emplace_back(Parser("current_ = 100. * current_ / area_").parse_line_expression());
         }
+        if(has_conductance_update && kind()==moduleKind::point) {
+            block.emplace_back(Parser("conductance_ = 100. * conductance_ / area_").parse_line_expression());
+        }
 
         auto v = make_unique<ConstantFolderVisitor>();
         for(auto& e : block) {
@@ -568,6 +916,21 @@ bool Module::semantic() {
         return false;
     }
 
+    // every site that draws random numbers gets its own stream, numbered in
+    // the order of the names of the procedures, so that the numbers don't
+    // depend on the order of the symbol table
+    std::vector<std::string> procedure_names;
+    for(auto& e : symbols_) {
+        if(e.second->is_procedure()) procedure_names.push_back(e.first);
+    }
+    std::sort(procedure_names.begin(), procedure_names.end());
+    random_sites_ = 0;
+    for(auto const& name : procedure_names) {
+        for(auto r : random_draws(symbols_[name]->is_procedure()->body())) {
+            r->site(random_sites_++);
+        }
+    }
+
     return status() == lexerStatus::happy;
 }
 
@@ -605,6 +968,8 @@ void Module::add_variables_to_symbols() {
 
     create_indexed_variable("current_", "vec_i", tok::plus,
                             accessKind::write, ionKind::none, Location());
+    create_indexed_variable("conductance_", "vec_g", tok::plus,
+                            accessKind::write, ionKind::none, Location());
     create_indexed_variable("v", "vec_v", tok::eq,
                             accessKind::read,  ionKind::none, Location());
     create_indexed_variable("area_", "vec_area", tok::eq,
@@ -623,6 +988,12 @@ void Module::add_variables_to_symbols() {
         id->range(rangeKind::range);       // always a range
         id->access(accessKind::readwrite);
 
+        // set tolerance if one was specified
+        auto tol = state_block().tolerances.find(var);
+        if(tol != state_block().tolerances.end()) {
+            id->tolerance(std::stod(tol->second));
+        }
+
         symbols_[var] = symbol_ptr{id};
     }
 
@@ -654,6 +1025,11 @@ void Module::add_variables_to_symbols() {
             id->value(std::stod(var.value));
         }
 
+        // set tolerance if one was specified
+        if(var.tolerance.size()) {
+            id->tolerance(std::stod(var.tolerance));
+        }
+
         symbols_[name] = symbol_ptr{id};
     }
 
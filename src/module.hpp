@@ -83,12 +83,39 @@ public :
         kind_ = k;
     }
 
+    // whether TABLE statements are lowered to lookup tables, or ignored so
+    // that the tabulated functions are evaluated directly
+    bool use_tables() const {
+        return use_tables_;
+    }
+    void use_tables(bool t) {
+        use_tables_ = t;
+    }
+
+    // whether the decay factors of ODEs integrated with cnexp that depend
+    // only on dt and parameters are stored, and computed again when dt changes
+    bool use_dt_cache() const {
+        return use_dt_cache_;
+    }
+    void use_dt_cache(bool c) {
+        use_dt_cache_ = c;
+    }
+
+    // the number of sites that draw random numbers, which are numbered from
+    // zero by semantic analysis
+    int random_sites() const {
+        return random_sites_;
+    }
+
     // perform semantic analysis
     void add_variables_to_symbols();
     bool semantic();
     bool optimize();
 private :
     moduleKind kind_;
+    bool use_tables_ = true;
+    bool use_dt_cache_ = true;
+    int random_sites_ = 0;
     std::string title_;
     std::string fname_;
     std::vector<char> buffer_; // character buffer loaded from file
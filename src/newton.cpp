@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "linearsolve.hpp"
+#include "module.hpp"
+#include "newton.hpp"
+#include "symdiff.hpp"
+#include "util.hpp"
+
+// a statement in the DERIVATIVE block that depends on the states, which is
+// evaluated with the states of every iteration
+struct dependent_assignment {
+    std::string lhs;
+    Expression* rhs;
+    // the derivatives of the rhs with respect to each state: nullptr if
+    // the derivative is zero
+    std::vector<expression_ptr> derivatives;
+    // the names of the locals that hold the derivatives of lhs
+    std::vector<std::string> names;
+};
+
+static bool intersects(std::set<std::string> const& a, std::set<std::string> const& b) {
+    for(auto& name : a) {
+        if(b.count(name)) return true;
+    }
+    return false;
+}
+
+std::list<expression_ptr> newton_update(
+    ProcedureExpression* derivative, Module& module, int iterations)
+{
+    std::list<expression_ptr> body;
+
+    // the generated statements have the location of the DERIVATIVE block,
+    // which is used by #line directives
+    auto loc = derivative->location();
+    auto id = [loc] (std::string const& name) {
+        return make_expression<IdentifierExpression>(loc, name);
+    };
+    auto assign = [&body, loc, &id] (std::string const& lhs, expression_ptr&& rhs) {
+        body.push_back(binary_expression(loc, tok::eq, id(lhs), std::move(rhs)));
+    };
+    auto local = [&body, loc] (std::string const& name) {
+        body.push_back(make_expression<LocalDeclaration>(loc, name));
+    };
+    auto dt_times = [&id] (expression_ptr&& e) {
+        return binary_expression(tok::times, id("dt"), std::move(e));
+    };
+
+    // the states, and the right hand sides of their ODEs
+    std::vector<std::string> states;
+    std::vector<Expression*> odes;
+    for(auto& e : *derivative->body()) {
+        if(auto ass = e->is_assignment()) {
+            if(auto deriv = ass->lhs()->is_derivative()) {
+                states.push_back(deriv->name());
+                odes.push_back(ass->rhs());
+            }
+        }
+    }
+    int n = states.size();
+
+    // the variables that depend on the states, and the variables that are
+    // read by the statements that depend on the states
+    std::set<std::string> depends(states.begin(), states.end());
+    std::set<std::string> read;
+
+    // the statements that do not depend on the states are evaluated once,
+    // in order, before the iterations
+    std::vector<dependent_assignment> dependent;
+    for(auto& e : *derivative->body()) {
+        auto ass = e->is_assignment();
+        if(ass && ass->lhs()->is_derivative()) continue;
+
+        if(ass) {
+            auto lhs = ass->lhs()->is_identifier()->spelling();
+            auto names = identifiers(ass->rhs());
+            if(std::find(states.begin(), states.end(), lhs)!=states.end()) {
+                module.error("a state variable can't be assigned in a DERIVATIVE"
+                             " block that is solved implicitly", e->location());
+                return {};
+            }
+            // a variable that depends on the states, or that is read by a
+            // statement that depends on the states, has to be updated in
+            // every iteration
+            if(intersects(names, depends) || depends.count(lhs) || read.count(lhs)) {
+                dependent.push_back({lhs, ass->rhs(), {}, {}});
+                depends.insert(lhs);
+                read.insert(names.begin(), names.end());
+                continue;
+            }
+        }
+        else if(!e->is_local_declaration() && intersects(identifiers(e.get()), depends)) {
+            module.error("only assignments can depend on the state variables in a"
+                         " DERIVATIVE block that is solved implicitly", e->location());
+            return {};
+        }
+        body.push_back(e->clone());
+    }
+
+    // the variables that are read by the ODEs, or by the dependent statements
+    for(auto f : odes) {
+        auto names = identifiers(f);
+        read.insert(names.begin(), names.end());
+    }
+
+    // the derivatives of the dependent variables with respect to each state,
+    // by forward differentiation through the dependent statements, for the
+    // variables that are read
+    std::vector<std::map<std::string, std::string>> chain(n);
+    std::set<std::string> derivative_locals;
+    auto differentiate = [&module, &states] (Expression* e, int j, std::map<std::string, std::string> const& chain) {
+        auto d = symbolic_derivative(e, states[j], chain);
+        if(!d) {
+            module.error("unable to differentiate the expression "
+                         + e->to_string() + " for the implicit solve", e->location());
+        }
+        return d;
+    };
+    for(auto& s : dependent) {
+        for(auto j=0; j<n; ++j) {
+            auto d = differentiate(s.rhs, j, chain[j]);
+            if(!d) return {};
+            if(is_zero(d.get()) || !read.count(s.lhs)) {
+                chain[j].erase(s.lhs);
+                s.derivatives.emplace_back(nullptr);
+                s.names.emplace_back();
+            }
+            else {
+                auto name = pprintf("d%_%", j, s.lhs);
+                chain[j][s.lhs] = name;
+                derivative_locals.insert(name);
+                s.derivatives.emplace_back(std::move(d));
+                s.names.push_back(name);
+            }
+        }
+    }
+
+    // the Jacobian of f, and its structure
+    std::vector<std::vector<expression_ptr>> jacobian(n);
+    matrix_structure nonzero(n, std::vector<bool>(n, false));
+    for(auto i=0; i<n; ++i) {
+        for(auto j=0; j<n; ++j) {
+            auto d = differentiate(odes[i], j, chain[j]);
+            if(!d) return {};
+            nonzero[i][j] = i==j || !is_zero(d.get());
+            jacobian[i].emplace_back(std::move(d));
+        }
+    }
+
+    // the ODEs are linear if the Jacobian does not depend on the states, in
+    // which case the first Newton iteration gives the solution
+    auto linear = true;
+    for(auto& s : dependent) {
+        for(auto& d : s.derivatives) {
+            if(d && intersects(identifiers(d.get()), depends)) linear = false;
+        }
+    }
+    for(auto& row : jacobian) {
+        for(auto& d : row) {
+            if(intersects(identifiers(d.get()), depends)) linear = false;
+        }
+    }
+    if(linear) iterations = 1;
+
+    // declare the locals of the solve, and save the states at the start of
+    // the time step
+    auto x = linear_solve_x;
+    auto a = linear_solve_a;
+    auto y = [] (int i) {
+        return pprintf("y%_", i);
+    };
+    auto fill = linear_solve_fill(nonzero);
+    for(auto i=0; i<n; ++i) {
+        local(x(i));
+        local(y(i));
+        for(auto j=0; j<n; ++j) {
+            if(fill[i][j]) local(a(i, j));
+        }
+    }
+    local("f_");
+    for(auto& name : derivative_locals) {
+        local(name);
+    }
+    for(auto i=0; i<n; ++i) {
+        assign(y(i), id(states[i]));
+    }
+
+    for(auto k=0; k<iterations; ++k) {
+        // the dependent variables and their derivatives, where the
+        // derivatives are evaluated before the variable is updated, because
+        // they can refer to its previous value
+        for(auto& s : dependent) {
+            for(auto j=0; j<n; ++j) {
+                if(s.derivatives[j]) {
+                    assign(s.names[j], s.derivatives[j]->clone());
+                }
+            }
+            assign(s.lhs, s.rhs->clone());
+        }
+
+        // the residual
+        //      F = s - s_old - dt*f(s)
+        for(auto i=0; i<n; ++i) {
+            assign(x(i),
+                binary_expression(tok::minus,
+                    binary_expression(tok::minus, id(states[i]), id(y(i))),
+                    dt_times(odes[i]->clone())));
+        }
+
+        // the Jacobian of F
+        //      J = I - dt*df/ds
+        for(auto i=0; i<n; ++i) {
+            for(auto j=0; j<n; ++j) {
+                if(!nonzero[i][j]) continue;
+                auto const& d = jacobian[i][j];
+                if(is_zero(d.get())) {
+                    assign(a(i, j), make_expression<NumberExpression>(loc, 1.));
+                }
+                else if(i==j) {
+                    assign(a(i, j), binary_expression(tok::minus,
+                        make_expression<NumberExpression>(loc, 1.), dt_times(d->clone())));
+                }
+                else {
+                    assign(a(i, j), unary_expression(Location(), tok::minus, dt_times(d->clone())));
+                }
+            }
+        }
+
+        // the Newton update s = s - J^-1 F
+        body.splice(body.end(), linear_solve(nonzero, loc));
+        for(auto i=0; i<n; ++i) {
+            assign(states[i],
+                binary_expression(tok::minus, id(states[i]), id(x(i))));
+        }
+    }
+
+    // the variables that depend on the states are updated with the solution
+    for(auto& s : dependent) {
+        assign(s.lhs, s.rhs->clone());
+    }
+
+    return body;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <list>
+
+#include "expression.hpp"
+
+class Module;
+
+/// The statements that advance the states of a DERIVATIVE block by one time
+/// step, for ODEs that can be nonlinear
+///     s' = f(s)
+/// The ODEs are integrated with backward Euler, by solving
+///     F(s) = s - s_old - dt*f(s) = 0
+/// with a fixed number of Newton iterations, so that the update is branch
+/// free and vectorized across instances. The Jacobian of F is found by
+/// symbolic differentiation of the right hand sides, including the chain
+/// through local variables that depend on the states, and its linear system
+/// is solved with the unrolled elimination of linear_solve.
+/// Statements that do not depend on the states are evaluated once, before
+/// the iterations, and only one iteration is made if the ODEs are linear.
+/// The statements that depend on the states are evaluated again after the
+/// last iteration, so that the variables they assign match the new states.
+/// Errors, e.g. for right hand sides that can't be differentiated, are
+/// reported to the module, and an empty list is returned.
+std::list<expression_ptr> newton_update(
+    ProcedureExpression* derivative, Module& module, int iterations=3);
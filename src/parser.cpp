@@ -104,12 +104,13 @@ bool Parser::parse() {
             case tok::assigned :
                 parse_assigned_block();
                 break;
-            // INITIAL, DERIVATIVE, PROCEDURE, NET_RECEIVE and BREAKPOINT blocks
-            // are all lowered to ProcedureExpression
+            // INITIAL, DERIVATIVE, KINETIC, PROCEDURE, NET_RECEIVE and
+            // BREAKPOINT blocks are all lowered to ProcedureExpression
             case tok::net_receive:
             case tok::breakpoint :
             case tok::initial    :
             case tok::derivative :
+            case tok::kinetic    :
             case tok::procedure  :
                 {
                 auto p = parse_procedure();
@@ -377,8 +378,21 @@ void Parser::parse_state_block() {
             error(pprintf("'%' is not a valid name for a state variable", token_.spelling));
             return;
         }
-        state_block.state_variables.push_back(token_.spelling);
+        auto name = token_.spelling;
+        int line = location_.line;
+        state_block.state_variables.push_back(name);
         get_token();
+
+        // optional tolerance annotation
+        if(line==location_.line && token_.type == tok::lt) {
+            auto tol = annotation();
+            if(status_ == lexerStatus::error) {
+                return;
+            }
+            if(tol.size()) {
+                state_block.tolerances[name] = tol;
+            }
+        }
     }
 
     // add this state block information to the module
@@ -489,6 +503,15 @@ void Parser::parse_parameter_block() {
             }
         }
 
+        // get the tolerance or limits
+        if(line==location_.line && token_.type == tok::lt) {
+            parm.tolerance = annotation();
+            if(status_ == lexerStatus::error) {
+                success = 0;
+                goto parm_exit;
+            }
+        }
+
         block.parameters.push_back(parm);
     }
 
@@ -576,6 +599,57 @@ ass_exit:
     return;
 }
 
+// parse an annotation in angle brackets that follows a variable declaration
+// either a tolerance
+//      m <1e-4>
+// or lower and upper limits
+//      gbar = 0.1 (S/cm2) <0, 1e9>
+// returns the tolerance, or an empty string for limits, which are ignored
+std::string Parser::annotation() {
+    int startline = location_.line;
+    std::vector<std::string> values;
+
+    // check that we start with a less than
+    if(token_.type != tok::lt) {
+        error(pprintf("annotation must start with '<', found '%'", token_.spelling));
+        return "";
+    }
+
+    get_token();
+
+    while(token_.type != tok::gt) {
+        std::string value;
+        if(token_.type==tok::minus) {
+            value = "-";
+            get_token();
+        }
+        if(token_.type != tok::number || startline < location_.line) {
+            error(pprintf("incorrect annotation, expected a number, found '%'", token_.spelling));
+            return "";
+        }
+        values.push_back(value + token_.spelling);
+        get_token();
+
+        if(token_.type == tok::comma) {
+            get_token();
+        }
+        else if(token_.type != tok::gt) {
+            error(pprintf("incorrect annotation, expected '>', found '%'", token_.spelling));
+            return "";
+        }
+    }
+    // consume the closing '>'
+    get_token();
+
+    if(values.size()==1) {
+        return values.front();
+    }
+    if(values.size()!=2) {
+        error("an annotation is either a tolerance <tol> or limits <low, high>");
+    }
+    return "";
+}
+
 std::vector<Token> Parser::unit_description() {
     static const tok legal_tokens[] = {tok::identifier, tok::divide, tok::number};
     int startline = location_.line;
@@ -708,6 +782,12 @@ symbol_ptr Parser::parse_procedure() {
             if( !expect( tok::identifier ) ) return nullptr;
             p = parse_prototype();
             break;
+        case tok::kinetic:
+            kind = procedureKind::kinetic;
+            get_token(); // consume keyword token
+            if( !expect( tok::identifier ) ) return nullptr;
+            p = parse_prototype();
+            break;
         case tok::procedure:
             kind = procedureKind::normal;
             get_token(); // consume keyword token
@@ -728,9 +808,9 @@ symbol_ptr Parser::parse_procedure() {
             break;
         default:
             // it is a compiler error if trying to parse_procedure() without
-            // having DERIVATIVE, PROCEDURE, INITIAL or BREAKPOINT keyword
+            // having DERIVATIVE, KINETIC, PROCEDURE, INITIAL or BREAKPOINT keyword
             throw compiler_exception(
-                "attempt to parser_procedure() without {DERIVATIVE,PROCEDURE,INITIAL,BREAKPOINT}",
+                "attempt to parser_procedure() without {DERIVATIVE,KINETIC,PROCEDURE,INITIAL,BREAKPOINT}",
                 location_);
     }
     if(p==nullptr) return nullptr;
@@ -741,6 +821,31 @@ symbol_ptr Parser::parse_procedure() {
     // parse the body of the function
     expression_ptr body = parse_block(false);
     if(body==nullptr) return nullptr;
+    if(!check_tables(body.get())) return nullptr;
+
+    // the states of a KINETIC block are updated by its reactions, and those
+    // of a DERIVATIVE block by its derivatives
+    for(auto& e : *body->is_block()) {
+        if(e->is_table_statement() && kind!=procedureKind::normal) {
+            error("TABLE statements are only allowed in a FUNCTION or PROCEDURE",
+                  e->location());
+            return nullptr;
+        }
+        if(kind!=procedureKind::kinetic) {
+            if(e->is_reaction() || e->is_conserve_statement()) {
+                error("reactions and CONSERVE statements are only allowed in a KINETIC block",
+                      e->location());
+                return nullptr;
+            }
+        }
+        else if(auto ass = e->is_assignment()) {
+            if(ass->lhs()->is_derivative()) {
+                error("derivatives are not allowed in a KINETIC block, use a reaction",
+                      e->location());
+                return nullptr;
+            }
+        }
+    }
 
     auto proto = p->is_prototype();
     if(kind != procedureKind::net_receive) {
@@ -769,6 +874,7 @@ symbol_ptr Parser::parse_function() {
     // parse the body of the function
     auto body = parse_block(false);
     if(body==nullptr) return nullptr;
+    if(!check_tables(body.get())) return nullptr;
 
     PrototypeExpression *proto = p->is_prototype();
     return make_symbol<FunctionExpression>
@@ -788,6 +894,12 @@ expression_ptr Parser::parse_statement() {
             return parse_conductance();
         case tok::solve :
             return parse_solve();
+        case tok::tilde :
+            return parse_reaction();
+        case tok::conserve :
+            return parse_conserve();
+        case tok::table :
+            return parse_table();
         case tok::local :
             return parse_local();
         case tok::identifier :
@@ -996,6 +1108,10 @@ expression_ptr Parser::parse_primary() {
             return parse_identifier();
         case tok::lparen:
             return parse_parenthesis_expression();
+        case tok::random_uniform:
+        case tok::random_exponential:
+        case tok::random_normal:
+            return parse_random();
         default: // fall through to return nullptr at end of function
             error( pprintf( "unexpected token '%' in expression",
                             yellow(token_.spelling) ));
@@ -1033,6 +1149,25 @@ expression_ptr Parser::parse_number() {
     return e;
 }
 
+/// parse a random number intrinsic, which has no arguments, e.g.
+///     random_normal()
+expression_ptr Parser::parse_random() {
+    auto e = make_expression<RandomExpression>(token_.location, token_.type);
+    auto name = token_.spelling;
+
+    get_token(); // consume the intrinsic
+    if(!expect(tok::lparen, pprintf("expected '(' after '%'", yellow(name)))) {
+        return nullptr;
+    }
+    get_token(); // consume '('
+    if(!expect(tok::rparen, pprintf("'%' has no arguments", yellow(name)))) {
+        return nullptr;
+    }
+    get_token(); // consume ')'
+
+    return e;
+}
+
 expression_ptr Parser::parse_binop(expression_ptr&& lhs, Token op_left) {
     // only way out of the loop below is by return:
     //      :: return with nullptr on error
@@ -1133,8 +1268,10 @@ expression_ptr Parser::parse_solve() {
     }
     else {
         get_token(); // consume the METHOD keyword
-        if(token_.type != tok::cnexp) goto solve_statement_error;
-        method = solverMethod::cnexp;
+        if     (token_.type == tok::cnexp)  method = solverMethod::cnexp;
+        else if(token_.type == tok::sparse) method = solverMethod::sparse;
+        else if(token_.type == tok::derivimplicit) method = solverMethod::derivimplicit;
+        else goto solve_statement_error;
 
         get_token(); // consume the method description
     }
@@ -1149,8 +1286,12 @@ solve_statement_error:
     error( "SOLVE statements must have the form\n"
            "  SOLVE x METHOD cnexp\n"
            "    or\n"
+           "  SOLVE x METHOD sparse\n"
+           "    or\n"
+           "  SOLVE x METHOD derivimplicit\n"
+           "    or\n"
            "  SOLVE x\n"
-           "where 'x' is the name of a DERIVATIVE block", loc);
+           "where 'x' is the name of a DERIVATIVE block, or of a KINETIC block for sparse", loc);
     return nullptr;
 }
 
@@ -1204,6 +1345,175 @@ conductance_statement_error:
     return nullptr;
 }
 
+/// parse a reaction in a KINETIC block
+///     ~ A <-> B (kf, kb)
+/// where A and B are state variables, or sums of state variables, and kf and
+/// kb are expressions for the forward and backward rates
+expression_ptr Parser::parse_reaction() {
+    int line = location_.line;
+    Location loc = location_; // location of the '~'
+
+    get_token(); // consume '~'
+
+    // the state variables on one side of the reaction, separated by '+'
+    auto parse_species = [this] (std::vector<expression_ptr>& species) {
+        while(1) {
+            if(!expect(tok::identifier, "expected the name of a STATE variable in the reaction")) {
+                return false;
+            }
+            species.emplace_back(parse_identifier());
+
+            if(token_.type != tok::plus) return true;
+            get_token(); // consume '+'
+        }
+    };
+
+    std::vector<expression_ptr> lhs;
+    std::vector<expression_ptr> rhs;
+    expression_ptr fwd;
+    expression_ptr bwd;
+
+    if(!parse_species(lhs)) return nullptr;
+
+    if(!expect(tok::arrow, "expected '" + yellow("<->") + "' between the two sides of a reaction")) {
+        return nullptr;
+    }
+    get_token(); // consume '<->'
+
+    if(!parse_species(rhs)) return nullptr;
+
+    if(!expect(tok::lparen, "expected the rates of the reaction '(kf, kb)'")) return nullptr;
+    get_token(); // consume '('
+
+    fwd = parse_expression();
+    if(!fwd) return nullptr;
+
+    if(!expect(tok::comma, "the forward and backward rates of a reaction must be separated by ','")) {
+        return nullptr;
+    }
+    get_token(); // consume ','
+
+    bwd = parse_expression();
+    if(!bwd) return nullptr;
+
+    if(!expect(tok::rparen, "expected ')' after the rates of the reaction")) return nullptr;
+    get_token(); // consume ')'
+
+    // check that the rest of the line was empty
+    if(line == location_.line && token_.type != tok::eof) {
+        error(pprintf("expected a new line after the reaction, found '%'",
+                      yellow(token_.spelling)));
+        return nullptr;
+    }
+
+    return make_expression<ReactionExpression>(
+            loc, std::move(lhs), std::move(rhs), std::move(fwd), std::move(bwd));
+}
+
+/// parse a CONSERVE statement in a KINETIC block
+///     CONSERVE A + B = total
+expression_ptr Parser::parse_conserve() {
+    Location loc = location_; // location of the CONSERVE keyword
+
+    get_token(); // consume CONSERVE
+
+    // the statement is parsed like an assignment, which has the lowest
+    // precedence, so that the sum of states is the lhs of the assignment
+    auto e = parse_unaryop();
+    if(!e) return nullptr;
+    if(binop_precedence(token_.type)>0) {
+        Token op = token_;  // save the operator
+        get_token();        // consume the operator
+        e = parse_binop(std::move(e), op);
+        if(!e) return nullptr;
+    }
+
+    auto ass = e->is_assignment();
+    if(!ass) {
+        error("CONSERVE statements must have the form\n  CONSERVE A + B = total", loc);
+        return nullptr;
+    }
+
+    return make_expression<ConserveExpression>(loc, ass->lhs()->clone(), ass->rhs()->clone());
+}
+
+/// parse a TABLE statement
+///     TABLE names DEPEND depends FROM from TO to WITH n
+/// where the list of names is empty in a FUNCTION, and the DEPEND clause
+/// is optional
+expression_ptr Parser::parse_table() {
+    Location loc = location_; // location of the TABLE keyword
+
+    // the lists of identifiers are read from the token after the keyword
+    // that precedes them, TABLE or DEPEND, which they consume
+    std::vector<std::string> names;
+    std::vector<std::string> depends;
+    auto identifiers = [this] (std::vector<std::string>& list) {
+        for(auto& t : comma_separated_identifiers()) {
+            list.push_back(t.spelling);
+        }
+        return status() != lexerStatus::error;
+    };
+    if(peek().type == tok::identifier) {
+        if(!identifiers(names)) return nullptr;
+    }
+    else {
+        get_token(); // consume TABLE
+    }
+    if(token_.type == tok::depend) {
+        if(peek().type != tok::identifier) {
+            error("expected a list of variables after DEPEND");
+            return nullptr;
+        }
+        if(!identifiers(depends)) return nullptr;
+    }
+
+    // the bounds of the table, which may be negative
+    auto bound = [this] (tok keyword, double& value) {
+        auto name = token_string(keyword);
+        if(!expect(keyword, "expected " + yellow(name) + " in TABLE statement")) return false;
+        get_token(); // consume keyword
+        auto sign = 1.;
+        if(token_.type == tok::minus) {
+            sign = -1.;
+            get_token(); // consume '-'
+        }
+        if(!expect(tok::number, "expected a number after " + yellow(name))) return false;
+        value = sign*std::stod(token_.spelling);
+        get_token(); // consume number
+        return true;
+    };
+    double from, to, with;
+    if(!bound(tok::from, from)) return nullptr;
+    if(!bound(tok::to, to))     return nullptr;
+    if(!bound(tok::with, with)) return nullptr;
+
+    if(!(from < to)) {
+        error("the FROM value of a TABLE must be less than the TO value", loc);
+        return nullptr;
+    }
+    if(with < 1 || with != int(with)) {
+        error("the WITH value of a TABLE must be a positive integer", loc);
+        return nullptr;
+    }
+
+    return make_expression<TableExpression>(
+        loc, std::move(names), std::move(depends), from, to, int(with));
+}
+
+// a FUNCTION or PROCEDURE can have at most one TABLE statement
+bool Parser::check_tables(Expression* body) {
+    auto count = 0;
+    for(auto& e : *body->is_block()) {
+        if(e->is_table_statement() && ++count>1) {
+            error("only one TABLE statement is allowed in a FUNCTION or PROCEDURE",
+                  e->location());
+            return false;
+        }
+    }
+    return true;
+}
+
 expression_ptr Parser::parse_if() {
     Token if_token = token_;
     get_token(); // consume 'if'
@@ -1262,6 +1572,14 @@ expression_ptr Parser::parse_block(bool is_nested) {
                 error("LOCAL variable declarations are not allowed inside a nested scope");
                 return nullptr;
             }
+            if(e->is_reaction() || e->is_conserve_statement()) {
+                error("reactions and CONSERVE statements are not allowed inside a nested scope");
+                return nullptr;
+            }
+            if(e->is_table_statement()) {
+                error("TABLE statements are not allowed inside a nested scope");
+                return nullptr;
+            }
         }
 
         body.emplace_back(std::move(e));
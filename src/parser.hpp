@@ -18,6 +18,7 @@ public:
     expression_ptr parse_statement();
     expression_ptr parse_identifier();
     expression_ptr parse_number();
+    expression_ptr parse_random();
     expression_ptr parse_call();
     expression_ptr parse_expression();
     expression_ptr parse_primary();
@@ -28,6 +29,9 @@ public:
     expression_ptr parse_local();
     expression_ptr parse_solve();
     expression_ptr parse_conductance();
+    expression_ptr parse_reaction();
+    expression_ptr parse_conserve();
+    expression_ptr parse_table();
     expression_ptr parse_block(bool);
     expression_ptr parse_initial();
     expression_ptr parse_if();
@@ -53,7 +57,9 @@ private:
     void parse_title();
 
     std::vector<Token> comma_separated_identifiers();
+    bool check_tables(Expression* body);
     std::vector<Token> unit_description();
+    std::string annotation();
 
     /// build the identifier list
     void add_variables_to_symbols();
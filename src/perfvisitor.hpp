@@ -18,11 +18,17 @@ struct FlopAccumulator {
     int pow=0;
 
     void reset() {
-        add = neg = mul = div = exp = sin = cos = log = 0;
+        add = neg = mul = div = exp = sin = cos = log = pow = 0;
+    }
+
+    // the total number of operations, where each call to a math function
+    // counts as one operation
+    int total() const {
+        return add + neg + mul + div + exp + sin + cos + log + pow;
     }
 };
 
-static std::ostream& operator << (std::ostream& os, FlopAccumulator const& f) {
+inline std::ostream& operator << (std::ostream& os, FlopAccumulator const& f) {
     char buffer[512];
     snprintf(buffer,
              512,
@@ -62,6 +68,31 @@ public:
         }
     }
 
+    void visit(BlockExpression *e) override {
+        for(auto& expression : *e) {
+            expression->accept(this);
+        }
+    }
+
+    // both branches are counted, which gives an upper bound
+    void visit(IfExpression *e) override {
+        e->condition()->accept(this);
+        e->true_branch()->accept(this);
+        if(e->false_branch()) {
+            e->false_branch()->accept(this);
+        }
+    }
+
+    // the operations in a procedure are counted for every call
+    void visit(CallExpression *e) override {
+        for(auto& arg : e->args()) {
+            arg->accept(this);
+        }
+        if(auto proc = e->procedure()) {
+            proc->body()->accept(this);
+        }
+    }
+
     ////////////////////////////////////////////////////
     // specializations for each type of unary expression
     // leave UnaryExpression to throw, to catch
@@ -97,6 +128,12 @@ public:
         e->expression()->accept(this);
         flops.sin++;
     }
+    // the position in the table, and the interpolation between two entries
+    void visit(TableLookupExpression *e) override {
+        e->expression()->accept(this);
+        flops.add += 3;
+        flops.mul += 2;
+    }
 
     ////////////////////////////////////////////////////
     // specializations for each type of binary expression
@@ -104,6 +141,12 @@ public:
     // any missed specializations
     ////////////////////////////////////////////////////
     void visit(BinaryExpression *e) override {
+        // comparisons in the condition of an if statement are not counted
+        if(e->is_conditional()) {
+            e->lhs()->accept(this);
+            e->rhs()->accept(this);
+            return;
+        }
         // there must be a specialization of the flops counter for every type
         // of binary expression: if we get here there has been an attempt to
         // visit a binary expression for which no visitor is implemented
@@ -156,23 +199,12 @@ public:
     void visit(Expression *e) override {}
 
     // traverse the statements in an API method
+    // indexed locals are counted as accesses to their external variable
+    // when they are encountered in the body
     void visit(APIMethod *e) override {
         for(auto& expression : *(e->body())) {
             expression->accept(this);
         }
-
-        // create local indexed views
-        for(auto &symbol : e->scope()->locals()) {
-            auto var = symbol.second->is_local_variable();
-            if(var->is_indexed()) {
-                if(var->is_read()) {
-                    indexed_reads_.insert(var);
-                }
-                else {
-                    indexed_writes_.insert(var);
-                }
-            }
-        }
     }
 
     // traverse the statements in a procedure
@@ -189,6 +221,32 @@ public:
         }
     }
 
+    void visit(BlockExpression *e) override {
+        for(auto& expression : *e) {
+            expression->accept(this);
+        }
+    }
+
+    void visit(IfExpression *e) override {
+        e->condition()->accept(this);
+        e->true_branch()->accept(this);
+        if(e->false_branch()) {
+            e->false_branch()->accept(this);
+        }
+    }
+
+    // the memory accessed by a procedure is attributed to the caller
+    void visit(CallExpression *e) override {
+        for(auto& arg : e->args()) {
+            arg->accept(this);
+        }
+        if(auto proc = e->procedure()) {
+            if(visited_procedures_.insert(proc).second) {
+                proc->body()->accept(this);
+            }
+        }
+    }
+
     void visit(UnaryExpression *e) override {
         e->expression()->accept(this);
     }
@@ -212,6 +270,11 @@ public:
                 break;
             case symbolKind::indexed_variable :
                 indexed_writes_.insert(symbol);
+                break;
+            case symbolKind::local_variable :
+                if(auto var = output_variable(symbol)) {
+                    indexed_writes_.insert(var);
+                }
             default :
                 break;
         }
@@ -235,11 +298,45 @@ public:
                 break;
             case symbolKind::indexed_variable :
                 indexed_reads_.insert(symbol);
+                break;
+            case symbolKind::local_variable :
+                if(auto var = input_variable(symbol)) {
+                    indexed_reads_.insert(var);
+                }
             default :
                 break;
         }
     }
 
+    /// the set of distinct arrays that are read or written
+    /// an array that is both read and written counts as one stream
+    std::set<Symbol*> streams() const {
+        std::set<Symbol*> s;
+        s.insert(indexed_reads_.begin(), indexed_reads_.end());
+        s.insert(vector_reads_.begin(), vector_reads_.end());
+        s.insert(indexed_writes_.begin(), indexed_writes_.end());
+        s.insert(vector_writes_.begin(), vector_writes_.end());
+        return s;
+    }
+
+    int num_streams() const {
+        return streams().size();
+    }
+
+    std::set<Symbol*> const& indexed_reads()  const { return indexed_reads_;  }
+    std::set<Symbol*> const& vector_reads()   const { return vector_reads_;   }
+    std::set<Symbol*> const& indexed_writes() const { return indexed_writes_; }
+    std::set<Symbol*> const& vector_writes()  const { return vector_writes_;  }
+
+    /// estimate of the memory traffic per instance, where every array that is
+    /// read or written moves one value per instance, and the node index is
+    /// read once if there are indexed accesses
+    int bytes_per_instance(int value_size=8, int index_size=4) const {
+        int indexed = indexed_reads_.size() + indexed_writes_.size();
+        int vector  = vector_reads_.size() + vector_writes_.size();
+        return value_size*(indexed + vector) + (indexed ? index_size : 0);
+    }
+
     std::string print() const {
         std::stringstream s;
 
@@ -258,6 +355,25 @@ public:
     }
 
 private:
+    // the external variable of a local that is loaded from an indexed array
+    static IndexedVariable* input_variable(Symbol* s) {
+        auto l = s->is_local_variable();
+        if(l && l->is_local() && l->is_indexed() && l->is_read()) {
+            return l->external_variable();
+        }
+        return nullptr;
+    }
+
+    // the external variable of a local that is written to an indexed array
+    static IndexedVariable* output_variable(Symbol* s) {
+        auto l = s->is_local_variable();
+        if(l && l->is_local() && l->is_indexed() && l->is_write()) {
+            return l->external_variable();
+        }
+        return nullptr;
+    }
+
+    std::set<ProcedureExpression*> visited_procedures_;
     std::set<Symbol*> indexed_reads_;
     std::set<Symbol*> vector_reads_;
     std::set<Symbol*> indexed_writes_;
@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <string>
+
+#include "replayprinter.hpp"
+
+/******************************************************************************
+                              ReplayPrinter
+******************************************************************************/
+
+ReplayPrinter::ReplayPrinter(Module &m, CPrinterOptions const& opts)
+:   module_(&m),
+    options_(opts)
+{
+    // the include guard of the mechanism is replaced by the definition that
+    // enables capture, which keeps the line numbers of #line directives
+    std::istringstream mechanism(CPrinter(m, opts).text());
+    std::string line;
+    while(std::getline(mechanism, line)) {
+        text_.add_line(line=="#pragma once" ? "#define MODCC_CAPTURE" : line);
+    }
+    text_.add_line();
+
+    print_driver();
+}
+
+void ReplayPrinter::print_driver() {
+    auto const& name = module_->name();
+
+    text_.add_line("/******************************************************************************");
+    text_.add_line("  replay driver for the " + name + " mechanism");
+    text_.add_line("  usage: replay [-r repetitions] [-e tolerance] <file.trace>...");
+    text_.add_line("******************************************************************************/");
+    text_.add_line();
+    text_.add_line("#include <algorithm>");
+    text_.add_line("#include <chrono>");
+    text_.add_line("#include <cmath>");
+    text_.add_line("#include <cstdio>");
+    text_.add_line("#include <cstdlib>");
+    text_.add_line("#include <iostream>");
+    text_.add_line("#include <limits>");
+    text_.add_line("#include <string>");
+    text_.add_line("#include <vector>");
+    text_.add_line();
+    text_.add_line("int main(int argc, char** argv) {");
+    text_.increase_indentation();
+    text_.add_line("using namespace nest::mc::mechanisms;");
+    text_.add_line("using mechanism_type = " + name + "::mechanism_" + name + "<double, int>;");
+    text_.add_line("using value_type = mechanism_type::value_type;");
+    text_.add_line("using size_type  = mechanism_type::size_type;");
+    text_.add_line("using view_type  = mechanism_type::view_type;");
+    text_.add_line("using index_view = mechanism_type::const_index_view;");
+    text_.add_line("using clock_type = std::chrono::high_resolution_clock;");
+    text_.add_line("auto seconds = [] (clock_type::duration d) {return std::chrono::duration<double>(d).count();};");
+    text_.add_line();
+    text_.add_line("int repetitions = 100;");
+    text_.add_line("double tolerance = 0;");
+    text_.add_line("std::vector<std::string> files;");
+    text_.add_line("for(int i=1; i<argc; ++i) {");
+    text_.add_line("    std::string arg = argv[i];");
+    text_.add_line("    if(arg==\"-r\" && i+1<argc)      repetitions = std::max(1, std::atoi(argv[++i]));");
+    text_.add_line("    else if(arg==\"-e\" && i+1<argc) tolerance = std::atof(argv[++i]);");
+    text_.add_line("    else files.push_back(arg);");
+    text_.add_line("}");
+    text_.add_line("if(files.empty()) {");
+    text_.increase_indentation();
+    text_.add_line("std::cerr << \"usage: \" << argv[0] << \" [-r repetitions] [-e tolerance] <file.trace>...\" << std::endl;");
+    text_.add_line("return 1;");
+    text_.decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
+
+    text_.add_line("int status = 0;");
+    text_.add_line("std::printf(\"%-12s %8s %10s %14s %12s  %s\\n\",");
+    text_.add_line("            \"kernel\", \"call\", \"instances\", \"ns/instance\", \"max error\", \"trace\");");
+    text_.add_line("for(auto const& file: files) {");
+    text_.increase_indentation();
+    text_.add_line("modcc::capture::trace trace;");
+    text_.add_line("if(!modcc::capture::read(trace, file)) {");
+    text_.add_line("    std::cerr << \"unable to read trace \" << file << std::endl;");
+    text_.add_line("    status = 1;");
+    text_.add_line("    continue;");
+    text_.add_line("}");
+    text_.add_line("if(trace.mechanism!=\"" + name + "\") {");
+    text_.add_line("    std::cerr << file << \" is a trace of \" << trace.mechanism << \", not " + name + "\" << std::endl;");
+    text_.add_line("    status = 1;");
+    text_.add_line("    continue;");
+    text_.add_line("}");
+    text_.add_line();
+
+    text_.add_line("// the instances are placed on the distinct nodes of the trace, so that");
+    text_.add_line("// they share nodes in the same way as in the captured simulation");
+    text_.add_line("int n = trace.node_index.size();");
+    text_.add_line("std::vector<std::int64_t> nodes(trace.node_index);");
+    text_.add_line("std::sort(nodes.begin(), nodes.end());");
+    text_.add_line("nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());");
+    text_.add_line("int num_nodes = nodes.size();");
+    text_.add_line("std::vector<size_type> node_index(n);");
+    text_.add_line("for(int i=0; i<n; ++i) {");
+    text_.add_line("    auto node = std::lower_bound(nodes.begin(), nodes.end(), trace.node_index[i]);");
+    text_.add_line("    node_index[i] = node - nodes.begin();");
+    text_.add_line("}");
+    text_.add_line();
+    text_.add_line("std::vector<value_type> vec_v(num_nodes), vec_i(num_nodes), vec_g(num_nodes), vec_area(num_nodes);");
+    text_.add_line("mechanism_type mech(");
+    text_.add_line("    view_type(vec_v.data(), num_nodes),");
+    text_.add_line("    view_type(vec_i.data(), num_nodes),");
+    text_.add_line("    index_view(node_index.data(), n));");
+    text_.add_line("mech.set_areas(view_type(vec_area.data(), num_nodes));");
+    text_.add_line("mech.set_conductances(view_type(vec_g.data(), num_nodes));");
+    text_.add_line();
+
+    auto const& ions = module_->neuron_block().ions;
+    if(ions.size()) {
+        text_.add_line("// the ions are defined on every node, and take their values from the trace");
+        text_.add_line("std::vector<size_type> ion_index(num_nodes);");
+        text_.add_line("for(int i=0; i<num_nodes; ++i) ion_index[i] = i;");
+        for(auto const& ion: ions) {
+            std::string p = ion.name;
+            text_.add_gutter() << "std::vector<value_type> "
+                << p << "_current(num_nodes), " << p << "_erev(num_nodes), "
+                << p << "_xi(num_nodes), " << p << "_xo(num_nodes);";
+            text_.end_line();
+            text_.add_line("mechanism_type::ion_type ion_" + p + "(");
+            text_.add_line("    index_view(ion_index.data(), num_nodes),");
+            text_.add_line("    view_type(" + p + "_current.data(), num_nodes),");
+            text_.add_line("    view_type(" + p + "_erev.data(), num_nodes),");
+            text_.add_line("    view_type(" + p + "_xi.data(), num_nodes),");
+            text_.add_line("    view_type(" + p + "_xo.data(), num_nodes));");
+            text_.add_line("mech.set_ion(ionKind::" + p + ", ion_" + p + ");");
+        }
+        text_.add_line();
+    }
+
+    text_.add_line("modcc::capture::scatter restore(trace);");
+    text_.add_line("mech.capture_arrays(restore);");
+    text_.add_line("if(restore.missing.size()) {");
+    text_.increase_indentation();
+    text_.add_line("std::cerr << file << \" does not match the mechanism, missing:\";");
+    text_.add_line("for(auto const& a: restore.missing) std::cerr << \" \" << a;");
+    text_.add_line("std::cerr << std::endl;");
+    text_.add_line("status = 1;");
+    text_.add_line("continue;");
+    text_.decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
+
+    // the lookup tables are not captured, and are built from the scalars of
+    // the trace, because the range entry points don't update them
+    auto has_tables = std::any_of(
+        module_->symbols().begin(), module_->symbols().end(),
+        [] (Module::symbol_map::value_type const& s) {
+            auto proc = s.second->is_procedure();
+            return proc && proc->kind()==procedureKind::table;
+        });
+    if(has_tables) {
+        text_.add_line("mech.update_tables_();");
+        text_.add_line();
+    }
+    // the cached decay factors are computed from the parameters and dt of
+    // the trace in the same way
+    if(module_->symbols().count("dt_cache_")) {
+        text_.add_line("mech.update_dt_cache_(true);");
+        text_.add_line();
+    }
+
+    // the range entry points are called, so that the replay is not captured
+    text_.add_line("auto run = [&] {");
+    text_.increase_indentation();
+    bool first = true;
+    for(auto kernel: {"nrn_init", "nrn_state", "nrn_current"}) {
+        text_.add_gutter() << (first ? "if" : "else if")
+                           << "(trace.kernel==\"" << kernel << "\") "
+                           << "mech." << kernel << "(0, n);";
+        text_.end_line();
+        first = false;
+    }
+    text_.add_line("else return false;");
+    text_.add_line("return true;");
+    text_.decrease_indentation();
+    text_.add_line("};");
+    text_.add_line();
+
+    text_.add_line("// the outputs of the first call are compared with the trace");
+    text_.add_line("if(!run()) {");
+    text_.add_line("    std::cerr << file << \" is a trace of unknown kernel \" << trace.kernel << std::endl;");
+    text_.add_line("    status = 1;");
+    text_.add_line("    continue;");
+    text_.add_line("}");
+    text_.add_line("modcc::capture::trace result;");
+    text_.add_line("modcc::capture::gather outputs(result, false);");
+    text_.add_line("mech.capture_arrays(outputs);");
+    text_.add_line("double max_error = 0;");
+    text_.add_line("std::string worst;");
+    text_.add_line("for(auto const& a: result.arrays) {");
+    text_.increase_indentation();
+    text_.add_line("auto const& expected = trace.find(a.name)->after;");
+    text_.add_line("for(std::size_t i=0; i<a.before.size(); ++i) {");
+    text_.increase_indentation();
+    text_.add_line("double x = a.before[i], y = expected[i];");
+    text_.add_line("if(x==y || (std::isnan(x) && std::isnan(y))) continue;");
+    text_.add_line("// relative to the larger of the two, and infinite if one is NaN");
+    text_.add_line("double error = std::fabs(x-y)/std::max(std::fabs(x), std::fabs(y));");
+    text_.add_line("if(std::isnan(error)) error = std::numeric_limits<double>::infinity();");
+    text_.add_line("if(error>max_error) {");
+    text_.add_line("    max_error = error;");
+    text_.add_line("    worst = a.name;");
+    text_.add_line("}");
+    text_.decrease_indentation();
+    text_.add_line("}");
+    text_.decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
+
+    text_.add_line("// the inputs are restored before every call, outside of the timed region");
+    text_.add_line("double best = std::numeric_limits<double>::max();");
+    text_.add_line("for(int r=0; r<repetitions; ++r) {");
+    text_.increase_indentation();
+    text_.add_line("mech.capture_arrays(restore);");
+    text_.add_line("auto start = clock_type::now();");
+    text_.add_line("run();");
+    text_.add_line("best = std::min(best, seconds(clock_type::now()-start));");
+    text_.decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
+
+    text_.add_line("std::printf(\"%-12s %8llu %10d %14.3f %12.3g  %s\",");
+    text_.add_line("            trace.kernel.c_str(), (unsigned long long)trace.call, n,");
+    text_.add_line("            n ? 1e9*best/n : 0., max_error, file.c_str());");
+    text_.add_line("if(max_error>tolerance) {");
+    text_.add_line("    std::printf(\"  MISMATCH in %s\", worst.c_str());");
+    text_.add_line("    status = 1;");
+    text_.add_line("}");
+    text_.add_line("std::printf(\"\\n\");");
+    text_.decrease_indentation();
+    text_.add_line("}");
+    text_.add_line();
+    text_.add_line("return status;");
+    text_.decrease_indentation();
+    text_.add_line("}");
+}
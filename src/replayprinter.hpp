@@ -0,0 +1,27 @@
+#pragma once
+
+#include "cprinter.hpp"
+#include "module.hpp"
+#include "textbuffer.hpp"
+
+/// Prints a self contained replay driver for a mechanism: the mechanism as
+/// printed by CPrinter with kernel capture enabled, followed by a main() that
+/// loads traces of kernel calls that were captured with MODCC_CAPTURE, runs
+/// the kernel of each trace on its inputs, checks the outputs against the
+/// trace, and reports the time per instance.
+/// The driver is compiled against the stand-in runtime in tests/bench/runtime.
+class ReplayPrinter {
+public:
+    ReplayPrinter(Module &m, CPrinterOptions const& opts);
+
+    std::string text() const {
+        return text_.str();
+    }
+
+private:
+    void print_driver();
+
+    Module *module_ = nullptr;
+    CPrinterOptions options_;
+    TextBuffer text_;
+};
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+#include "roofline.hpp"
+#include "util.hpp"
+
+/******************************************************************************
+                              MachineModel
+******************************************************************************/
+
+double MachineModel::weighted_flops(FlopAccumulator const& f) const {
+    return f.add + f.neg + f.mul
+         + cost_div*f.div
+         + cost_exp*f.exp
+         + cost_log*f.log
+         + cost_pow*f.pow
+         + cost_sin*f.sin
+         + cost_cos*f.cos;
+}
+
+static std::string trim(std::string const& s) {
+    auto b = s.find_first_not_of(" \t\r");
+    if(b==std::string::npos) return "";
+    auto e = s.find_last_not_of(" \t\r");
+    return s.substr(b, e-b+1);
+}
+
+MachineModel read_machine_model(std::string const& filename) {
+    std::ifstream fid(filename);
+    if(!fid) {
+        throw std::runtime_error(pprintf("unable to open machine file %", filename));
+    }
+
+    MachineModel machine;
+    std::map<std::string, double*> values = {
+        {"peak_gflops", &machine.peak_gflops},
+        {"bandwidth",   &machine.bandwidth},
+        {"cost_div",    &machine.cost_div},
+        {"cost_exp",    &machine.cost_exp},
+        {"cost_log",    &machine.cost_log},
+        {"cost_pow",    &machine.cost_pow},
+        {"cost_sin",    &machine.cost_sin},
+        {"cost_cos",    &machine.cost_cos},
+    };
+
+    std::string line;
+    int line_number = 0;
+    while(std::getline(fid, line)) {
+        ++line_number;
+        line = trim(line.substr(0, line.find('#')));
+        if(line.empty()) continue;
+
+        auto pos = line.find('=');
+        if(pos==std::string::npos) {
+            throw std::runtime_error(
+                pprintf("%:%: expected 'key = value'", filename, line_number));
+        }
+        auto key   = trim(line.substr(0, pos));
+        auto value = trim(line.substr(pos+1));
+
+        if(key=="name") {
+            machine.name = value;
+            continue;
+        }
+
+        std::istringstream s(value);
+        double v;
+        if(!(s >> v) || v<=0) {
+            throw std::runtime_error(
+                pprintf("%:%: '%' is not a positive number", filename, line_number, value));
+        }
+        if(key=="vector_width") {
+            machine.vector_width = int(v);
+        }
+        else if(values.count(key)) {
+            *values[key] = v;
+        }
+        else {
+            throw std::runtime_error(
+                pprintf("%:%: unknown key '%'", filename, line_number, key));
+        }
+    }
+
+    return machine;
+}
+
+/******************************************************************************
+                              roofline
+******************************************************************************/
+
+RooflineEstimate roofline(FlopAccumulator const& f, int bytes, MachineModel const& machine) {
+    RooflineEstimate r;
+    r.flops = machine.weighted_flops(f);
+    r.bytes = bytes;
+    r.intensity = bytes ? r.flops/bytes : 0.;
+
+    // GFLOP/s and GB/s are equivalent to flops and bytes per ns
+    auto compute_time = r.flops/machine.peak_gflops;
+    auto memory_time  = r.bytes/machine.bandwidth;
+    r.time = std::max(compute_time, memory_time);
+    r.memory_bound = memory_time >= compute_time;
+
+    return r;
+}
+
+std::string roofline_report(RooflineEstimate const& r, MachineModel const& machine) {
+    std::stringstream s;
+    s << std::fixed << std::setprecision(3);
+
+    auto w = std::setw(10);
+    s << "machine   " << machine.name << std::endl;
+    s << "flops     " << w << r.flops     << " /instance (weighted)" << std::endl;
+    s << "bytes     " << w << r.bytes     << " /instance" << std::endl;
+    s << "intensity " << w << r.intensity << " flop/byte (ridge point "
+      << machine.ridge_point() << ")" << std::endl;
+    s << "time      " << w << r.time      << " ns/instance, "
+      << (r.memory_bound ? "memory bound" : "compute bound") << std::endl;
+
+    // the compute ceiling if the kernel is not vectorized
+    auto scalar_time = std::max(r.flops*machine.vector_width/machine.peak_gflops,
+                                r.bytes/machine.bandwidth);
+    if(scalar_time > r.time) {
+        s << "          " << w << scalar_time
+          << " ns/instance if not vectorized" << std::endl;
+    }
+
+    return s.str();
+}
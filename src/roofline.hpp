@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+
+#include "perfvisitor.hpp"
+
+/// description of the machine used by the roofline model
+struct MachineModel {
+    std::string name = "generic";
+    // peak double precision performance of the cores that run the kernels
+    double peak_gflops = 50.;
+    // memory bandwidth available to the cores that run the kernels
+    double bandwidth = 10.;
+    // number of doubles in a vector register
+    int vector_width = 4;
+
+    // cost of each operation relative to an add or multiply
+    double cost_div = 4.;
+    double cost_exp = 10.;
+    double cost_log = 10.;
+    double cost_pow = 20.;
+    double cost_sin = 10.;
+    double cost_cos = 10.;
+
+    /// the number of operations weighted by their cost
+    double weighted_flops(FlopAccumulator const& f) const;
+
+    /// the arithmetic intensity above which kernels are compute bound
+    double ridge_point() const {
+        return peak_gflops/bandwidth;
+    }
+};
+
+/// Read a machine description from a file with one "key = value" pair per
+/// line, where the keys are the names of the fields in MachineModel, and
+/// comments start with #.
+/// Fields that are not given keep their default value.
+/// Throws std::runtime_error if the file can't be read, or has an unknown key.
+MachineModel read_machine_model(std::string const& filename);
+
+/// the position of a kernel in the roofline model
+struct RooflineEstimate {
+    double flops = 0;       // weighted operations per instance
+    double bytes = 0;       // bytes moved per instance
+    double intensity = 0;   // flops per byte
+    double time = 0;        // predicted time per instance in ns
+    bool memory_bound = false;
+};
+
+RooflineEstimate roofline(FlopAccumulator const& f, int bytes, MachineModel const& machine);
+
+/// a short human readable report of the estimate
+std::string roofline_report(RooflineEstimate const& r, MachineModel const& machine);
@@ -0,0 +1,216 @@
+#include "symdiff.hpp"
+#include "util.hpp"
+
+// helpers that build expressions, simplifying terms that are zero or one
+
+static bool is_number(Expression* e, long double value) {
+    auto n = e->is_number();
+    return n && n->value()==value;
+}
+
+bool is_zero(Expression* e) {
+    return is_number(e, 0);
+}
+
+static expression_ptr number(long double value) {
+    return make_expression<NumberExpression>(Location(), value);
+}
+
+static expression_ptr neg(expression_ptr&& a) {
+    if(is_zero(a.get())) return number(0);
+    return unary_expression(Location(), tok::minus, std::move(a));
+}
+
+static expression_ptr add(expression_ptr&& a, expression_ptr&& b) {
+    if(is_zero(a.get())) return std::move(b);
+    if(is_zero(b.get())) return std::move(a);
+    return binary_expression(tok::plus, std::move(a), std::move(b));
+}
+
+static expression_ptr sub(expression_ptr&& a, expression_ptr&& b) {
+    if(is_zero(b.get())) return std::move(a);
+    if(is_zero(a.get())) return neg(std::move(b));
+    return binary_expression(tok::minus, std::move(a), std::move(b));
+}
+
+static expression_ptr mul(expression_ptr&& a, expression_ptr&& b) {
+    if(is_zero(a.get()) || is_zero(b.get())) return number(0);
+    if(is_number(a.get(), 1)) return std::move(b);
+    if(is_number(b.get(), 1)) return std::move(a);
+    return binary_expression(tok::times, std::move(a), std::move(b));
+}
+
+static expression_ptr div(expression_ptr&& a, expression_ptr&& b) {
+    if(is_zero(a.get())) return number(0);
+    if(is_number(b.get(), 1)) return std::move(a);
+    return binary_expression(tok::divide, std::move(a), std::move(b));
+}
+
+static expression_ptr pow(expression_ptr&& a, expression_ptr&& b) {
+    if(is_number(b.get(), 1)) return std::move(a);
+    return binary_expression(tok::pow, std::move(a), std::move(b));
+}
+
+expression_ptr symbolic_derivative(
+    Expression* e, std::string const& x,
+    std::map<std::string, std::string> const& chain)
+{
+    DifferentiationVisitor v(x, chain);
+    e->accept(&v);
+    return v.derivative();
+}
+
+// expressions that are not handled below, e.g. function calls and
+// conditionals, can't be differentiated
+void DifferentiationVisitor::visit(Expression *e) {
+    failed_ = true;
+    derivative_ = number(0);
+}
+
+void DifferentiationVisitor::visit(NumberExpression *e) {
+    derivative_ = number(0);
+}
+
+// a random draw doesn't depend on x
+void DifferentiationVisitor::visit(RandomExpression *e) {
+    derivative_ = number(0);
+}
+
+void DifferentiationVisitor::visit(IdentifierExpression *e) {
+    auto const& name = e->spelling();
+    if(name==x_) {
+        derivative_ = number(1);
+        return;
+    }
+    auto it = chain_.find(name);
+    if(it!=chain_.end()) {
+        derivative_ = make_expression<IdentifierExpression>(Location(), it->second);
+        return;
+    }
+    derivative_ = number(0);
+}
+
+void DifferentiationVisitor::visit(UnaryExpression *e) {
+    auto u  = e->expression();
+    auto du = derivative_of(u);
+    switch(e->op()) {
+        case tok::minus :
+            derivative_ = neg(std::move(du));
+            return;
+        case tok::exp :
+            derivative_ = mul(std::move(du), e->clone());
+            return;
+        case tok::log :
+            derivative_ = div(std::move(du), u->clone());
+            return;
+        case tok::sin :
+            derivative_ = mul(std::move(du), unary_expression(Location(), tok::cos, u->clone()));
+            return;
+        case tok::cos :
+            derivative_ = neg(mul(std::move(du), unary_expression(Location(), tok::sin, u->clone())));
+            return;
+        // the derivative of a lookup table is not tabulated
+        case tok::table :
+            if(!is_zero(du.get())) failed_ = true;
+            derivative_ = number(0);
+            return;
+        default :
+            failed_ = true;
+            derivative_ = number(0);
+    }
+}
+
+void DifferentiationVisitor::visit(BinaryExpression *e) {
+    auto a  = e->lhs();
+    auto b  = e->rhs();
+    auto da = derivative_of(a);
+    auto db = derivative_of(b);
+    switch(e->op()) {
+        case tok::plus :
+            derivative_ = add(std::move(da), std::move(db));
+            return;
+        case tok::minus :
+            derivative_ = sub(std::move(da), std::move(db));
+            return;
+        case tok::times :
+            derivative_ = add(mul(std::move(da), b->clone()), mul(a->clone(), std::move(db)));
+            return;
+        case tok::divide :
+            // (a/b)' = a'/b - a*b'/(b*b)
+            derivative_ = sub(
+                div(std::move(da), b->clone()),
+                div(mul(a->clone(), std::move(db)), mul(b->clone(), b->clone())));
+            return;
+        case tok::pow :
+            // a constant exponent: (a^n)' = n*a^(n-1)*a'
+            if(is_zero(db.get())) {
+                auto n = b->is_number();
+                auto power = n ?
+                    pow(a->clone(), number(n->value()-1)) :
+                    pow(a->clone(), binary_expression(tok::minus, b->clone(), number(1)));
+                derivative_ = mul(mul(b->clone(), std::move(power)), std::move(da));
+            }
+            // otherwise: (a^b)' = a^b*(b'*log(a) + b*a'/a)
+            else {
+                derivative_ = mul(
+                    e->clone(),
+                    add(mul(std::move(db), unary_expression(Location(), tok::log, a->clone())),
+                        div(mul(b->clone(), std::move(da)), a->clone())));
+            }
+            return;
+        default :
+            failed_ = true;
+            derivative_ = number(0);
+    }
+}
+
+/// collects the names of the identifiers and the random draws in an expression
+class IdentifierCollector : public Visitor {
+public:
+    void visit(Expression *e)           override {}
+    void visit(IdentifierExpression *e) override {
+        names.insert(e->spelling());
+    }
+    void visit(RandomExpression *e)     override {
+        draws.push_back(e);
+    }
+    void visit(UnaryExpression *e)      override {
+        e->expression()->accept(this);
+    }
+    void visit(BinaryExpression *e)     override {
+        e->lhs()->accept(this);
+        e->rhs()->accept(this);
+    }
+    void visit(CallExpression *e)       override {
+        for(auto& a : e->args()) {
+            a->accept(this);
+        }
+    }
+    void visit(BlockExpression *e)      override {
+        for(auto& s : *e) {
+            s->accept(this);
+        }
+    }
+    void visit(IfExpression *e)         override {
+        e->condition()->accept(this);
+        e->true_branch()->accept(this);
+        if(e->false_branch()) {
+            e->false_branch()->accept(this);
+        }
+    }
+
+    std::set<std::string> names;
+    std::vector<RandomExpression*> draws;
+};
+
+std::set<std::string> identifiers(Expression* e) {
+    IdentifierCollector v;
+    e->accept(&v);
+    return v.names;
+}
+
+std::vector<RandomExpression*> random_draws(Expression* e) {
+    IdentifierCollector v;
+    e->accept(&v);
+    return v.draws;
+}
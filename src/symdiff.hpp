@@ -0,0 +1,61 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "visitor.hpp"
+
+/// The derivative of e with respect to the variable x, or nullptr if e has
+/// an expression that can't be differentiated, e.g. a call to a function
+/// that was not inlined.
+/// The derivatives with respect to x of other variables, e.g. local variables
+/// that were computed from x, are given in chain by the names of the
+/// variables that hold them. All other identifiers are constant.
+/// Terms that are zero or one are simplified away, so that the derivative
+/// of an expression that does not depend on x is the number 0.
+expression_ptr symbolic_derivative(
+    Expression* e, std::string const& x,
+    std::map<std::string, std::string> const& chain = {});
+
+/// true if e is the number 0
+bool is_zero(Expression* e);
+
+/// the names of the identifiers in an expression
+std::set<std::string> identifiers(Expression* e);
+
+/// the random draws in an expression, in the order of its statements
+std::vector<RandomExpression*> random_draws(Expression* e);
+
+class DifferentiationVisitor : public Visitor {
+public:
+    DifferentiationVisitor(
+        std::string const& x, std::map<std::string, std::string> const& chain)
+    :   x_(x), chain_(chain)
+    {}
+
+    void visit(Expression *e)           override;
+    void visit(NumberExpression *e)     override;
+    void visit(RandomExpression *e)     override;
+    void visit(IdentifierExpression *e) override;
+    void visit(UnaryExpression *e)      override;
+    void visit(BinaryExpression *e)     override;
+
+    /// the derivative of the last expression that was visited, or nullptr
+    /// if it can't be differentiated
+    expression_ptr derivative() {
+        return failed_ ? nullptr : std::move(derivative_);
+    }
+
+private:
+    expression_ptr derivative_of(Expression* e) {
+        e->accept(this);
+        return std::move(derivative_);
+    }
+
+    std::string x_;
+    std::map<std::string, std::string> const& chain_;
+    expression_ptr derivative_;
+    bool failed_ = false;
+};
@@ -0,0 +1,376 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "functioninliner.hpp"
+#include "module.hpp"
+#include "table.hpp"
+#include "util.hpp"
+
+// the procedure that builds the tables of a FUNCTION or PROCEDURE
+static std::string builder_name(std::string const& owner) {
+    return owner + "_table_";
+}
+
+static std::string owner_name(ProcedureExpression* builder) {
+    auto const& name = builder->name();
+    return name.substr(0, name.size()-builder_name("").size());
+}
+
+symbol_ptr lower_table(Symbol* s, Module& module) {
+    BlockExpression* body;
+    std::vector<expression_ptr>* args;
+    auto function = s->is_function();
+    auto procedure = s->is_procedure();
+    if(function) {
+        body = function->body();
+        args = &function->args();
+    }
+    else if(procedure && procedure->kind()==procedureKind::normal) {
+        body = procedure->body();
+        args = &procedure->args();
+    }
+    else {
+        return nullptr;
+    }
+
+    auto& statements = body->statements();
+    auto it = std::find_if(statements.begin(), statements.end(),
+        [] (expression_ptr const& e) {return e->is_table_statement()!=nullptr;});
+    if(it==statements.end()) return nullptr;
+
+    // the TABLE statement is always removed, so that the body is evaluated
+    // directly if tables are not used
+    auto table_statement = std::move(*it);
+    statements.erase(it);
+    if(!module.use_tables()) return nullptr;
+
+    auto table = table_statement->is_table_statement();
+    auto loc = table->location();
+    auto const& owner = s->name();
+    if(args->size()!=1) {
+        module.error(pprintf("'%' must have one argument to have a TABLE", owner), loc);
+        return nullptr;
+    }
+    if(function && table->names().size()) {
+        module.error("the TABLE of a FUNCTION can't list variables, because the"
+                     " value of the function is tabulated", loc);
+        return nullptr;
+    }
+    if(procedure && table->names().empty()) {
+        module.error("the TABLE of a PROCEDURE must list the variables that are"
+                     " tabulated", loc);
+        return nullptr;
+    }
+
+    auto id = [loc] (std::string const& name) {
+        return make_expression<IdentifierExpression>(loc, name);
+    };
+    auto arg = (*args)[0]->is_argument();
+
+    // the value of a function is held by a local variable, which can't have
+    // the name of the function
+    std::vector<std::string> assigned = table->names();
+    if(function) {
+        table->names() = {owner + "_"};
+    }
+    for(auto& name : table->names()) {
+        table->lookups().push_back(
+            function ? owner + "_lookup_" : owner + "_" + name + "_lookup_");
+    }
+
+    // the statements of the body compute the tabulated variables as locals
+    std::list<expression_ptr> builder_body;
+    for(auto& name : table->names()) {
+        builder_body.push_back(make_expression<LocalDeclaration>(loc, name));
+    }
+    for(auto& e : statements) {
+        auto c = e->clone();
+        if(function) {
+            VariableReplacer v(owner, owner + "_");
+            c->accept(&v);
+        }
+        builder_body.push_back(std::move(c));
+    }
+    std::vector<expression_ptr> builder_args;
+    builder_args.push_back(make_expression<ArgumentExpression>(arg->location(), arg->token()));
+
+    // the body is replaced with lookups in the tables
+    statements.clear();
+    for(auto i=0u; i<table->names().size(); ++i) {
+        auto lhs = function ? owner : assigned[i];
+        statements.push_back(binary_expression(loc, tok::eq, id(lhs),
+            make_expression<TableLookupExpression>(loc, table->lookups()[i], id(arg->spelling()))));
+    }
+
+    auto builder = make_symbol<ProcedureExpression>(
+        loc, builder_name(owner), std::move(builder_args),
+        make_expression<BlockExpression>(loc, std::move(builder_body), false),
+        procedureKind::table);
+    builder->is_procedure()->table(std::move(table_statement));
+    return builder;
+}
+
+/// checks that the statements of a procedure that builds tables depend only
+/// on its argument, its locals and scalar variables
+class TableChecker : public Visitor {
+public:
+    TableChecker(std::string const& owner, Module& module)
+    :   owner_(owner), module_(module)
+    {}
+
+    // numbers and local declarations
+    void visit(Expression *e) override {}
+
+    void visit(IdentifierExpression *e) override {
+        auto s = e->symbol();
+        if(s && s->is_local_variable()) return;
+        if(s && s->is_variable() && s->is_variable()->is_scalar()) {
+            scalars.insert(s->name());
+            return;
+        }
+        error(pprintf("the TABLE of '%' can't depend on '%', which is not its"
+                      " argument or a scalar variable", owner_, e->spelling()), e->location());
+    }
+
+    void visit(UnaryExpression *e) override {
+        e->expression()->accept(this);
+    }
+
+    void visit(TableLookupExpression *e) override {
+        error(pprintf("the TABLE of '%' can't be built from the table '%'",
+                      owner_, e->name()), e->location());
+    }
+
+    void visit(BinaryExpression *e) override {
+        e->lhs()->accept(this);
+        e->rhs()->accept(this);
+    }
+
+    void visit(AssignmentExpression *e) override {
+        auto id = e->lhs()->is_identifier();
+        auto s = id ? id->symbol() : nullptr;
+        if(!s || !s->is_local_variable()) {
+            error(pprintf("'%' has a TABLE, so it can only assign the tabulated"
+                          " variables and locals", owner_), e->location());
+        }
+        e->rhs()->accept(this);
+    }
+
+    void visit(CallExpression *e) override {
+        error(pprintf("'%' has a TABLE, so it can't call '%'", owner_, e->name()),
+              e->location());
+    }
+
+    void visit(RandomExpression *e) override {
+        error(pprintf("'%' has a TABLE, so it can't draw random numbers", owner_),
+              e->location());
+    }
+
+    void visit(IfExpression *e) override {
+        e->condition()->accept(this);
+        e->true_branch()->accept(this);
+        if(e->false_branch()) {
+            e->false_branch()->accept(this);
+        }
+    }
+
+    void visit(BlockExpression *e) override {
+        for(auto& s : *e) {
+            s->accept(this);
+        }
+    }
+
+    std::set<std::string> scalars;
+    bool failed = false;
+
+private:
+    void error(std::string const& msg, Location loc) {
+        module_.error(msg, loc);
+        failed = true;
+    }
+
+    std::string const& owner_;
+    Module& module_;
+};
+
+/// evaluates the statements of a procedure that builds tables, with the
+/// default values of scalar variables
+class TableEvaluator : public Visitor {
+public:
+    // local declarations
+    void visit(Expression *e) override {}
+
+    void visit(NumberExpression *e) override {
+        value = e->value();
+    }
+
+    void visit(IdentifierExpression *e) override {
+        auto it = values.find(e->spelling());
+        if(it!=values.end()) {
+            value = it->second;
+        }
+        else if(auto var = e->symbol()->is_variable()) {
+            value = var->value();
+        }
+        else {
+            value = std::numeric_limits<double>::quiet_NaN();
+        }
+    }
+
+    void visit(UnaryExpression *e) override {
+        e->expression()->accept(this);
+        switch(e->op()) {
+            case tok::minus : value = -value;           break;
+            case tok::exp   : value = std::exp(value);  break;
+            case tok::log   : value = std::log(value);  break;
+            case tok::sin   : value = std::sin(value);  break;
+            case tok::cos   : value = std::cos(value);  break;
+            default         : value = std::numeric_limits<double>::quiet_NaN();
+        }
+    }
+
+    void visit(BinaryExpression *e) override {
+        e->lhs()->accept(this);
+        auto a = value;
+        e->rhs()->accept(this);
+        auto b = value;
+        switch(e->op()) {
+            case tok::plus     : value = a + b;            break;
+            case tok::minus    : value = a - b;            break;
+            case tok::times    : value = a * b;            break;
+            case tok::divide   : value = a / b;            break;
+            case tok::pow      : value = std::pow(a, b);   break;
+            case tok::lt       : value = a <  b;           break;
+            case tok::lte      : value = a <= b;           break;
+            case tok::gt       : value = a >  b;           break;
+            case tok::gte      : value = a >= b;           break;
+            case tok::equality : value = a == b;           break;
+            case tok::ne       : value = a != b;           break;
+            default            : value = std::numeric_limits<double>::quiet_NaN();
+        }
+    }
+
+    void visit(AssignmentExpression *e) override {
+        e->rhs()->accept(this);
+        values[e->lhs()->is_identifier()->spelling()] = value;
+    }
+
+    void visit(IfExpression *e) override {
+        e->condition()->accept(this);
+        if(value!=0) {
+            e->true_branch()->accept(this);
+        }
+        else if(e->false_branch()) {
+            e->false_branch()->accept(this);
+        }
+    }
+
+    void visit(BlockExpression *e) override {
+        for(auto& s : *e) {
+            s->accept(this);
+        }
+    }
+
+    std::map<std::string, double> values;
+    double value = 0;
+};
+
+// the interpolation error of each table is estimated from its exact value
+// midway between the points of the table, where the error of linear
+// interpolation is largest, and which is proportional to the square of the
+// spacing of the table
+static void check_accuracy(ProcedureExpression* builder, Module& module) {
+    auto const tolerance = 1e-3;
+
+    auto table = builder->table();
+    auto const& arg = builder->args()[0]->is_argument()->spelling();
+    auto owner = owner_name(builder);
+    int n = table->n();
+    int num_names = table->names().size();
+
+    // the tables can't be evaluated if a scalar has no default value, e.g. dt
+    for(auto& name : table->depends()) {
+        auto s = module.symbols().find(name);
+        auto value = s->second->is_variable()->value();
+        if(value!=value) return;
+    }
+
+    // the values at the points of the table, and midway between them
+    std::vector<std::vector<double>> samples(num_names);
+    for(auto k=0; k<=2*n; ++k) {
+        TableEvaluator v;
+        v.values[arg] = table->from() + k*(table->to()-table->from())/(2*n);
+        builder->body()->accept(&v);
+        for(auto i=0; i<num_names; ++i) {
+            auto it = v.values.find(table->names()[i]);
+            samples[i].push_back(
+                it==v.values.end() ? std::numeric_limits<double>::quiet_NaN() : it->second);
+        }
+    }
+
+    for(auto i=0; i<num_names; ++i) {
+        // the table of a function has the name of the function
+        auto label = table->lookups()[i]==owner+"_lookup_" ?
+            pprintf("'%'", owner) : pprintf("'%' in '%'", table->names()[i], owner);
+        auto const& f = samples[i];
+        if(std::any_of(f.begin(), f.end(), [](double x) {return !std::isfinite(x);})) {
+            module.warning(pprintf("the TABLE of % has values that are not finite"
+                                   " between % and %", label, table->from(), table->to()),
+                           table->location());
+            continue;
+        }
+        auto scale = 0.;
+        for(auto x : f) {
+            scale = std::max(scale, std::fabs(x));
+        }
+        if(scale==0) continue;
+        auto error = 0.;
+        for(auto j=0; j<n; ++j) {
+            auto interpolated = (f[2*j] + f[2*j+2])/2;
+            error = std::max(error, std::fabs(interpolated - f[2*j+1])/scale);
+        }
+        if(error>tolerance) {
+            int needed = std::ceil(n*std::sqrt(error/tolerance));
+            module.warning(pprintf("the TABLE of % has a relative interpolation error"
+                                   " of % with % intervals, WITH % is needed for %",
+                                   label, error, n, needed, tolerance),
+                           table->location());
+        }
+    }
+}
+
+bool check_table(ProcedureExpression* builder, Module& module) {
+    auto table = builder->table();
+    auto owner = owner_name(builder);
+
+    TableChecker checker(owner, module);
+    builder->body()->accept(&checker);
+
+    for(auto& name : table->depends()) {
+        auto s = module.symbols().find(name);
+        auto var = s==module.symbols().end() ? nullptr : s->second->is_variable();
+        if(!var || !var->is_scalar()) {
+            module.error(pprintf("the TABLE of '%' can only DEPEND on scalar variables,"
+                                 " which '%' is not", owner, name), table->location());
+            checker.failed = true;
+        }
+    }
+    if(checker.failed) return false;
+
+    // the scalars that are read are dependencies, whether they are listed
+    // with DEPEND or not
+    auto& depends = table->depends();
+    for(auto& name : checker.scalars) {
+        if(std::find(depends.begin(), depends.end(), name)==depends.end()) {
+            depends.push_back(name);
+        }
+    }
+
+    check_accuracy(builder, module);
+    return true;
+}
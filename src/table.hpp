@@ -0,0 +1,31 @@
+#pragma once
+
+#include "expression.hpp"
+
+class Module;
+
+/// Lower the TABLE statement of a FUNCTION or PROCEDURE with one argument
+///     PROCEDURE rates(v) {
+///         TABLE minf, mtau FROM -100 TO 100 WITH 200
+///         ...
+///     }
+/// The statements of the body are moved to a new procedure, rates_table_,
+/// which computes the tabulated variables as locals for one value of the
+/// argument, and the body is replaced with lookups in the tables
+///     minf = lookup(rates_minf_lookup_, v)
+///     mtau = lookup(rates_mtau_lookup_, v)
+/// The value of a FUNCTION is tabulated in the same way.
+/// Returns the procedure that builds the tables, which has to be added to the
+/// symbol table, or nullptr if there is no TABLE or the module does not use
+/// tables, in which case the TABLE statement is removed from the body.
+/// Errors are reported to the module.
+symbol_ptr lower_table(Symbol* s, Module& module);
+
+/// Check that a procedure created by lower_table, after its semantic analysis
+/// and the inlining of its function calls, depends only on its argument and
+/// on scalar variables, which are added to the DEPEND list of the TABLE.
+/// The procedure is evaluated with the default values of the scalars, and a
+/// warning is given if the linear interpolation in a table has a relative
+/// error larger than 1e-3, with the WITH value that is needed to reach it.
+/// Returns false if there were errors, which are reported to the module.
+bool check_table(ProcedureExpression* builder, Module& module);
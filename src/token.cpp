@@ -29,6 +29,7 @@ static Keyword keywords[] = {
     {"STATE",       tok::state},
     {"BREAKPOINT",  tok::breakpoint},
     {"DERIVATIVE",  tok::derivative},
+    {"KINETIC",     tok::kinetic},
     {"PROCEDURE",   tok::procedure},
     {"FUNCTION",    tok::function},
     {"INITIAL",     tok::initial},
@@ -47,13 +48,24 @@ static Keyword keywords[] = {
     {"GLOBAL",      tok::global},
     {"POINT_PROCESS", tok::point_process},
     {"METHOD",      tok::method},
+    {"CONSERVE",    tok::conserve},
+    {"TABLE",       tok::table},
+    {"DEPEND",      tok::depend},
+    {"FROM",        tok::from},
+    {"TO",          tok::to},
+    {"WITH",        tok::with},
     {"if",          tok::if_stmt},
     {"else",        tok::else_stmt},
     {"cnexp",       tok::cnexp},
+    {"sparse",      tok::sparse},
+    {"derivimplicit", tok::derivimplicit},
     {"exp",         tok::exp},
     {"sin",         tok::sin},
     {"cos",         tok::cos},
     {"log",         tok::log},
+    {"random_uniform",     tok::random_uniform},
+    {"random_exponential", tok::random_exponential},
+    {"random_normal",      tok::random_normal},
     {"CONDUCTANCE", tok::conductance},
     {nullptr,       tok::reserved},
 };
@@ -74,6 +86,8 @@ static TokenString token_strings[] = {
     {"!=",          tok::ne},
     {",",           tok::comma},
     {"'",           tok::prime},
+    {"~",           tok::tilde},
+    {"<->",         tok::arrow},
     {"{",           tok::lbrace},
     {"}",           tok::rbrace},
     {"(",           tok::lparen},
@@ -88,6 +102,7 @@ static TokenString token_strings[] = {
     {"STATE",       tok::state},
     {"BREAKPOINT",  tok::breakpoint},
     {"DERIVATIVE",  tok::derivative},
+    {"KINETIC",     tok::kinetic},
     {"PROCEDURE",   tok::procedure},
     {"FUNCTION",    tok::function},
     {"INITIAL",     tok::initial},
@@ -106,6 +121,12 @@ static TokenString token_strings[] = {
     {"GLOBAL",      tok::global},
     {"POINT_PROCESS", tok::point_process},
     {"METHOD",      tok::method},
+    {"CONSERVE",    tok::conserve},
+    {"TABLE",       tok::table},
+    {"DEPEND",      tok::depend},
+    {"FROM",        tok::from},
+    {"TO",          tok::to},
+    {"WITH",        tok::with},
     {"if",          tok::if_stmt},
     {"else",        tok::else_stmt},
     {"eof",         tok::eof},
@@ -113,7 +134,12 @@ static TokenString token_strings[] = {
     {"log",         tok::log},
     {"cos",         tok::cos},
     {"sin",         tok::sin},
+    {"random_uniform",     tok::random_uniform},
+    {"random_exponential", tok::random_exponential},
+    {"random_normal",      tok::random_normal},
     {"cnexp",       tok::cnexp},
+    {"sparse",      tok::sparse},
+    {"derivimplicit", tok::derivimplicit},
     {"CONDUCTANCE", tok::conductance},
     {"error",       tok::reserved},
 };
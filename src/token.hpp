@@ -26,6 +26,9 @@ enum class tok {
     // , '
     comma, prime,
 
+    // ~ <->
+    tilde, arrow,
+
     // { }
     lbrace, rbrace,
     // ( )
@@ -44,7 +47,7 @@ enum class tok {
     title,
     neuron, units, parameter,
     assigned, state, breakpoint,
-    derivative, procedure, initial, function,
+    derivative, kinetic, procedure, initial, function,
     net_receive,
 
     // keywoards inside blocks
@@ -53,17 +56,22 @@ enum class tok {
     read, write,
     range, local,
     solve, method,
+    conserve,
+    table, depend, from, to, with,
     threadsafe, global,
     point_process,
 
     // unary operators
     exp, sin, cos, log,
 
+    // random number intrinsics
+    random_uniform, random_exponential, random_normal,
+
     // logical keywords
     if_stmt, else_stmt, // add _stmt to avoid clash with c++ keywords
 
     // solver methods
-    cnexp,
+    cnexp, sparse, derivimplicit,
 
     conductance,
 
@@ -0,0 +1,121 @@
+#include <sstream>
+
+#include "expression.hpp"
+#include "util.hpp"
+#include "vectorizationvisitor.hpp"
+
+std::string to_string(vectorBlocker b) {
+    switch(b) {
+        case vectorBlocker::procedure_call : return "procedure_call";
+        case vectorBlocker::branch         : return "branch";
+        case vectorBlocker::pow            : return "pow";
+        case vectorBlocker::aliased_write  : return "aliased_write";
+        case vectorBlocker::ghost_local    : return "ghost_local";
+    }
+    return "unknown";
+}
+
+// true if the expression only has numbers as operands
+static bool is_constant(Expression* e) {
+    if(e->is_number()) {
+        return true;
+    }
+    if(auto u = e->is_unary()) {
+        return is_constant(u->expression());
+    }
+    if(auto b = e->is_binary()) {
+        return is_constant(b->lhs()) && is_constant(b->rhs());
+    }
+    return false;
+}
+
+void VectorizationVisitor::visit(APIMethod *e) {
+    method_location_ = e->location();
+    e->body()->accept(this);
+}
+
+void VectorizationVisitor::visit(BlockExpression *e) {
+    for(auto& expression : *e) {
+        expression->accept(this);
+    }
+}
+
+void VectorizationVisitor::visit(UnaryExpression *e) {
+    e->expression()->accept(this);
+}
+
+void VectorizationVisitor::visit(BinaryExpression *e) {
+    e->lhs()->accept(this);
+    e->rhs()->accept(this);
+}
+
+void VectorizationVisitor::visit(PowBinaryExpression *e) {
+    if(!is_constant(e->rhs())) {
+        report(vectorBlocker::pow, e->location(),
+            "pow with a non-constant exponent is a call to std::pow,"
+            " which is vectorized only with a vector math library");
+    }
+    e->lhs()->accept(this);
+    e->rhs()->accept(this);
+}
+
+void VectorizationVisitor::visit(CallExpression *e) {
+    report(vectorBlocker::procedure_call, e->location(),
+        "call to procedure " + e->name()
+        + " is printed as a function call, which is vectorized only if it is inlined");
+    for(auto& arg : e->args()) {
+        arg->accept(this);
+    }
+}
+
+void VectorizationVisitor::visit(IfExpression *e) {
+    report(vectorBlocker::branch, e->location(),
+        "if statement is vectorized only if both branches can be executed with masks");
+    e->condition()->accept(this);
+    e->true_branch()->accept(this);
+    if(e->false_branch()) {
+        e->false_branch()->accept(this);
+    }
+}
+
+void VectorizationVisitor::visit(AssignmentExpression *e) {
+    e->rhs()->accept(this);
+
+    if(!point_process_) return;
+
+    // instances of point processes can share a node, so writes to indexed
+    // arrays are scatters with possible conflicts
+    auto symbol = e->lhs()->is_identifier()->symbol();
+    if(!symbol || !written_.insert(symbol).second) return;
+
+    if(auto var = symbol->is_indexed_variable()) {
+        report(vectorBlocker::aliased_write, method_location_,
+            "write to " + var->index_name()
+            + " is a scatter that may alias between instances on the same node");
+    }
+    else if(auto l = symbol->is_local_variable()) {
+        if(!(l->is_local() && l->is_indexed() && l->is_write())) return;
+
+        auto ext = l->external_variable()->index_name();
+        if(optimize_) {
+            report(vectorBlocker::ghost_local, method_location_,
+                "write to " + l->name() + " goes through a ghost buffer: the loop"
+                " is vectorized in blocks of 4 and the write back to " + ext + " is scalar");
+        }
+        else {
+            report(vectorBlocker::aliased_write, method_location_,
+                "write back of " + l->name() + " to " + ext
+                + " is a scatter that may alias between instances on the same node"
+                " (use -O to write through ghost buffers)");
+        }
+    }
+}
+
+std::string VectorizationVisitor::print(std::string const& file_name) const {
+    std::stringstream s;
+    for(auto const& d : diagnostics_) {
+        s << pprintf("%:% ", file_name, d.location)
+          << "[" << to_string(d.kind) << "] " << d.message << std::endl;
+    }
+    return s.str();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "location.hpp"
+#include "visitor.hpp"
+
+enum class vectorBlocker {
+    procedure_call, // call to a procedure that is printed as a function call
+    branch,         // if statement in the loop body
+    pow,            // pow with an exponent that is not a constant
+    aliased_write,  // scatter to an array that instances may share
+    ghost_local     // write back through a ghost buffer in point processes
+};
+
+std::string to_string(vectorBlocker b);
+
+/// something in the body of an API method that stops the compiler from
+/// vectorizing, or that limits the vectorization of, the loop it is printed in
+struct VectorizationDiagnostic {
+    vectorBlocker kind;
+    Location location;  // of the expression in the .mod file
+    std::string message;
+};
+
+/// Finds the statements in an API method that will block vectorization of
+/// the loop printed by the CPrinter.
+/// The visitor follows the rules of the CPrinter, so it has to be told the
+/// kind of module and whether the optimized printer is used, which changes
+/// how indexed writes of point processes are printed.
+/// Does not descend into the bodies of called procedures, which are printed
+/// as separate functions.
+class VectorizationVisitor : public Visitor {
+public:
+    VectorizationVisitor(bool point_process, bool optimize)
+    :   point_process_(point_process),
+        optimize_(optimize)
+    {}
+
+    void visit(Expression *e)           override {}
+    void visit(APIMethod *e)            override;
+    void visit(UnaryExpression *e)      override;
+    void visit(BinaryExpression *e)     override;
+    void visit(AssignmentExpression *e) override;
+    void visit(PowBinaryExpression *e)  override;
+    void visit(CallExpression *e)       override;
+    void visit(BlockExpression *e)      override;
+    void visit(IfExpression *e)         override;
+
+    std::vector<VectorizationDiagnostic> const& diagnostics() const {
+        return diagnostics_;
+    }
+
+    /// one line for each diagnostic, prefixed with the file name and location
+    std::string print(std::string const& file_name) const;
+
+private:
+    void report(vectorBlocker kind, Location loc, std::string msg) {
+        diagnostics_.push_back({kind, loc, std::move(msg)});
+    }
+
+    bool point_process_;
+    bool optimize_;
+    // indexed writes are generated from the whole block, so they are
+    // reported at the location of the block that the API method comes from
+    Location method_location_;
+    std::vector<VectorizationDiagnostic> diagnostics_;
+    // indexed writes are reported once, at the first assignment
+    std::set<Symbol*> written_;
+};
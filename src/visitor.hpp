@@ -29,6 +29,10 @@ public:
     virtual void visit(FunctionExpression *e)   { visit((Expression*) e); }
     virtual void visit(IfExpression *e)         { visit((Expression*) e); }
     virtual void visit(SolveExpression *e)      { visit((Expression*) e); }
+    virtual void visit(ReactionExpression *e)   { visit((Expression*) e); }
+    virtual void visit(ConserveExpression *e)   { visit((Expression*) e); }
+    virtual void visit(TableExpression *e)      { visit((Expression*) e); }
+    virtual void visit(RandomExpression *e)     { visit((Expression*) e); }
     virtual void visit(DerivativeExpression *e) { visit((Expression*) e); }
     virtual void visit(ProcedureExpression *e)  { visit((Expression*) e); }
     virtual void visit(NetReceiveExpression *e) { visit((ProcedureExpression*) e); }
@@ -42,6 +46,7 @@ public:
     virtual void visit(LogUnaryExpression *e)   { visit((UnaryExpression*) e); }
     virtual void visit(CosUnaryExpression *e)   { visit((UnaryExpression*) e); }
     virtual void visit(SinUnaryExpression *e)   { visit((UnaryExpression*) e); }
+    virtual void visit(TableLookupExpression *e){ visit((UnaryExpression*) e); }
 
     virtual void visit(BinaryExpression *e) = 0;
     virtual void visit(AssignmentExpression *e) { visit((BinaryExpression*) e); }
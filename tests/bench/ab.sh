@@ -0,0 +1,131 @@
+#!/bin/bash
+
+# compare the kernels generated with each optimization variant of modcc with
+# the default kernels, on the same inputs
+#
+#   usage: ab.sh [modfile...]
+#
+# The default benchmark of each mechanism is run on the instances in its node
+# file with kernel capture enabled, and the calls in CALLS are captured. The
+# replay driver of every variant then runs the captured calls, checks that
+# the outputs match the captured outputs within the tolerance of the variant,
+# and times the kernels. Mechanisms that can not be built or run with the
+# default options are skipped. The exit status is non zero if a variant
+# fails to build or does not match.
+#
+# environment variables
+#   MODCC     path of modcc              (default ../../bin/modcc)
+#   CXX       C++ compiler               (default c++)
+#   CXXFLAGS  flags for the drivers      (default -O3 -march=native)
+#   STEPS     time steps of the capture  (default 100)
+#   CALLS     calls that are captured    (default 0,50)
+#   REPS      repetitions of each call   (default 100)
+
+prefix=$(cd $(dirname $0) && pwd)
+modcc=${MODCC:-$prefix/../../bin/modcc}
+cxx=${CXX:-c++}
+cxxflags=${CXXFLAGS:-"-O3 -march=native"}
+steps=${STEPS:-100}
+calls=${CALLS:-0,50}
+reps=${REPS:-100}
+
+# name:relative tolerance:modcc options
+variants="
+    O:1e-12:-O
+    fission:1e-12:-O --max-streams 12
+    threads:1e-12:--threads
+    multi-isa:1e-12:--multi-isa
+    first-touch:1e-12:--first-touch
+    mixed:1e-5:--mixed-precision
+"
+
+modfiles="$@"
+if [ -z "$modfiles" ]; then
+    modfiles=$(ls $prefix/../modfiles/*.mod $prefix/../modfiles/*/*.mod)
+fi
+
+builddir=$(mktemp -d)
+trap "rm -rf $builddir" EXIT
+
+# the time per instance of each kernel, summed over the captured calls
+kernel_times() {
+    awk 'NR>1 && NF>=6 {t[$1] += $4} END {for(k in t) print k, t[k]}' $1 | sort
+}
+
+status=0
+for modfile in $modfiles
+do
+    name=$(grep -ohE '^\s*(SUFFIX|POINT_PROCESS)\s+\w+' $modfile | awk '{print $2}')
+    if [ -z "$name" ]; then
+        continue
+    fi
+    nodefile=$prefix/../nodefiles/$name.nodes
+    if [ ! -f $nodefile ]; then
+        if grep -q POINT_PROCESS $modfile
+        then nodefile=$prefix/../nodefiles/ProbAMPANMDA_EMS.nodes
+        else nodefile=$prefix/../nodefiles/pas.nodes
+        fi
+    fi
+    dir=$builddir/$(basename $modfile .mod)
+    mkdir -p $dir/traces
+
+    echo "== $modfile ($(basename $nodefile))"
+    if ! $modcc $modfile -t bench -o $dir/bench.cpp > $dir/bench.log 2>&1 ||
+       ! $cxx -std=c++11 -pthread $cxxflags -DMODCC_CAPTURE -I$prefix/runtime $dir/bench.cpp -o $dir/bench > $dir/bench.log 2>&1 ||
+       ! $modcc $modfile -t replay -o $dir/default.cpp > $dir/default.log 2>&1 ||
+       ! $cxx -std=c++11 -pthread $cxxflags -I$prefix/runtime $dir/default.cpp -o $dir/default > $dir/default.log 2>&1
+    then
+        echo "skipped: the default kernels can not be built"
+        echo
+        continue
+    fi
+    if ! MODCC_CAPTURE_CALLS=$calls MODCC_CAPTURE_DIR=$dir/traces $dir/bench $nodefile $steps > /dev/null 2>&1
+    then
+        echo "skipped: the default benchmark fails"
+        echo
+        continue
+    fi
+    traces=$(ls $dir/traces/*.trace)
+    if ! $dir/default -r $reps $traces > $dir/default.out
+    then
+        echo "error: the default kernels do not reproduce their own traces"
+        cat $dir/default.out
+        status=1
+        continue
+    fi
+
+    printf "%-12s %-12s %12s %12s %9s %12s\n" variant kernel "default ns" "variant ns" speedup "max error"
+    echo "$variants" | while IFS=: read variant tolerance options
+    do
+        [ -z "$variant" ] && continue
+        variant=$(echo $variant)
+        if ! $modcc $modfile -t replay $options -o $dir/$variant.cpp > $dir/$variant.log 2>&1 ||
+           ! $cxx -std=c++11 -pthread $cxxflags -I$prefix/runtime $dir/$variant.cpp -o $dir/$variant >> $dir/$variant.log 2>&1
+        then
+            printf "%-12s error: unable to build with %s\n" $variant "$options"
+            head -5 $dir/$variant.log
+            echo fail >> $dir/status
+            continue
+        fi
+        # e.g. --mixed-precision has no effect without tolerance annotations
+        if cmp -s $dir/default.cpp $dir/$variant.cpp
+        then
+            printf "%-12s note: %s generates the default code\n" $variant "$options"
+        fi
+        $dir/$variant -r $reps -e $tolerance $traces > $dir/$variant.out || echo fail >> $dir/status
+        error=$(awk 'NR>1 && NF>=6 && $5>e {e=$5} END {print e+0}' $dir/$variant.out)
+        join <(kernel_times $dir/default.out) <(kernel_times $dir/$variant.out) |
+        while read kernel a b
+        do
+            printf "%-12s %-12s %12.3f %12.3f %8.2fx %12.3g\n" $variant $kernel $a $b \
+                $(awk -v a=$a -v b=$b 'BEGIN {print (b>0 ? a/b : 0)}') $error
+        done
+        grep MISMATCH $dir/$variant.out | sed "s/^/$variant: /"
+    done
+    if [ -f $dir/status ]; then
+        status=1
+    fi
+    echo
+done
+
+exit $status
@@ -0,0 +1,56 @@
+#!/bin/bash
+
+# build and run the benchmark of each mechanism with the stand-in runtime
+#
+#   usage: bench.sh [modcc options]
+#
+# e.g. compare the default kernels with the optimized kernels
+#   bench.sh
+#   bench.sh -O --max-streams 12
+#
+# environment variables
+#   MODCC     path of modcc            (default ../../bin/modcc)
+#   CXX       C++ compiler             (default c++)
+#   CXXFLAGS  flags for the benchmarks (default -O3 -march=native)
+#   STEPS     number of time steps     (default 1000)
+#   THREADS   threads used by kernels generated with --threads
+
+prefix=$(cd $(dirname $0) && pwd)
+modcc=${MODCC:-$prefix/../../bin/modcc}
+cxx=${CXX:-c++}
+cxxflags=${CXXFLAGS:-"-O3 -march=native"}
+steps=${STEPS:-1000}
+
+# pairs of mechanism and the node file that gives its instances
+benchmarks="
+    modfiles/KdShu2007.mod:KdShu2007
+    modfiles/conductance/Ih.mod:Ih
+    modfiles/conductance/Im.mod:Im
+    modfiles/conductance/NaTs2_t.mod:NaTs2_t
+    modfiles/conductance/SKv3_1.mod:SKv3_1
+    modfiles/expsyn.mod:ProbAMPANMDA_EMS
+"
+
+builddir=$(mktemp -d)
+trap "rm -rf $builddir" EXIT
+
+for bench in $benchmarks
+do
+    modfile=$prefix/../${bench%%:*}
+    nodefile=$prefix/../nodefiles/${bench##*:}.nodes
+    name=$(basename $modfile .mod)
+
+    if ! $modcc $modfile -t bench -o $builddir/$name.cpp "$@" > $builddir/$name.log
+    then
+        echo "error: unable to generate benchmark for $name, see modcc output:"
+        cat $builddir/$name.log
+        continue
+    fi
+    if ! $cxx -std=c++11 -pthread $cxxflags -I$prefix/runtime $builddir/$name.cpp -o $builddir/$name
+    then
+        echo "error: unable to compile benchmark for $name"
+        continue
+    fi
+    $builddir/$name $nodefile $steps $THREADS
+    echo
+done
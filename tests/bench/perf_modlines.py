@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+
+# aggregate a perf profile of generated mechanisms by line of the .mod files
+#
+# the mechanisms have to be generated with modcc --line-directives and
+# compiled with debug information (-g), then
+#
+#   perf record ./kd_bench ../nodefiles/KdShu2007.nodes 10000
+#   perf script -F ip,srcline | ./perf_modlines.py
+#
+# each sample is attributed to the line in its srcline field, and samples in
+# code that does not come from a .mod file are counted as "other"
+
+import argparse
+import collections
+import re
+import sys
+
+srcline = re.compile(r'^\s*(\S+):(\d+)\s*$')
+
+def read_source(filename, cache={}):
+    if filename not in cache:
+        try:
+            with open(filename) as f:
+                cache[filename] = f.read().splitlines()
+        except IOError:
+            cache[filename] = []
+    return cache[filename]
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='aggregate the output of perf script -F ip,srcline by .mod file line')
+    parser.add_argument('input', nargs='?', type=argparse.FileType('r'), default=sys.stdin,
+                        help='output of perf script (default stdin)')
+    parser.add_argument('--top', type=int, default=0,
+                        help='only print the lines with the most samples')
+    args = parser.parse_args()
+
+    lines = collections.Counter()
+    files = collections.Counter()
+    total = 0
+    for l in args.input:
+        m = srcline.match(l)
+        if not m:
+            continue
+        total += 1
+        filename, line = m.group(1), int(m.group(2))
+        if filename.endswith('.mod'):
+            lines[(filename, line)] += 1
+            files[filename] += 1
+
+    if not total:
+        print('no samples with source lines: record with debug information, '
+              'and use perf script -F ip,srcline')
+        return 1
+
+    def percent(n):
+        return 100.*n/total
+
+    print('%8s %7s  %s' % ('samples', '%', 'location'))
+    top = lines.most_common(args.top if args.top>0 else None)
+    for (filename, line), n in top:
+        source = read_source(filename)
+        text = source[line-1].strip() if line<=len(source) else ''
+        print('%8d %6.2f%%  %s:%d  %s' % (n, percent(n), filename, line, text))
+
+    print()
+    for filename, n in files.most_common():
+        print('%8d %6.2f%%  %s' % (n, percent(n), filename))
+    other = total - sum(files.values())
+    print('%8d %6.2f%%  other' % (other, percent(other)))
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+
+#include "mechanism.hpp"
+
+namespace nest { namespace mc { namespace algorithms {
+
+// the position in nodes of each element of sub, where the elements of sub
+// are contained in nodes and both are sorted
+template <typename Nodes, typename Sub>
+memory::aligned_array<typename std::decay<decltype(std::declval<Sub>()[0])>::type>
+index_into(Nodes const& nodes, Sub const& sub) {
+    using index_type = typename std::decay<decltype(std::declval<Sub>()[0])>::type;
+    memory::aligned_array<index_type> index(sub.size());
+    std::size_t j = 0;
+    for(std::size_t i=0; i<sub.size(); ++i) {
+        while(nodes[j]!=sub[i]) ++j;
+        index[i] = j;
+    }
+    return index;
+}
+
+}}} // namespace nest::mc::algorithms
@@ -0,0 +1,203 @@
+#pragma once
+
+// Minimal stand-in for the parts of the nest::mc runtime that are used by the
+// code generated by modcc, so that mechanisms can be compiled and benchmarked
+// without nest::mc. Only the interface is reproduced: storage is plain aligned
+// host memory, and there is no bounds checking.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// the Intel alignment attribute used by the optimized kernels
+#ifndef __declspec
+#define __declspec(x)
+#endif
+
+namespace memory {
+    struct all_type {};
+    constexpr all_type all{};
+
+    template <typename T>
+    class array_view {
+    public:
+        array_view() = default;
+        array_view(T* p, std::size_t n): data_(p), size_(n) {}
+        template <typename U>
+        array_view(array_view<U> const& o): data_(o.data()), size_(o.size()) {}
+
+        T& operator[](std::size_t i) const {return data_[i];}
+        T* data() const {return data_;}
+        std::size_t size() const {return size_;}
+        T* begin() const {return data_;}
+        T* end() const {return data_+size_;}
+        array_view operator()(std::size_t b, std::size_t e) const {
+            return array_view(data_+b, e-b);
+        }
+        array_view& operator=(T const& v) {
+            std::fill(begin(), end(), v);
+            return *this;
+        }
+        array_view operator()(all_type) const {return *this;}
+    private:
+        T* data_ = nullptr;
+        std::size_t size_ = 0;
+    };
+
+    template <typename T>
+    class aligned_array {
+    public:
+        using view_type = array_view<T>;
+        static constexpr std::size_t alignment() {return 64;}
+
+        aligned_array() = default;
+        explicit aligned_array(std::size_t n): size_(n) {
+            if(n) {
+                void* p = nullptr;
+                if(posix_memalign(&p, alignment(), n*sizeof(T))) throw std::bad_alloc();
+                data_.reset(static_cast<T*>(p));
+            }
+        }
+
+        T* data() {return data_.get();}
+        const T* data() const {return data_.get();}
+        std::size_t size() const {return size_;}
+        T& operator[](std::size_t i) {return data_.get()[i];}
+        T const& operator[](std::size_t i) const {return data_.get()[i];}
+
+        view_type operator()(std::size_t b, std::size_t e) {return view_type(data()+b, e-b);}
+        view_type operator()(all_type) {return view_type(data(), size_);}
+        operator view_type() {return view_type(data(), size_);}
+
+    private:
+        struct deleter { void operator()(T* p) {std::free(p);} };
+        std::unique_ptr<T, deleter> data_;
+        std::size_t size_ = 0;
+    };
+} // namespace memory
+
+namespace nest { namespace mc {
+
+namespace util {
+    inline void pprintf_(std::ostringstream& s, const char* fmt) {
+        s << fmt;
+    }
+    template <typename T, typename... Args>
+    void pprintf_(std::ostringstream& s, const char* fmt, T const& v, Args&&... args) {
+        while(*fmt && *fmt!='%') s << *fmt++;
+        if(!*fmt) return;
+        s << v;
+        pprintf_(s, fmt+1, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    std::string pprintf(const char* fmt, Args&&... args) {
+        std::ostringstream s;
+        pprintf_(s, fmt, std::forward<Args>(args)...);
+        return s.str();
+    }
+} // namespace util
+
+namespace mechanisms {
+
+enum class mechanismKind {point, density};
+enum class ionKind {na, ca, k};
+
+template <typename T, typename I>
+class indexed_view {
+public:
+    using value_type = T;
+    template <typename Index>
+    indexed_view(memory::array_view<T> v, Index const& idx):
+        data_(v), index_(idx.data(), idx.size())
+    {}
+    T& operator[](std::size_t i) const {return data_[index_[i]];}
+    std::size_t size() const {return index_.size();}
+private:
+    memory::array_view<T> data_;
+    memory::array_view<const I> index_;
+};
+
+template <typename T, typename I>
+class ion {
+public:
+    using view_type = memory::array_view<T>;
+    using index_view = memory::array_view<const I>;
+
+    ion(index_view node_index, view_type current, view_type erev,
+        view_type xi, view_type xo):
+        node_index_(node_index), current_(current), erev_(erev), xi_(xi), xo_(xo)
+    {}
+
+    index_view node_index() {return node_index_;}
+    view_type current() {return current_;}
+    view_type reversal_potential() {return erev_;}
+    view_type internal_concentration() {return xi_;}
+    view_type external_concentration() {return xo_;}
+private:
+    index_view node_index_;
+    view_type current_, erev_, xi_, xo_;
+};
+
+template <typename T, typename I>
+class mechanism {
+public:
+    using value_type = T;
+    using size_type = I;
+    using vector_type = memory::aligned_array<T>;
+    using view_type = memory::array_view<T>;
+    using index_type = memory::aligned_array<I>;
+    using index_view = memory::array_view<I>;
+    using const_index_view = memory::array_view<const I>;
+    using indexed_view_type = indexed_view<T, I>;
+    using ion_type = ion<T, I>;
+
+    mechanism(view_type vec_v, view_type vec_i, const_index_view node_index):
+        vec_v_(vec_v), vec_i_(vec_i), node_index_(node_index)
+    {}
+
+    std::size_t size() const {return node_index_.size();}
+
+    // nest::mc sets the area of the nodes when the cell is built, here it is
+    // set by the benchmark driver before the first kernel is called
+    void set_areas(view_type area) {vec_area_ = area;}
+
+    // the conductance of the mechanisms, the derivative of the current with
+    // respect to v, is accumulated in nrn_current alongside the current
+    void set_conductances(view_type g) {vec_g_ = g;}
+
+    virtual std::string name() const = 0;
+    virtual std::size_t memory() const = 0;
+    virtual void set_params(value_type t, value_type dt) = 0;
+    virtual void nrn_init() = 0;
+    virtual void nrn_state() = 0;
+    virtual void nrn_current() = 0;
+    virtual bool uses_ion(ionKind) const = 0;
+    virtual void set_ion(ionKind k, ion_type& i) = 0;
+    virtual mechanismKind kind() const = 0;
+    virtual void net_receive(int, value_type) {}
+    virtual ~mechanism() = default;
+
+    view_type vec_v_;
+    view_type vec_i_;
+    view_type vec_g_;
+    view_type vec_area_;
+    const_index_view node_index_;
+};
+
+template <typename T, typename I>
+using mechanism_ptr = std::unique_ptr<mechanism<T, I>>;
+
+template <typename M, typename... Args>
+mechanism_ptr<typename M::value_type, typename M::size_type>
+make_mechanism(Args&&... args) {
+    return mechanism_ptr<typename M::value_type, typename M::size_type>(
+        new M(std::forward<Args>(args)...));
+}
+
+}}} // namespace nest::mc::mechanisms
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "mechanism.hpp"
+
+namespace nest { namespace mc { namespace mechanisms {
+
+using parameter_list = std::map<std::string, double>;
+
+template <typename T, typename I>
+struct mechanism_helper {
+    using index_view = memory::array_view<const I>;
+    using view_type = memory::array_view<T>;
+    using mechanism_ptr_type = mechanism_ptr<T, I>;
+
+    virtual std::string name() const = 0;
+    virtual mechanism_ptr<T, I> new_mechanism(view_type, view_type, index_view) const = 0;
+    virtual void set_parameters(mechanism_ptr_type&, parameter_list const&) const = 0;
+    virtual ~mechanism_helper() = default;
+};
+
+}}} // namespace nest::mc::mechanisms
@@ -0,0 +1,54 @@
+#include <cmath>
+#include <vector>
+
+#include "test.hpp"
+
+// ExpSyn generated by modcc from tests/modfiles/expsyn.mod
+#include "ExpSyn.hpp"
+
+using namespace nest::mc::mechanisms;
+
+// advance(i, k) with the decay factor raised to the power k gives the same
+// states as k calls of nrn_state
+TEST(Advance, nrn_state) {
+    using mechanism_type = ExpSyn::mechanism_ExpSyn<double, int>;
+    using view_type = mechanism_type::view_type;
+    using index_view = mechanism_type::const_index_view;
+
+    std::vector<int> node_index = {0, 1, 2, 3};
+    std::vector<double> vec_v(4, -65.), vec_i(4, 0.), vec_area(4, 100.);
+    auto make_mechanism = [&]() {
+        mechanism_type m(
+            view_type(vec_v.data(), vec_v.size()),
+            view_type(vec_i.data(), vec_i.size()),
+            index_view(node_index.data(), node_index.size()));
+        m.set_areas(view_type(vec_area.data(), vec_area.size()));
+        m.set_params(0, 0.025);
+        for(auto i=0u; i<node_index.size(); ++i) {
+            m.tau[i] = 0.1 + i;
+        }
+        m.nrn_init();
+        for(auto i=0u; i<node_index.size(); ++i) {
+            m.g[i] = 1.5 + i;
+        }
+        return m;
+    };
+
+    for(auto k: {0, 1, 3, 17}) {
+        auto advanced = make_mechanism();
+        for(auto i=0u; i<node_index.size(); ++i) {
+            advanced.advance(i, k);
+        }
+
+        auto stepped = make_mechanism();
+        for(auto step=0; step<k; ++step) {
+            stepped.nrn_state();
+        }
+
+        for(auto i=0u; i<node_index.size(); ++i) {
+            auto expected = stepped.g[i];
+            EXPECT_NEAR(expected, advanced.g[i], 1e-12*std::fabs(expected))
+                << "k " << k << " instance " << i;
+        }
+    }
+}
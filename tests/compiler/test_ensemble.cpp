@@ -0,0 +1,89 @@
+#include <vector>
+
+#include "test.hpp"
+
+// ExpSyn generated by modcc from tests/modfiles/expsyn.mod, and the same
+// mechanism with an ensemble of 4 lanes
+#include "ExpSyn.hpp"
+#include "ExpSynEnsemble.hpp"
+
+using namespace nest::mc::mechanisms;
+
+// every lane of an ensemble gives the same currents and conductances as a
+// mechanism with the parameters of the lane
+TEST(Ensemble, point_process) {
+    using single_type = ExpSyn::mechanism_ExpSyn<double, int>;
+    using ensemble_type = ExpSynEnsemble::mechanism_ExpSynEnsemble<double, int>;
+    using view_type = single_type::view_type;
+    using index_view = single_type::const_index_view;
+    constexpr int K = ensemble_type::ensemble_size;
+
+    // two instances on node 1, and nodes with different areas. The area has
+    // one value per node, and is padded so that an area read with a lane
+    // offset is wrong rather than out of bounds
+    std::vector<int> node_index = {0, 1, 1, 3};
+    int num_nodes = 4;
+    std::vector<double> area(K*num_nodes, 1.);
+    for(auto n=0; n<num_nodes; ++n) {
+        area[n] = 100.*(n+1);
+    }
+
+    std::vector<double> v(K*num_nodes), i(K*num_nodes, 0.), g(K*num_nodes, 0.);
+    for(auto n=0; n<num_nodes; ++n) {
+        for(auto k=0; k<K; ++k) {
+            v[K*n+k] = -65. + 5.*k + n;
+        }
+    }
+    ensemble_type ensemble(
+        view_type(v.data(), v.size()),
+        view_type(i.data(), i.size()),
+        index_view(node_index.data(), node_index.size()));
+    ensemble.set_areas(view_type(area.data(), area.size()));
+    ensemble.set_conductances(view_type(g.data(), g.size()));
+    ensemble.set_params(0, 0.025);
+    for(auto j=0u; j<node_index.size(); ++j) {
+        for(auto k=0; k<K; ++k) {
+            ensemble.tau[K*j+k] = 1. + k;
+            ensemble.e[K*j+k] = -10.*k;
+        }
+    }
+    ensemble.nrn_init();
+    ensemble.net_receive(1, 0.5);
+    ensemble.net_receive(2, 0.25);
+    ensemble.net_receive(3, 1.);
+    for(auto step=0; step<10; ++step) {
+        ensemble.nrn_state();
+    }
+    ensemble.nrn_current();
+
+    for(auto k=0; k<K; ++k) {
+        std::vector<double> vk(num_nodes), ik(num_nodes, 0.), gk(num_nodes, 0.);
+        for(auto n=0; n<num_nodes; ++n) {
+            vk[n] = v[K*n+k];
+        }
+        single_type single(
+            view_type(vk.data(), vk.size()),
+            view_type(ik.data(), ik.size()),
+            index_view(node_index.data(), node_index.size()));
+        single.set_areas(view_type(area.data(), num_nodes));
+        single.set_conductances(view_type(gk.data(), gk.size()));
+        single.set_params(0, 0.025);
+        for(auto j=0u; j<node_index.size(); ++j) {
+            single.tau[j] = 1. + k;
+            single.e[j] = -10.*k;
+        }
+        single.nrn_init();
+        single.net_receive(1, 0.5);
+        single.net_receive(2, 0.25);
+        single.net_receive(3, 1.);
+        for(auto step=0; step<10; ++step) {
+            single.nrn_state();
+        }
+        single.nrn_current();
+
+        for(auto n=0; n<num_nodes; ++n) {
+            EXPECT_DOUBLE_EQ(ik[n], i[K*n+k]) << "lane " << k << " node " << n;
+            EXPECT_DOUBLE_EQ(gk[n], g[K*n+k]) << "lane " << k << " node " << n;
+        }
+    }
+}
@@ -0,0 +1,128 @@
+#include <vector>
+
+#include "test.hpp"
+
+// mechanisms generated by modcc from tests/modfiles/events
+#include "events_args.hpp"
+#include "events_locals.hpp"
+#include "events_random.hpp"
+
+using namespace nest::mc::mechanisms;
+
+// the instances of a mechanism on the nodes of a small cell, with one batch
+// of events that targets some instances more than once
+template <typename Mechanism>
+struct event_fixture {
+    using value_type = typename Mechanism::value_type;
+    using view_type = typename Mechanism::view_type;
+    using index_view = typename Mechanism::const_index_view;
+
+    std::vector<int> node_index = {0, 1, 1, 3};
+    std::vector<value_type> vec_v = {-65, -60, -60, -55};
+    std::vector<value_type> vec_i = std::vector<value_type>(4, 0.);
+    std::vector<value_type> vec_area = std::vector<value_type>(4, 100.);
+
+    std::vector<int> target = {0, 1, 1, 3, 3, 3};
+    std::vector<value_type> weight = {0.1, 0.2, 0.3, 0.4, 0.5, 0.6};
+
+    Mechanism make_mechanism() {
+        Mechanism m(
+            view_type(vec_v.data(), vec_v.size()),
+            view_type(vec_i.data(), vec_i.size()),
+            index_view(node_index.data(), node_index.size()));
+        m.set_areas(view_type(vec_area.data(), vec_area.size()));
+        m.set_params(0, 0.025);
+        m.nrn_init();
+        return m;
+    }
+};
+
+// a batch of events has the same effect as calls of net_receive for the
+// events in the order of the batch
+TEST(Events, locals) {
+    using mechanism_type = events_locals::mechanism_events_locals<double, int>;
+    event_fixture<mechanism_type> f;
+
+    auto batch = f.make_mechanism();
+    mechanism_type::event_batch events;
+    events.target = f.target.data();
+    events.weight = f.weight.data();
+    events.size = f.target.size();
+    batch.deliver_events(events);
+
+    auto calls = f.make_mechanism();
+    for(auto j=0u; j<f.target.size(); ++j) {
+        calls.net_receive(f.target[j], f.weight[j]);
+    }
+
+    for(auto i=0u; i<f.node_index.size(); ++i) {
+        EXPECT_DOUBLE_EQ(calls.g[i], batch.g[i]);
+        EXPECT_DOUBLE_EQ(calls.h[i], batch.h[i]);
+    }
+    // the instance that receives no events is unchanged
+    EXPECT_EQ(batch.g[2], 0.);
+    EXPECT_NE(batch.h[3], 1.);
+}
+
+TEST(Events, arguments) {
+    using mechanism_type = events_args::mechanism_events_args<double, int>;
+    event_fixture<mechanism_type> f;
+    std::vector<double> scale  = {0.5, 0.9, 0.8, 0.7, 0.6, 0.5};
+    std::vector<double> offset = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+
+    auto batch = f.make_mechanism();
+    mechanism_type::event_batch events;
+    events.target = f.target.data();
+    events.weight = f.weight.data();
+    events.scale = scale.data();
+    events.offset = offset.data();
+    events.size = f.target.size();
+    batch.deliver_events(events);
+
+    auto calls = f.make_mechanism();
+    for(auto j=0u; j<f.target.size(); ++j) {
+        calls.net_receive(f.target[j], f.weight[j], scale[j], offset[j]);
+    }
+
+    for(auto i=0u; i<f.node_index.size(); ++i) {
+        EXPECT_DOUBLE_EQ(calls.g[i], batch.g[i]);
+        EXPECT_DOUBLE_EQ(calls.h[i], batch.h[i]);
+    }
+    EXPECT_EQ(batch.g[2], 0.);
+    EXPECT_NE(batch.h[3], 0.);
+}
+
+// the random numbers drawn by an event depend on the events of its instance,
+// and not on the events of other instances or the order of delivery
+TEST(Events, random) {
+    using mechanism_type = events_random::mechanism_events_random<double, int>;
+    event_fixture<mechanism_type> f;
+
+    auto batch = f.make_mechanism();
+    mechanism_type::event_batch events;
+    events.target = f.target.data();
+    events.weight = f.weight.data();
+    events.size = f.target.size();
+    batch.deliver_events(events);
+
+    auto calls = f.make_mechanism();
+    for(auto j=0u; j<f.target.size(); ++j) {
+        calls.net_receive(f.target[j], f.weight[j]);
+    }
+    for(auto i=0u; i<f.node_index.size(); ++i) {
+        EXPECT_EQ(calls.g[i], batch.g[i]);
+    }
+
+    auto interleaved = f.make_mechanism();
+    auto single = f.make_mechanism();
+    for(auto j=0; j<20; ++j) {
+        interleaved.net_receive(0, 1.);
+        interleaved.net_receive(3, 1.);
+        interleaved.net_receive(0, 1.);
+        single.net_receive(3, 1.);
+    }
+    EXPECT_EQ(single.n[3], 20.);
+    EXPECT_NE(single.g[3], 0.);
+    EXPECT_EQ(interleaved.g[3], single.g[3]);
+    EXPECT_NE(interleaved.g[0], interleaved.g[3]);
+}
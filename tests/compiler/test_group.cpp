@@ -0,0 +1,94 @@
+#include <vector>
+
+#include "test.hpp"
+
+// the group chan of hh_table and KdShu2007, generated by modcc from
+// tests/modfiles/hh_table.mod and tests/modfiles/KdShu2007.mod with
+// --group chan. The header also has the member mechanisms, with their own
+// kernels.
+#include "chan.hpp"
+
+namespace mechanisms = nest::mc::mechanisms;
+
+// the arrays of a cell with one instance of the mechanisms on every node
+struct group_fixture {
+    using view_type = memory::array_view<double>;
+    using index_view = memory::array_view<const int>;
+    using ion_type = mechanisms::ion<double, int>;
+
+    struct ion_arrays {
+        ion_arrays(double e, double i, double o):
+            current(4, 0.), erev(4, e), xi(4, i), xo(4, o)
+        {}
+        std::vector<double> current, erev, xi, xo;
+        ion_type make(std::vector<int>& index) {
+            return ion_type(
+                index_view(index.data(), 4), view_type(current.data(), 4),
+                view_type(erev.data(), 4), view_type(xi.data(), 4), view_type(xo.data(), 4));
+        }
+    };
+
+    std::vector<int> node_index = {0, 1, 2, 3};
+    std::vector<double> vec_v = {-80, -65, -50, -20};
+    std::vector<double> vec_i = std::vector<double>(4, 0.);
+    std::vector<double> vec_g = std::vector<double>(4, 0.);
+    std::vector<double> vec_area = std::vector<double>(4, 100.);
+    ion_arrays na = ion_arrays(50., 10., 140.);
+    ion_arrays k  = ion_arrays(-77., 54.4, 2.5);
+    ion_type ion_na = na.make(node_index);
+    ion_type ion_k = k.make(node_index);
+
+    view_type v() {return view_type(vec_v.data(), 4);}
+    view_type i() {return view_type(vec_i.data(), 4);}
+    index_view index() {return index_view(node_index.data(), 4);}
+
+    template <typename Mechanism>
+    void setup(Mechanism& m) {
+        m.set_areas(view_type(vec_area.data(), 4));
+        m.set_conductances(view_type(vec_g.data(), 4));
+        if(m.uses_ion(mechanisms::ionKind::na)) m.set_ion(mechanisms::ionKind::na, ion_na);
+        if(m.uses_ion(mechanisms::ionKind::k)) m.set_ion(mechanisms::ionKind::k, ion_k);
+        m.set_params(0, 0.025);
+        m.nrn_init();
+    }
+};
+
+// the fused kernels of a group give the same currents, conductances and
+// states as the kernels of the members called one after the other
+TEST(Group, fused) {
+    group_fixture fused, separate;
+
+    mechanisms::chan::mechanism_chan<double, int> group(fused.v(), fused.i(), fused.index());
+    fused.setup(group);
+
+    mechanisms::hh_table::mechanism_hh_table<double, int> hh(
+        separate.v(), separate.i(), separate.index());
+    mechanisms::KdShu2007::mechanism_KdShu2007<double, int> kd(
+        separate.v(), separate.i(), separate.index());
+    separate.setup(hh);
+    separate.setup(kd);
+
+    for(auto step=0; step<5; ++step) {
+        group.nrn_current();
+        group.nrn_state();
+        hh.nrn_current();
+        kd.nrn_current();
+        hh.nrn_state();
+        kd.nrn_state();
+    }
+
+    for(auto n=0; n<4; ++n) {
+        EXPECT_DOUBLE_EQ(separate.vec_i[n], fused.vec_i[n]);
+        EXPECT_DOUBLE_EQ(separate.vec_g[n], fused.vec_g[n]);
+        EXPECT_DOUBLE_EQ(separate.na.current[n], fused.na.current[n]);
+        EXPECT_DOUBLE_EQ(separate.k.current[n], fused.k.current[n]);
+        EXPECT_DOUBLE_EQ(hh.m[n], group.hh_table_.m[n]);
+        EXPECT_DOUBLE_EQ(hh.h[n], group.hh_table_.h[n]);
+        EXPECT_DOUBLE_EQ(hh.n[n], group.hh_table_.n[n]);
+        EXPECT_DOUBLE_EQ(kd.m[n], group.KdShu2007_.m[n]);
+        EXPECT_DOUBLE_EQ(kd.h[n], group.KdShu2007_.h[n]);
+    }
+    EXPECT_NE(fused.na.current[3], 0.);
+    EXPECT_NE(fused.k.current[3], 0.);
+    EXPECT_NE(fused.vec_g[0], 0.);
+}
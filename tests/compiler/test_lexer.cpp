@@ -188,6 +188,36 @@ TEST(Lexer, comparison_operators) {
 }
 
 // test braces
+// the symbols of reactions in KINETIC blocks
+TEST(Lexer, reactions) {
+    char string[] = "~ A <-> B a<-b";
+    PRINT_LEX_STRING
+    Lexer lexer(string, string+sizeof(string));
+
+    auto t1 = lexer.parse();
+    EXPECT_EQ(t1.type, tok::tilde);
+    auto t2 = lexer.parse();
+    EXPECT_EQ(t2.type, tok::identifier);
+    auto t3 = lexer.parse();
+    EXPECT_EQ(t3.type, tok::arrow);
+    EXPECT_EQ(t3.spelling, "<->");
+    auto t4 = lexer.parse();
+    EXPECT_EQ(t4.type, tok::identifier);
+
+    // a comparison with a negative value is not a reaction
+    auto t5 = lexer.parse();
+    EXPECT_EQ(t5.type, tok::identifier);
+    auto t6 = lexer.parse();
+    EXPECT_EQ(t6.type, tok::lt);
+    auto t7 = lexer.parse();
+    EXPECT_EQ(t7.type, tok::minus);
+    auto t8 = lexer.parse();
+    EXPECT_EQ(t8.type, tok::identifier);
+
+    auto t9 = lexer.parse();
+    EXPECT_EQ(t9.type, tok::eof);
+}
+
 TEST(Lexer, braces) {
     char string[] = "foo}";
     PRINT_LEX_STRING
@@ -261,4 +291,25 @@ TEST(Lexer, numbers) {
     EXPECT_EQ(t8.type, tok::eof);
 }
 
+TEST(Lexer, scientific_numbers) {
+    char string[] = "1e3 2.5e-4 3E+2";
+    PRINT_LEX_STRING
+    Lexer lexer(string, string+sizeof(string));
+
+    auto t1 = lexer.parse();
+    EXPECT_EQ(t1.type, tok::number);
+    EXPECT_EQ(std::stod(t1.spelling), 1e3);
+
+    auto t2 = lexer.parse();
+    EXPECT_EQ(t2.type, tok::number);
+    EXPECT_EQ(std::stod(t2.spelling), 2.5e-4);
+
+    auto t3 = lexer.parse();
+    EXPECT_EQ(t3.type, tok::number);
+    EXPECT_EQ(std::stod(t3.spelling), 3e2);
+
+    auto t4 = lexer.parse();
+    EXPECT_EQ(t4.type, tok::eof);
+}
+
 
@@ -0,0 +1,82 @@
+#include <cmath>
+#include <type_traits>
+#include <vector>
+
+#include "test.hpp"
+
+// hh_table from tests/modfiles/hh_table.mod, renamed hh_double, and renamed
+// hh_single and generated with --mixed-precision, which stores the gates m,
+// h and n, annotated with a tolerance of 1e-5, in single precision
+#include "hh_double.hpp"
+#include "hh_single.hpp"
+
+namespace mechanisms = nest::mc::mechanisms;
+
+// the instances of a mechanism on the nodes of a small cell, with the sodium
+// and potassium ions on every node
+template <typename Mechanism>
+struct hh_fixture {
+    using view_type = memory::array_view<double>;
+    using index_view = memory::array_view<const int>;
+    using ion_type = mechanisms::ion<double, int>;
+
+    std::vector<int> node_index = {0, 1, 2, 3};
+    std::vector<double> vec_v = {-80, -65, -50, -20};
+    std::vector<double> vec_i = std::vector<double>(4, 0.);
+    std::vector<double> vec_g = std::vector<double>(4, 0.);
+    std::vector<double> vec_area = std::vector<double>(4, 100.);
+    std::vector<double> ina = std::vector<double>(4, 0.), ena = std::vector<double>(4, 50.);
+    std::vector<double> ik = std::vector<double>(4, 0.), ek = std::vector<double>(4, -77.);
+    std::vector<double> xi = std::vector<double>(4, 10.), xo = std::vector<double>(4, 140.);
+    ion_type ion_na{index(), view(ina), view(ena), view(xi), view(xo)};
+    ion_type ion_k{index(), view(ik), view(ek), view(xi), view(xo)};
+    Mechanism mech{view(vec_v), view(vec_i), index()};
+
+    hh_fixture() {
+        mech.set_areas(view(vec_area));
+        mech.set_conductances(view(vec_g));
+        mech.set_ion(mechanisms::ionKind::na, ion_na);
+        mech.set_ion(mechanisms::ionKind::k, ion_k);
+        mech.set_params(0, 0.025);
+        mech.nrn_init();
+    }
+
+    static view_type view(std::vector<double>& x) {return view_type(x.data(), x.size());}
+    index_view index() {return index_view(node_index.data(), node_index.size());}
+
+    void step() {
+        mech.nrn_current();
+        mech.nrn_state();
+    }
+};
+
+// the gates are stored as float, and the currents and states match those of
+// double precision storage within the tolerance of the gates
+TEST(MixedPrecision, hh_table) {
+    hh_fixture<mechanisms::hh_single::mechanism_hh_single<double, int>> single;
+    hh_fixture<mechanisms::hh_double::mechanism_hh_double<double, int>> reference;
+
+    EXPECT_TRUE((std::is_same<decltype(single.mech.m), float*>::value));
+    EXPECT_TRUE((std::is_same<decltype(single.mech.h), float*>::value));
+    EXPECT_TRUE((std::is_same<decltype(single.mech.n), float*>::value));
+    EXPECT_EQ(single.mech.data_single_.size()%3, 0u);
+    EXPECT_FALSE((std::is_same<decltype(reference.mech.m), float*>::value));
+
+    auto near = [](double expected, double value) {
+        return std::fabs(value-expected) <= 1e-5*std::fabs(expected);
+    };
+    for(auto step=0; step<20; ++step) {
+        single.step();
+        reference.step();
+        for(auto i=0; i<4; ++i) {
+            EXPECT_TRUE(near(reference.mech.m[i], single.mech.m[i])) << "step " << step;
+            EXPECT_TRUE(near(reference.mech.h[i], single.mech.h[i])) << "step " << step;
+            EXPECT_TRUE(near(reference.mech.n[i], single.mech.n[i])) << "step " << step;
+            EXPECT_TRUE(near(reference.vec_i[i], single.vec_i[i])) << "step " << step;
+            EXPECT_TRUE(near(reference.ina[i], single.ina[i])) << "step " << step;
+            EXPECT_TRUE(near(reference.ik[i], single.ik[i])) << "step " << step;
+        }
+    }
+    // the values are rounded to single precision
+    EXPECT_NE(reference.mech.m[1], single.mech.m[1]);
+}
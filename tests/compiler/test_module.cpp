@@ -1,5 +1,11 @@
+#include <set>
+
 #include "test.hpp"
+#include "../src/analysis.hpp"
+#include "../src/cprinter.hpp"
+#include "../src/groupprinter.hpp"
 #include "../src/module.hpp"
+#include "../src/parser.hpp"
 
 TEST(Module, open) {
     Module m("./modfiles/test.mod");
@@ -15,3 +21,726 @@ TEST(Module, open) {
     }
 }
 
+
+TEST(Module, analysis_json) {
+    std::string source =
+        "NEURON {\n"
+        "    SUFFIX leak\n"
+        "    NONSPECIFIC_CURRENT il\n"
+        "    RANGE gbar\n"
+        "}\n"
+        "PARAMETER {\n"
+        "    gbar = 0.001\n"
+        "    el = -70\n"
+        "}\n"
+        "ASSIGNED {\n"
+        "    v\n"
+        "}\n"
+        "STATE {\n"
+        "    s\n"
+        "}\n"
+        "INITIAL {\n"
+        "    s = 0\n"
+        "}\n"
+        "BREAKPOINT {\n"
+        "    il = gbar*(v - el)\n"
+        "}\n";
+    Module m(std::vector<char>(source.begin(), source.end()));
+    Parser p(m, false);
+    EXPECT_TRUE(p.parse());
+    EXPECT_TRUE(m.semantic());
+
+    auto json = analysis_json({&m}, MachineModel(), *CostModel::find("haswell"), false);
+
+    auto contains = [&json](std::string const& s) {
+        return json.find(s) != std::string::npos;
+    };
+    EXPECT_TRUE(contains("\"name\": \"leak\""));
+    EXPECT_TRUE(contains("\"kind\": \"density\""));
+    EXPECT_TRUE(contains("\"states\": 1"));
+    EXPECT_TRUE(contains("\"nrn_current\": {"));
+    EXPECT_TRUE(contains("\"nrn_init\": {"));
+    EXPECT_TRUE(contains("\"stores\": {\"direct\": [\"s\"], \"indexed\": []}"));
+}
+
+// the analysis of a file names it without its directory, so that reports made
+// in different checkouts can be compared
+TEST(Module, analysis_json_file) {
+    Module m(MODFILE_DIR "/expsyn.mod");
+    ASSERT_NE(m.buffer().size(), 0u);
+    Parser p(m, false);
+    EXPECT_TRUE(p.parse());
+    EXPECT_TRUE(m.semantic());
+
+    auto json = analysis_json({&m}, MachineModel(), *CostModel::find("haswell"), false);
+    EXPECT_NE(json.find("\"file\": \"expsyn.mod\","), std::string::npos);
+    EXPECT_EQ(json.find(MODFILE_DIR), std::string::npos);
+}
+
+// a KINETIC block is lowered to a linear solve in nrn_state
+TEST(Module, kinetic) {
+    auto source = [](std::string const& method, std::string const& reactions) {
+        return
+            "NEURON {\n"
+            "    SUFFIX kin\n"
+            "}\n"
+            "ASSIGNED {\n"
+            "    v\n"
+            "}\n"
+            "STATE {\n"
+            "    C O I\n"
+            "}\n"
+            "INITIAL {\n"
+            "    C = 1\n"
+            "}\n"
+            "BREAKPOINT {\n"
+            "    SOLVE scheme METHOD " + method + "\n"
+            "}\n"
+            "KINETIC scheme {\n"
+            + reactions +
+            "}\n"
+            "FUNCTION rate(v) {\n"
+            "    rate = exp(v/10)\n"
+            "}\n";
+    };
+    auto compile = [](std::string const& s) {
+        Module m(std::vector<char>(s.begin(), s.end()));
+        Parser p(m, false);
+        return p.parse() && m.semantic();
+    };
+
+    {
+        auto s = source("sparse",
+            "    ~ C <-> O (rate(v), 2)\n"
+            "    ~ O <-> I (1, rate(-v))\n"
+            "    CONSERVE C + O + I = 1\n");
+        Module m(std::vector<char>(s.begin(), s.end()));
+        Parser p(m, false);
+        EXPECT_TRUE(p.parse());
+        ASSERT_TRUE(m.semantic());
+
+        // all three states are updated from the solution of the system
+        std::set<std::string> updated;
+        auto state = m.symbols().find("nrn_state")->second->is_api_method();
+        for(auto& e : *state->body()) {
+            if(auto a = e->is_assignment()) {
+                if(auto id = a->lhs()->is_identifier()) {
+                    updated.insert(id->spelling());
+                }
+            }
+        }
+        EXPECT_TRUE(updated.count("C"));
+        EXPECT_TRUE(updated.count("O"));
+        EXPECT_TRUE(updated.count("I"));
+    }
+
+    // reactions must be solved with METHOD sparse, be first order, and
+    // only have states
+    EXPECT_FALSE(compile(source("cnexp", "    ~ C <-> O (1, 2)\n")));
+    EXPECT_FALSE(compile(source("sparse", "    ~ C + O <-> I (1, 2)\n")));
+    EXPECT_FALSE(compile(source("sparse", "    ~ C <-> v (1, 2)\n")));
+    EXPECT_FALSE(compile(source("sparse", "    O' = -O\n")));
+}
+
+// nonlinear ODEs are solved with Newton's method
+TEST(Module, derivimplicit) {
+    auto source = [](std::string const& method, std::string const& odes) {
+        return
+            "NEURON {\n"
+            "    SUFFIX pump\n"
+            "    RANGE kd\n"
+            "}\n"
+            "PARAMETER {\n"
+            "    kd = 0.001\n"
+            "}\n"
+            "STATE {\n"
+            "    c b\n"
+            "}\n"
+            "INITIAL {\n"
+            "    c = 0\n"
+            "}\n"
+            "BREAKPOINT {\n"
+            "    SOLVE states METHOD " + method + "\n"
+            "}\n"
+            "DERIVATIVE states {\n"
+            + odes +
+            "}\n";
+    };
+    auto compile = [](std::string const& s) {
+        Module m(std::vector<char>(s.begin(), s.end()));
+        Parser p(m, false);
+        return p.parse() && m.semantic();
+    };
+
+    auto nonlinear =
+        "    LOCAL p\n"
+        "    p = c/(c + kd)\n"
+        "    c' = -p + b*c\n"
+        "    b' = -b*b\n";
+
+    EXPECT_FALSE(compile(source("cnexp", nonlinear)));
+    EXPECT_TRUE(compile(source("derivimplicit", nonlinear)));
+    EXPECT_TRUE(compile(source("sparse", nonlinear)));
+
+    // the states can't be assigned, and only assignments can depend on them
+    EXPECT_FALSE(compile(source("derivimplicit", "    c = 1\n    c' = -c\n    b' = -b\n")));
+    EXPECT_FALSE(compile(source("derivimplicit",
+        "    LOCAL p\n"
+        "    p = 1\n"
+        "    if(c > kd) {\n"
+        "        p = 2\n"
+        "    }\n"
+        "    c' = -p*c\n"
+        "    b' = -b\n")));
+}
+
+// a PROCEDURE and a FUNCTION with TABLE statements are replaced by lookups,
+// and their statements are moved to procedures that build the tables
+TEST(Module, table) {
+    auto compile = [] (std::string const& rates, bool use_tables=true) {
+        std::string source =
+            "NEURON {\n"
+            "    SUFFIX tab\n"
+            "    RANGE minf, gbar\n"
+            "}\n"
+            "PARAMETER {\n"
+            "    celsius = 6.3\n"
+            "    gbar = 0.1\n"
+            "}\n"
+            "ASSIGNED {\n"
+            "    minf\n"
+            "    mtau\n"
+            "}\n"
+            "INITIAL {\n"
+            "    rates(v)\n"
+            "    mtau = tau(v)\n"
+            "}\n"
+            "BREAKPOINT {\n"
+            "}\n"
+            "FUNCTION tau(v) {\n"
+            "    TABLE FROM -100 TO 100 WITH 200\n"
+            "    tau = 1 + exp(-v*v/400)\n"
+            "}\n"
+            + rates;
+        auto m = make_unique<Module>(std::vector<char>(source.begin(), source.end()));
+        m->use_tables(use_tables);
+        Parser p(*m, false);
+        EXPECT_TRUE(p.parse());
+        m->semantic();
+        return m;
+    };
+    auto lookups = [] (ProcedureExpression* proc) {
+        std::vector<std::string> names;
+        for(auto& e : *proc->body()) {
+            auto a = e->is_assignment();
+            if(a && a->rhs()->is_unary() && a->rhs()->is_unary()->op()==tok::table) {
+                names.push_back(static_cast<TableLookupExpression*>(a->rhs())->name());
+            }
+        }
+        return names;
+    };
+
+    {
+        auto m = compile(
+            "PROCEDURE rates(v) {\n"
+            "    TABLE minf FROM -100 TO 100 WITH 400\n"
+            "    LOCAL q10\n"
+            "    q10 = 3^((celsius - 6.3)/10)\n"
+            "    minf = q10/(1 + exp(-(v + 40)/7))\n"
+            "}\n");
+        ASSERT_FALSE(m->has_error()) << m->error_string();
+        EXPECT_EQ(m->error_string().find("TABLE"), std::string::npos);
+
+        auto& symbols = m->symbols();
+        auto rates = symbols.find("rates")->second->is_procedure();
+        EXPECT_EQ(lookups(rates), std::vector<std::string>{"rates_minf_lookup_"});
+
+        // the scalars that are read are dependencies of the table
+        auto builder = symbols.find("rates_table_")->second->is_procedure();
+        ASSERT_NE(builder, nullptr);
+        EXPECT_EQ(builder->kind(), procedureKind::table);
+        EXPECT_EQ(builder->table()->depends(), std::vector<std::string>{"celsius"});
+        EXPECT_EQ(builder->table()->n(), 400);
+
+        // the function is inlined as a lookup
+        auto init = symbols.find("nrn_init")->second->is_api_method();
+        EXPECT_EQ(lookups(init), std::vector<std::string>{"tau_lookup_"});
+        EXPECT_NE(symbols.find("tau_table_"), symbols.end());
+    }
+
+    // without tables the functions are evaluated directly
+    {
+        auto m = compile(
+            "PROCEDURE rates(v) {\n"
+            "    TABLE minf FROM -100 TO 100 WITH 400\n"
+            "    minf = 1/(1 + exp(-(v + 40)/7))\n"
+            "}\n", false);
+        ASSERT_FALSE(m->has_error()) << m->error_string();
+        auto& symbols = m->symbols();
+        EXPECT_TRUE(lookups(symbols.find("rates")->second->is_procedure()).empty());
+        EXPECT_EQ(symbols.find("rates_table_"), symbols.end());
+        EXPECT_EQ(symbols.find("tau_table_"), symbols.end());
+    }
+
+    // a coarse table is accurate to less than 1e-3
+    {
+        auto m = compile(
+            "PROCEDURE rates(v) {\n"
+            "    TABLE minf FROM -100 TO 100 WITH 20\n"
+            "    minf = 1/(1 + exp(-(v + 40)/7))\n"
+            "}\n");
+        EXPECT_FALSE(m->has_error()) << m->error_string();
+        EXPECT_NE(m->error_string().find("WITH"), std::string::npos);
+    }
+
+    // tables can't depend on RANGE variables, or assign other variables
+    for(auto rates : {
+            "PROCEDURE rates(v) {\n"
+            "    TABLE minf FROM -100 TO 100 WITH 200\n"
+            "    minf = gbar/(1 + exp(-(v + 40)/7))\n"
+            "}\n",
+            "PROCEDURE rates(v) {\n"
+            "    TABLE minf FROM -100 TO 100 WITH 200\n"
+            "    minf = 1/(1 + exp(-(v + 40)/7))\n"
+            "    mtau = 1\n"
+            "}\n",
+            "PROCEDURE rates(v) {\n"
+            "    TABLE minf DEPEND gbar FROM -100 TO 100 WITH 200\n"
+            "    minf = 1/(1 + exp(-(v + 40)/7))\n"
+            "}\n"})
+    {
+        auto m = compile(rates);
+        EXPECT_TRUE(m->has_error()) << rates;
+    }
+}
+
+// the conductance is the derivative of the current with respect to v
+TEST(Module, conductance) {
+    std::string source =
+        "NEURON {\n"
+        "    SUFFIX leak\n"
+        "    NONSPECIFIC_CURRENT il\n"
+        "    RANGE gbar, el\n"
+        "}\n"
+        "PARAMETER {\n"
+        "    gbar = 0.001\n"
+        "    el = -70\n"
+        "}\n"
+        "INITIAL {\n"
+        "}\n"
+        "BREAKPOINT {\n"
+        "    LOCAL g, q\n"
+        "    g = gbar*exp(v/10)\n"
+        "    q = 2*v\n"
+        "    il = g*(v - el)\n"
+        "}\n";
+    Module m(std::vector<char>(source.begin(), source.end()));
+    Parser p(m, false);
+    EXPECT_TRUE(p.parse());
+    ASSERT_TRUE(m.semantic());
+
+    std::set<std::string> assigned;
+    auto current = m.symbols().find("nrn_current")->second->is_api_method();
+    for(auto& e : *current->body()) {
+        if(auto a = e->is_assignment()) {
+            if(auto id = a->lhs()->is_identifier()) {
+                assigned.insert(id->spelling());
+            }
+        }
+    }
+
+    // the derivative of g is needed for the chain rule, but not that of q
+    EXPECT_TRUE(assigned.count("conductance_"));
+    EXPECT_TRUE(assigned.count("dgdv_"));
+    EXPECT_FALSE(assigned.count("dqdv_"));
+}
+
+// a current that depends on v through an if statement or a PROCEDURE call
+// can't be differentiated, and is an error
+TEST(Module, conductance_dependencies) {
+    auto semantic = [](std::string const& breakpoint) {
+        std::string source =
+            "NEURON {\n"
+            "    SUFFIX leak\n"
+            "    NONSPECIFIC_CURRENT il\n"
+            "    RANGE gbar, el, g\n"
+            "}\n"
+            "PARAMETER {\n"
+            "    gbar = 0.001\n"
+            "    el = -70\n"
+            "}\n"
+            "ASSIGNED {\n"
+            "    g\n"
+            "}\n"
+            "INITIAL {\n"
+            "}\n"
+            "BREAKPOINT {\n"
+            + breakpoint +
+            "    il = g*(v - el)\n"
+            "}\n"
+            "PROCEDURE rates(u) {\n"
+            "    g = gbar*exp(u/10)\n"
+            "}\n";
+        Module m(std::vector<char>(source.begin(), source.end()));
+        Parser p(m, false);
+        EXPECT_TRUE(p.parse());
+        return m.semantic();
+    };
+
+    EXPECT_FALSE(semantic(
+        "    if (gbar > 0) {\n"
+        "        g = gbar*exp(v/10)\n"
+        "    }\n"));
+    EXPECT_FALSE(semantic("    rates(v)\n"));
+
+    // the conditions of if statements are not differentiated
+    EXPECT_TRUE(semantic(
+        "    if (v > -50) {\n"
+        "        g = gbar\n"
+        "    } else {\n"
+        "        g = 0\n"
+        "    }\n"));
+    EXPECT_TRUE(semantic("    rates(el)\n"));
+}
+
+// decay factors that depend only on dt and parameters are computed by dt_cache_
+TEST(Module, dt_cache) {
+    auto compile = [] (std::string const& range, bool use_dt_cache=true) {
+        std::string source =
+            "NEURON {\n"
+            "    POINT_PROCESS syn\n"
+            "    RANGE " + range + "\n"
+            "    NONSPECIFIC_CURRENT i\n"
+            "}\n"
+            "PARAMETER {\n"
+            "    tau = 2\n"
+            "    taum = 1\n"
+            "}\n"
+            "ASSIGNED {\n"
+            "    minf\n"
+            "    mtau\n"
+            "}\n"
+            "STATE {\n"
+            "    g m\n"
+            "}\n"
+            "INITIAL {\n"
+            "    g = 0\n"
+            "    m = 0\n"
+            "}\n"
+            "BREAKPOINT {\n"
+            "    SOLVE states METHOD cnexp\n"
+            "    i = g*m*v\n"
+            "}\n"
+            "DERIVATIVE states {\n"
+            "    minf = 1/(1 + exp(-v))\n"
+            "    mtau = taum*(1 + exp(v))\n"
+            "    g' = -g/tau\n"
+            "    m' = (minf - m)/mtau\n"
+            "}\n";
+        auto m = make_unique<Module>(std::vector<char>(source.begin(), source.end()));
+        m->use_dt_cache(use_dt_cache);
+        Parser p(*m, false);
+        EXPECT_TRUE(p.parse());
+        EXPECT_TRUE(m->semantic()) << m->error_string();
+        return m;
+    };
+
+    // the decay of g is cached, and that of m depends on v
+    {
+        auto m = compile("tau");
+        auto& symbols = m->symbols();
+        auto cache = symbols.find("dt_cache_");
+        ASSERT_NE(cache, symbols.end());
+        EXPECT_EQ(cache->second->is_procedure()->kind(), procedureKind::dt_cache);
+        EXPECT_EQ(cache->second->is_procedure()->body()->statements().size(), 1u);
+        ASSERT_NE(symbols.find("g_decay_"), symbols.end());
+        EXPECT_TRUE(symbols.find("g_decay_")->second->is_variable()->is_range());
+        EXPECT_EQ(symbols.find("m_decay_"), symbols.end());
+
+        // m can't be advanced by k steps, because its ODE depends on v
+        EXPECT_EQ(symbols.find("advance"), symbols.end());
+
+        auto state = symbols.find("nrn_state")->second->is_api_method();
+        std::string body;
+        for(auto& e : *state->body()) {
+            body += e->to_string() + "\n";
+        }
+        EXPECT_NE(body.find("g_decay_"), std::string::npos);
+    }
+
+    // a decay that depends only on scalar parameters is a scalar
+    {
+        auto m = compile("minf");
+        auto& symbols = m->symbols();
+        ASSERT_NE(symbols.find("g_decay_"), symbols.end());
+        EXPECT_FALSE(symbols.find("g_decay_")->second->is_variable()->is_range());
+    }
+
+    {
+        auto m = compile("tau", false);
+        auto& symbols = m->symbols();
+        EXPECT_EQ(symbols.find("dt_cache_"), symbols.end());
+        EXPECT_EQ(symbols.find("g_decay_"), symbols.end());
+    }
+}
+
+// the states of linear ODEs with coefficients that depend only on parameters
+// can be advanced by k time steps at once
+TEST(Module, advance) {
+    std::string source =
+        "NEURON {\n"
+        "    POINT_PROCESS syn\n"
+        "    RANGE tau, sinf\n"
+        "    NONSPECIFIC_CURRENT i\n"
+        "}\n"
+        "PARAMETER {\n"
+        "    tau = 2\n"
+        "    sinf = 0.5\n"
+        "    r = 0.3\n"
+        "}\n"
+        "STATE {\n"
+        "    s c g\n"
+        "}\n"
+        "INITIAL {\n"
+        "    s = 0\n"
+        "}\n"
+        "BREAKPOINT {\n"
+        "    SOLVE states METHOD cnexp\n"
+        "    i = (s + c + g)*v\n"
+        "}\n"
+        "DERIVATIVE states {\n"
+        "    s' = (sinf - s)/tau\n"
+        "    c' = r - c/tau\n"
+        "    g' = -g/tau\n"
+        "}\n";
+    Module m(std::vector<char>(source.begin(), source.end()));
+    Parser p(m, false);
+    EXPECT_TRUE(p.parse());
+    ASSERT_TRUE(m.semantic()) << m.error_string();
+
+    auto advance = m.symbols().find("advance");
+    ASSERT_NE(advance, m.symbols().end());
+    auto proc = advance->second->is_procedure();
+    EXPECT_EQ(proc->kind(), procedureKind::advance);
+    ASSERT_EQ(proc->args().size(), 1u);
+    EXPECT_EQ(proc->args()[0]->is_argument()->spelling(), "k");
+
+    // every state is updated
+    std::set<std::string> assigned;
+    for(auto& e : *proc->body()) {
+        if(auto a = e->is_assignment()) {
+            assigned.insert(a->lhs()->is_identifier()->spelling());
+        }
+    }
+    for(auto state : {"s", "c", "g"}) {
+        EXPECT_TRUE(assigned.count(state)) << state;
+    }
+}
+
+// point processes have an entry point that delivers a batch of events
+TEST(Module, deliver_events) {
+    std::string source =
+        "NEURON {\n"
+        "    POINT_PROCESS syn\n"
+        "    NONSPECIFIC_CURRENT i\n"
+        "}\n"
+        "STATE {\n"
+        "    g\n"
+        "}\n"
+        "INITIAL {\n"
+        "    g = 0\n"
+        "}\n"
+        "BREAKPOINT {\n"
+        "    i = g*v\n"
+        "}\n"
+        "NET_RECEIVE(weight, scale) {\n"
+        "    g = g + weight*scale\n"
+        "}\n";
+    Module m(std::vector<char>(source.begin(), source.end()));
+    Parser p(m, false);
+    EXPECT_TRUE(p.parse());
+    ASSERT_TRUE(m.semantic());
+
+    CPrinter printer(m);
+    auto text = printer.text();
+    EXPECT_NE(text.find("void deliver_events(event_batch const& events)"), std::string::npos);
+    EXPECT_NE(text.find("const value_type* weight = nullptr;"), std::string::npos);
+    EXPECT_NE(text.find("value_type scale = events.scale[j_];"), std::string::npos);
+}
+
+TEST(Module, random) {
+    std::string source =
+        "NEURON {\n"
+        "    POINT_PROCESS syn\n"
+        "    NONSPECIFIC_CURRENT i\n"
+        "}\n"
+        "PARAMETER {\n"
+        "    p = 0.5\n"
+        "}\n"
+        "STATE {\n"
+        "    g\n"
+        "}\n"
+        "INITIAL {\n"
+        "    g = 0\n"
+        "}\n"
+        "BREAKPOINT {\n"
+        "    i = g*v + random_normal()\n"
+        "}\n"
+        "NET_RECEIVE(weight) {\n"
+        "    LOCAL r\n"
+        "    if(g < 1) {\n"
+        "        r = urand()\n"
+        "        if(r < p) {\n"
+        "            g = g + weight\n"
+        "        }\n"
+        "    }\n"
+        "    else {\n"
+        "        r = urand()\n"
+        "    }\n"
+        "}\n"
+        "FUNCTION urand() {\n"
+        "    urand = random_uniform()\n"
+        "}\n";
+    Module m(std::vector<char>(source.begin(), source.end()));
+    Parser p(m, false);
+    EXPECT_TRUE(p.parse());
+    ASSERT_TRUE(m.semantic());
+    EXPECT_GT(m.random_sites(), 0);
+
+    CPrinter printer(m);
+    auto text = printer.text();
+
+    // the calls in the branches of the if statements are inlined
+    EXPECT_EQ(text.find("urand("), std::string::npos);
+
+    // every call draws from its own stream, with the same sites in
+    // net_receive and deliver_events, counted by the events of the instance
+    std::set<std::string> sites;
+    std::string draw = "modcc::random_uniform(random_seed_, modcc::random_event(random_events_[i_]), i_, ";
+    for(auto pos = text.find(draw); pos!=std::string::npos; pos = text.find(draw, pos+1)) {
+        auto begin = pos + draw.size();
+        sites.insert(text.substr(begin, text.find(')', begin)-begin));
+    }
+    EXPECT_EQ(sites.size(), 2u);
+    EXPECT_NE(text.find("++random_events_[i_];"), std::string::npos);
+
+    // the draws of the kernels are counted by the kernel calls
+    EXPECT_NE(text.find("modcc::random_normal(random_seed_, random_counter_, i_, "), std::string::npos);
+    EXPECT_NE(text.find("++random_counter_;"), std::string::npos);
+}
+
+// with an ensemble every field and indexed array has one value for each lane
+TEST(Module, ensemble) {
+    std::string source =
+        "NEURON {\n"
+        "    POINT_PROCESS syn\n"
+        "    RANGE tau\n"
+        "    NONSPECIFIC_CURRENT i\n"
+        "}\n"
+        "PARAMETER {\n"
+        "    tau = 2\n"
+        "}\n"
+        "STATE {\n"
+        "    g\n"
+        "}\n"
+        "INITIAL {\n"
+        "    g = 0\n"
+        "}\n"
+        "BREAKPOINT {\n"
+        "    SOLVE states METHOD cnexp\n"
+        "    i = g*v\n"
+        "}\n"
+        "DERIVATIVE states {\n"
+        "    g' = -g/tau\n"
+        "}\n"
+        "NET_RECEIVE(weight) {\n"
+        "    g = g + weight\n"
+        "}\n";
+    Module m(std::vector<char>(source.begin(), source.end()));
+    Parser p(m, false);
+    EXPECT_TRUE(p.parse());
+    ASSERT_TRUE(m.semantic());
+
+    CPrinterOptions opts;
+    opts.ensemble = 4;
+    CPrinter printer(m, opts);
+    auto text = printer.text();
+    EXPECT_NE(text.find("static constexpr int ensemble_size = 4;"), std::string::npos);
+    EXPECT_NE(text.find("auto field_size = ensemble_size*size()+padding;"), std::string::npos);
+    EXPECT_NE(text.find("for(int k_=0; k_<ensemble_size; ++k_) {"), std::string::npos);
+
+    // the index of the node is shared by the lanes of an instance
+    EXPECT_NE(text.find("vec_v[ensemble_size*node_index_[i_]+k_]"), std::string::npos);
+    EXPECT_NE(text.find("g[ensemble_size*i_+k_] = g[ensemble_size*i_+k_]+weight;"), std::string::npos);
+    EXPECT_EQ(text.find("indexed_view_type vec_v("), std::string::npos);
+}
+
+// the kernels of a mechanism group load the indexed arrays once
+TEST(Module, group) {
+    auto make_module = [] (std::string const& source) {
+        auto m = make_unique<Module>(std::vector<char>(source.begin(), source.end()));
+        Parser p(*m, false);
+        EXPECT_TRUE(p.parse());
+        EXPECT_TRUE(m->semantic());
+        return m;
+    };
+    auto leak = make_module(
+        "NEURON {\n"
+        "    SUFFIX leak\n"
+        "    NONSPECIFIC_CURRENT i\n"
+        "}\n"
+        "PARAMETER {\n"
+        "    g = 0.001\n"
+        "}\n"
+        "INITIAL {\n"
+        "}\n"
+        "BREAKPOINT {\n"
+        "    i = g*(v + 70)\n"
+        "}\n");
+    auto na = make_module(
+        "NEURON {\n"
+        "    SUFFIX na\n"
+        "    USEION na READ ena WRITE ina\n"
+        "}\n"
+        "PARAMETER {\n"
+        "    g = 0.1\n"
+        "}\n"
+        "INITIAL {\n"
+        "}\n"
+        "BREAKPOINT {\n"
+        "    ina = g*(v - ena)\n"
+        "}\n");
+    auto reader = make_module(
+        "NEURON {\n"
+        "    SUFFIX reader\n"
+        "    USEION na READ ina\n"
+        "    NONSPECIFIC_CURRENT i\n"
+        "}\n"
+        "INITIAL {\n"
+        "}\n"
+        "BREAKPOINT {\n"
+        "    i = 0.1*(v - ina)\n"
+        "}\n");
+
+    std::vector<Module*> members = {leak.get(), na.get()};
+    EXPECT_EQ(GroupPrinter::check(members), "");
+
+    auto text = GroupPrinter(members, "channels", CPrinterOptions()).text();
+    auto group = text.substr(text.find("class mechanism_channels"));
+    EXPECT_NE(group.find("leak_.nrn_current_fused_(i_, v, conductance_, current_);"), std::string::npos);
+    EXPECT_NE(group.find("na_.nrn_current_fused_(i_, ena, v, conductance_, current_, ina);"), std::string::npos);
+
+    // v is loaded, and the current is accumulated, once for both mechanisms,
+    // and only by nrn_current because neither mechanism has states
+    auto count = [&group] (std::string const& s) {
+        int n = 0;
+        for(auto pos = group.find(s); pos!=std::string::npos; pos = group.find(s, pos+1)) ++n;
+        return n;
+    };
+    EXPECT_EQ(count("value_type v = vec_v[i_];"), 1);
+    EXPECT_EQ(count("vec_i[i_] += current_;"), 1);
+
+    // the current of na is only added after reader has run
+    std::vector<Module*> conflict = {na.get(), reader.get()};
+    EXPECT_NE(GroupPrinter::check(conflict), "");
+}
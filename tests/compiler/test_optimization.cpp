@@ -3,6 +3,10 @@
 #include "test.hpp"
 
 #include "../src/constantfolder.hpp"
+#include "../src/cprinter.hpp"
+#include "../src/loopfission.hpp"
+#include "../src/module.hpp"
+#include "../src/perfvisitor.hpp"
 
 #include "../src/util.hpp"
 
@@ -80,3 +84,154 @@ TEST(Optimizer, constant_folding) {
     }
 }
 
+
+TEST(Optimizer, loop_fission) {
+    std::string source =
+        "NEURON {\n"
+        "    SUFFIX fission\n"
+        "    RANGE a, b, c, d, e, f\n"
+        "}\n"
+        "PARAMETER {\n"
+        "    a = 1\n"
+        "    b = 2\n"
+        "    c = 3\n"
+        "    d = 4\n"
+        "    e = 5\n"
+        "    f = 6\n"
+        "}\n"
+        "STATE {\n"
+        "    s\n"
+        "}\n"
+        "INITIAL {\n"
+        "    s = 0\n"
+        "}\n"
+        "BREAKPOINT {\n"
+        "    SOLVE states METHOD cnexp\n"
+        "}\n"
+        "DERIVATIVE states {\n"
+        "    LOCAL x\n"
+        "    x = a + b\n"
+        "    x = x + c + d\n"
+        "    s' = (x + e + f) - s\n"
+        "}\n";
+    Module m(std::vector<char>(source.begin(), source.end()));
+    Parser p(m, false);
+    EXPECT_TRUE(p.parse());
+    EXPECT_TRUE(m.semantic());
+
+    auto state = m.symbols()["nrn_state"]->is_api_method();
+    ASSERT_NE(state, nullptr);
+
+    // no budget: a single loop
+    EXPECT_EQ(fission_api_method(state, 0).size(), 1u);
+
+    // a generous budget: a single loop
+    EXPECT_EQ(fission_api_method(state, 16).size(), 1u);
+
+    // a tight budget: every loop has to stay within the budget, except for
+    // loops with a single statement that exceeds the budget on its own
+    auto groups = fission_api_method(state, 3);
+    EXPECT_GT(groups.size(), 1u);
+    for(auto const& g : groups) {
+        if(g.statements.size()>1) {
+            EXPECT_LE(g.streams.size(), 3u);
+        }
+    }
+
+    // the local x is used in more than one loop
+    int x_users = 0;
+    for(auto const& g : groups) {
+        for(auto var : g.locals) {
+            if(var->name()=="x") ++x_users;
+        }
+    }
+    EXPECT_GT(x_users, 1);
+}
+
+// the kernels printed with a stream budget are split into loops over blocks
+// of instances, and the locals used by more than one loop live in scratch
+// buffers of one block
+TEST(Optimizer, loop_fission_printer) {
+    std::string source =
+        "NEURON {\n"
+        "    SUFFIX fission\n"
+        "    NONSPECIFIC_CURRENT i\n"
+        "    RANGE a, b, c, d, e, f\n"
+        "}\n"
+        "PARAMETER {\n"
+        "    a = 1\n"
+        "    b = 2\n"
+        "    c = 3\n"
+        "    d = 4\n"
+        "    e = 5\n"
+        "    f = 6\n"
+        "}\n"
+        "STATE {\n"
+        "    s\n"
+        "}\n"
+        "INITIAL {\n"
+        "    s = 0\n"
+        "}\n"
+        "BREAKPOINT {\n"
+        "    SOLVE states METHOD cnexp\n"
+        "    LOCAL y\n"
+        "    y = a*(v - b)\n"
+        "    i = y + c*s*(v - d) + e*f\n"
+        "}\n"
+        "DERIVATIVE states {\n"
+        "    LOCAL x\n"
+        "    x = a + b\n"
+        "    x = x + c + d\n"
+        "    s' = (x + e + f) - s\n"
+        "}\n";
+    Module m(std::vector<char>(source.begin(), source.end()));
+    Parser p(m, false);
+    EXPECT_TRUE(p.parse());
+    ASSERT_TRUE(m.semantic());
+
+    // the text of a kernel, up to the next kernel
+    auto kernel = [](std::string const& text, std::string const& name) {
+        auto first = text.find("void "+name+"(int begin_, int end_) {");
+        auto last = text.find("\n    void ", first+1);
+        return first==std::string::npos? std::string(): text.substr(first, last-first);
+    };
+    auto count = [](std::string const& text, std::string const& pattern) {
+        int n = 0;
+        for(auto pos=text.find(pattern); pos!=std::string::npos; pos=text.find(pattern, pos+1)) {
+            ++n;
+        }
+        return n;
+    };
+    std::string block_loop = "for(int b_=begin_; b_<end_; b_+=BSIZE) {";
+    std::string inner_loop = "for(int j_=0; j_<bn_; ++j_) {";
+
+    // without a budget the kernels are not split
+    {
+        auto text = CPrinter(m, CPrinterOptions()).text();
+        EXPECT_EQ(text.find("BSIZE"), std::string::npos);
+    }
+
+    CPrinterOptions opts;
+    opts.max_streams = 3;
+    auto text = CPrinter(m, opts).text();
+
+    auto state = kernel(text, "nrn_state");
+    ASSERT_FALSE(state.empty());
+    EXPECT_NE(state.find("constexpr int BSIZE = 64;"), std::string::npos);
+    EXPECT_EQ(count(state, block_loop), 1);
+    EXPECT_EQ(count(state, inner_loop), 3);
+    EXPECT_NE(state.find("value_type x[BSIZE];"), std::string::npos);
+    EXPECT_NE(state.find("x[j_] = a[i_]+b[i_];"), std::string::npos);
+    EXPECT_NE(state.find("x[j_] = x[j_]+c[i_]+d[i_];"), std::string::npos);
+    EXPECT_NE(state.find("s[i_] = "), std::string::npos);
+
+    // the current and conductance are accumulated in a loop of their own
+    auto current = kernel(text, "nrn_current");
+    ASSERT_FALSE(current.empty());
+    EXPECT_EQ(count(current, block_loop), 1);
+    EXPECT_GT(count(current, inner_loop), 2);
+    EXPECT_NE(current.find("value_type y[BSIZE];"), std::string::npos);
+    EXPECT_NE(current.find("value_type current_[BSIZE];"), std::string::npos);
+    EXPECT_NE(current.find("y[j_] = a[i_]*(v-b[i_]);"), std::string::npos);
+    EXPECT_NE(current.find("vec_i[i_] += current_[j_];"), std::string::npos);
+}
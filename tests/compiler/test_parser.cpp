@@ -129,6 +129,19 @@ TEST(Parser, parse_solve) {
             std::cout << red("error") << p.error_message() << std::endl;
         }
     }
+    {
+        Parser p("SOLVE scheme METHOD sparse");
+        auto e = p.parse_solve();
+
+        EXPECT_NE(e, nullptr);
+        EXPECT_EQ(p.status(), lexerStatus::happy);
+
+        if(e) {
+            SolveExpression* s = dynamic_cast<SolveExpression*>(e.get());
+            EXPECT_EQ(s->method(), solverMethod::sparse);
+            EXPECT_EQ(s->name(), "scheme");
+        }
+    }
     {
         Parser p("SOLVE states");
         auto e = p.parse_solve();
@@ -152,6 +165,62 @@ TEST(Parser, parse_solve) {
     }
 }
 
+TEST(Parser, parse_reaction) {
+    {
+        Parser p("~ C <-> O (alpha(v), 2*beta)");
+        auto e = p.parse_reaction();
+
+#ifdef VERBOSE_TEST
+        if(e) std::cout << e->to_string() << std::endl;
+#endif
+        EXPECT_NE(e, nullptr);
+        EXPECT_EQ(p.status(), lexerStatus::happy);
+
+        if(e) {
+            auto r = e->is_reaction();
+            ASSERT_NE(r, nullptr);
+            ASSERT_EQ(r->lhs().size(), 1u);
+            ASSERT_EQ(r->rhs().size(), 1u);
+            EXPECT_EQ(r->lhs()[0]->is_identifier()->spelling(), "C");
+            EXPECT_EQ(r->rhs()[0]->is_identifier()->spelling(), "O");
+            EXPECT_NE(dynamic_cast<CallExpression*>(r->fwd_rate()), nullptr);
+            EXPECT_NE(r->bwd_rate()->is_binary(), nullptr);
+        }
+
+        // always print the compiler errors, because they are unexpected
+        if(p.status()==lexerStatus::error) {
+            std::cout << red("error") << p.error_message() << std::endl;
+        }
+    }
+    {
+        // higher order reactions are parsed, and rejected by semantic analysis
+        Parser p("~ A + B <-> C (kf, kb)");
+        auto e = p.parse_reaction();
+        EXPECT_NE(e, nullptr);
+        EXPECT_EQ(p.status(), lexerStatus::happy);
+        if(e) {
+            EXPECT_EQ(e->is_reaction()->lhs().size(), 2u);
+        }
+    }
+    {
+        Parser p("CONSERVE C1 + C2 + O = 1");
+        auto e = p.parse_conserve();
+        EXPECT_NE(e, nullptr);
+        EXPECT_EQ(p.status(), lexerStatus::happy);
+        if(e) {
+            EXPECT_NE(e->is_conserve_statement(), nullptr);
+        }
+    }
+
+    // stoichiometric coefficients and missing rates are errors
+    for(auto s : {"~ 2A <-> B (kf, kb)", "~ A <-> B", "~ A <-> B (kf)", "~ A -> B (kf, kb)"}) {
+        Parser p(s);
+        auto e = p.parse_reaction();
+        EXPECT_EQ(e, nullptr);
+        EXPECT_EQ(p.status(), lexerStatus::error);
+    }
+}
+
 TEST(Parser, parse_conductance) {
     {
         Parser p("CONDUCTANCE g USEION na");
@@ -197,6 +266,69 @@ TEST(Parser, parse_conductance) {
     }
 }
 
+TEST(Parser, parse_table) {
+    {
+        Parser p("TABLE minf, mtau DEPEND celsius FROM -100 TO 50.5 WITH 200");
+        auto e = p.parse_table();
+        EXPECT_NE(e, nullptr);
+        EXPECT_EQ(p.status(), lexerStatus::happy);
+        if(e) {
+            auto t = e->is_table_statement();
+            ASSERT_NE(t, nullptr);
+            EXPECT_EQ(t->names(), (std::vector<std::string>{"minf", "mtau"}));
+            EXPECT_EQ(t->depends(), (std::vector<std::string>{"celsius"}));
+            EXPECT_EQ(t->from(), -100.);
+            EXPECT_EQ(t->to(), 50.5);
+            EXPECT_EQ(t->n(), 200);
+        }
+    }
+    {
+        // the table of a FUNCTION has no names
+        Parser p("TABLE FROM 0 TO 1 WITH 10");
+        auto e = p.parse_table();
+        EXPECT_NE(e, nullptr);
+        EXPECT_EQ(p.status(), lexerStatus::happy);
+        if(e) {
+            EXPECT_TRUE(e->is_table_statement()->names().empty());
+            EXPECT_TRUE(e->is_table_statement()->depends().empty());
+        }
+    }
+
+    // missing bounds, empty or inverted ranges, and fractional sizes are errors
+    for(auto s : {"TABLE a FROM 0 WITH 10", "TABLE a FROM 1 TO 0 WITH 10",
+                  "TABLE a DEPEND FROM 0 TO 1 WITH 10", "TABLE a FROM 0 TO 1 WITH 2.5"}) {
+        Parser p(s);
+        auto e = p.parse_table();
+        EXPECT_EQ(e, nullptr) << s;
+        EXPECT_EQ(p.status(), lexerStatus::error) << s;
+    }
+}
+
+TEST(Parser, parse_random) {
+    {
+        Parser p("x = 1 + random_normal()*sigma");
+        auto e = p.parse_line_expression();
+        EXPECT_NE(e, nullptr);
+        EXPECT_EQ(p.status(), lexerStatus::happy);
+    }
+    for(auto t : {tok::random_uniform, tok::random_exponential, tok::random_normal}) {
+        Parser p(token_string(t) + "()");
+        auto e = p.parse_primary();
+        ASSERT_NE(e, nullptr);
+        EXPECT_EQ(p.status(), lexerStatus::happy);
+        ASSERT_NE(e->is_random(), nullptr);
+        EXPECT_EQ(e->is_random()->op(), t);
+    }
+
+    // the intrinsics have no arguments
+    for(auto s : {"random_uniform", "random_uniform(1)"}) {
+        Parser p(s);
+        auto e = p.parse_primary();
+        EXPECT_EQ(e, nullptr) << s;
+        EXPECT_EQ(p.status(), lexerStatus::error) << s;
+    }
+}
+
 TEST(Parser, parse_if) {
     {
         char expression[] =
@@ -563,3 +695,29 @@ TEST(Parser, parse_binop) {
     }
 }
 
+
+TEST(Parser, tolerance_annotations) {
+    std::string source =
+        "STATE {\n"
+        "    m <1e-5>\n"
+        "    h\n"
+        "}\n"
+        "PARAMETER {\n"
+        "    gbar = 0.1 (S/cm2) <1e-4>\n"
+        "    tau = 2 <0, 100>\n"
+        "}\n";
+    Module m(std::vector<char>(source.begin(), source.end()));
+    Parser p(m, false);
+    EXPECT_TRUE(p.parse());
+
+    auto const& states = m.state_block();
+    EXPECT_EQ(states.state_variables.size(), 2u);
+    EXPECT_EQ(states.tolerances.size(), 1u);
+    EXPECT_EQ(std::stod(states.tolerances.at("m")), 1e-5);
+
+    auto const& params = m.parameter_block().parameters;
+    ASSERT_EQ(params.size(), 2u);
+    EXPECT_EQ(std::stod(params[0].tolerance), 1e-4);
+    // limits are not a tolerance
+    EXPECT_TRUE(params[1].tolerance.empty());
+}
@@ -1,10 +1,17 @@
 #include "test.hpp"
 
+#include <cmath>
+
 #include "../src/constantfolder.hpp"
+#include "../src/costmodel.hpp"
 #include "../src/expressionclassifier.hpp"
 //#include "../src/variablerenamer.hpp"
 #include "../src/perfvisitor.hpp"
+#include "../src/roofline.hpp"
+#include "../src/symdiff.hpp"
+#include "../src/vectorizationvisitor.hpp"
 
+#include "../src/module.hpp"
 #include "../src/parser.hpp"
 #include "../src/util.hpp"
 
@@ -153,6 +160,184 @@ TEST(FlopVisitor, function) {
     }
 }
 
+TEST(FlopVisitor, if_statement) {
+    {
+    const char *expression =
+"PROCEDURE foo(v) {\n"
+"    if (v+1 > 0) {\n"
+"        x = exp(v)\n"
+"    } else {\n"
+"        x = 2*v\n"
+"    }\n"
+"}";
+    // both branches are counted
+    auto visitor = make_unique<FlopVisitor>();
+    auto e = parse_procedure(expression);
+    e->accept(visitor.get());
+    EXPECT_EQ(visitor->flops.add, 1);
+    EXPECT_EQ(visitor->flops.mul, 1);
+    EXPECT_EQ(visitor->flops.exp, 1);
+    EXPECT_EQ(visitor->flops.total(), 3);
+    }
+}
+
+TEST(CostVisitor, procedure) {
+    const char *expression =
+"PROCEDURE foo(v) {\n"
+"    LOCAL a, b\n"
+"    a = 2*v + 1\n"
+"    b = exp(a)/v\n"
+"    x = b - a\n"
+"}";
+    auto model = CostModel::find("haswell");
+    ASSERT_NE(model, nullptr);
+
+    CostVisitor visitor(*model);
+    auto e = parse_procedure(expression);
+    e->accept(&visitor);
+
+    // the multiply and add are fused
+    EXPECT_EQ(visitor.count(costOp::fma), 1);
+    EXPECT_EQ(visitor.count(costOp::mul), 0);
+    EXPECT_EQ(visitor.count(costOp::add), 1);
+    EXPECT_EQ(visitor.count(costOp::exp), 1);
+    EXPECT_EQ(visitor.count(costOp::div), 1);
+
+    // fma -> exp -> div -> add
+    auto const& m = *model;
+    EXPECT_EQ(visitor.critical_path(),
+        m[costOp::fma].latency + m[costOp::exp].latency
+        + m[costOp::div].latency + m[costOp::add].latency);
+
+    EXPECT_EQ(CostModel::find("foo"), nullptr);
+}
+
+// a variable of the caller does not delay a variable of the callee with the
+// same name
+TEST(CostVisitor, scope) {
+    auto source = [](std::string const& call) {
+        return
+            "NEURON {\n"
+            "    SUFFIX test\n"
+            "}\n"
+            "ASSIGNED {\n"
+            "    v\n"
+            "}\n"
+            "STATE {\n"
+            "    s\n"
+            "}\n"
+            "INITIAL {\n"
+            "    LOCAL x\n"
+            "    x = exp(exp(v))\n"
+            "    s = x\n"
+            + call +
+            "}\n"
+            "BREAKPOINT {\n"
+            "}\n"
+            "PROCEDURE foo(x) {\n"
+            "    s = x + 1\n"
+            "}\n";
+    };
+    auto critical_path = [](std::string const& text) {
+        Module m(std::vector<char>(text.begin(), text.end()));
+        Parser p(m, false);
+        EXPECT_TRUE(p.parse());
+        EXPECT_TRUE(m.semantic());
+        auto init = m.symbols().find("nrn_init")->second->is_api_method();
+        return estimate_cost(init, *CostModel::find("haswell")).critical_path;
+    };
+    EXPECT_EQ(critical_path(source("")), critical_path(source("    foo(v)\n")));
+}
+
+TEST(Roofline, estimate) {
+    MachineModel machine;
+    machine.peak_gflops = 100;
+    machine.bandwidth = 10;
+    machine.cost_exp = 20;
+
+    FlopAccumulator flops;
+    flops.add = 4;
+    flops.mul = 4;
+    flops.exp = 1;
+
+    // 28 flops on 80 bytes is below the ridge point of 10 flops per byte
+    auto r = roofline(flops, 80, machine);
+    EXPECT_EQ(r.flops, 28.);
+    EXPECT_EQ(r.time, 8.);
+    EXPECT_TRUE(r.memory_bound);
+
+    // 28 flops on 2 bytes is above the ridge point
+    r = roofline(flops, 2, machine);
+    EXPECT_EQ(r.intensity, 14.);
+    EXPECT_DOUBLE_EQ(r.time, 0.28);
+    EXPECT_FALSE(r.memory_bound);
+}
+
+TEST(VectorizationVisitor, blockers) {
+    std::string source =
+        "NEURON {\n"
+        "    POINT_PROCESS syn\n"
+        "    NONSPECIFIC_CURRENT i\n"
+        "}\n"
+        "PARAMETER {\n"
+        "    a = 2\n"
+        "}\n"
+        "ASSIGNED {\n"
+        "    v\n"
+        "}\n"
+        "STATE {\n"
+        "    s\n"
+        "}\n"
+        "INITIAL {\n"
+        "    s = 0\n"
+        "}\n"
+        "BREAKPOINT {\n"
+        "    SOLVE states METHOD cnexp\n"
+        "    i = s*(v - a)\n"
+        "}\n"
+        "DERIVATIVE states {\n"
+        "    LOCAL x\n"
+        "    x = s^a + s^(1+2)\n"
+        "    if(x > 1) {\n"
+        "        x = 1\n"
+        "    }\n"
+        "    s' = x - s\n"
+        "}\n";
+    Module m(std::vector<char>(source.begin(), source.end()));
+    Parser p(m, false);
+    EXPECT_TRUE(p.parse());
+    EXPECT_TRUE(m.semantic());
+
+    auto count = [](VectorizationVisitor const& v, vectorBlocker kind) {
+        int n = 0;
+        for(auto const& d : v.diagnostics()) {
+            if(d.kind==kind) ++n;
+        }
+        return n;
+    };
+
+    // only the pow with a variable exponent is reported
+    VectorizationVisitor state(true, false);
+    m.symbols()["nrn_state"]->is_api_method()->accept(&state);
+    EXPECT_EQ(count(state, vectorBlocker::pow), 1);
+    EXPECT_EQ(count(state, vectorBlocker::branch), 1);
+    EXPECT_EQ(count(state, vectorBlocker::aliased_write), 0);
+    for(auto const& d : state.diagnostics()) {
+        EXPECT_GT(d.location.line, 20);
+    }
+
+    // the write backs of the current and conductance are aliased, unless
+    // they go through ghost buffers in the optimized printer
+    VectorizationVisitor current(true, false);
+    m.symbols()["nrn_current"]->is_api_method()->accept(&current);
+    EXPECT_EQ(count(current, vectorBlocker::aliased_write), 2);
+
+    VectorizationVisitor current_opt(true, true);
+    m.symbols()["nrn_current"]->is_api_method()->accept(&current_opt);
+    EXPECT_EQ(count(current_opt, vectorBlocker::aliased_write), 0);
+    EXPECT_EQ(count(current_opt, vectorBlocker::ghost_local), 2);
+}
+
 TEST(ClassificationVisitor, linear) {
     std::vector<const char*> expressions =
     {
@@ -303,3 +488,184 @@ TEST(ClassificationVisitor, nonlinear) {
     delete v;
 }
 
+
+// evaluates an expression with values for its identifiers
+class EvaluationVisitor : public Visitor {
+public:
+    EvaluationVisitor(std::map<std::string, double> const& values)
+    :   values_(values)
+    {}
+
+    void visit(Expression *e) override {
+        throw compiler_exception("unable to evaluate " + e->to_string(), e->location());
+    }
+    void visit(NumberExpression *e) override {
+        value = e->value();
+    }
+    void visit(IdentifierExpression *e) override {
+        value = values_.at(e->spelling());
+    }
+    void visit(UnaryExpression *e) override {
+        e->expression()->accept(this);
+        switch(e->op()) {
+            case tok::minus : value = -value;           break;
+            case tok::exp   : value = std::exp(value);  break;
+            case tok::log   : value = std::log(value);  break;
+            case tok::sin   : value = std::sin(value);  break;
+            case tok::cos   : value = std::cos(value);  break;
+            default         : visit((Expression*)e);
+        }
+    }
+    void visit(BinaryExpression *e) override {
+        e->lhs()->accept(this);
+        auto a = value;
+        e->rhs()->accept(this);
+        auto b = value;
+        switch(e->op()) {
+            case tok::plus   : value = a + b;            break;
+            case tok::minus  : value = a - b;            break;
+            case tok::times  : value = a * b;            break;
+            case tok::divide : value = a / b;            break;
+            case tok::pow    : value = std::pow(a, b);   break;
+            default          : visit((Expression*)e);
+        }
+    }
+
+    double value = 0;
+
+private:
+    std::map<std::string, double> const& values_;
+};
+
+TEST(DifferentiationVisitor, derivatives) {
+    std::vector<const char*> expressions = {
+        "x",
+        "3*x + y",
+        "x*x*y",
+        "y/x",
+        "(x - y)/(x + y)",
+        "exp(-x/y)",
+        "log(x*y)",
+        "sin(2*x)*cos(x)",
+        "x^3",
+        "y^x",
+        "x^x",
+        "-x*exp(x/2)/(1 + exp(x))",
+    };
+
+    auto evaluate = [](Expression* e, double x, double y) {
+        std::map<std::string, double> values = {{"x", x}, {"y", y}};
+        EvaluationVisitor v(values);
+        e->accept(&v);
+        return v.value;
+    };
+
+    // compare with a central difference
+    for(auto const& expression : expressions) {
+        auto e = parse_expression(expression);
+        ASSERT_NE(e, nullptr);
+
+        auto d = symbolic_derivative(e.get(), "x");
+        ASSERT_NE(d, nullptr);
+
+        for(auto x : {0.5, 1.3, 2.7}) {
+            auto y = 1.7;
+            auto h = 1e-6;
+            auto fd = (evaluate(e.get(), x+h, y) - evaluate(e.get(), x-h, y))/(2*h);
+            EXPECT_NEAR(evaluate(d.get(), x, y), fd, 1e-6*std::max(1., std::fabs(fd))) << expression;
+        }
+    }
+
+    // expressions that do not depend on x have a derivative of 0
+    for(auto expression : {"y", "2*y + 3", "exp(y)/y"}) {
+        auto e = parse_expression(expression);
+        auto d = symbolic_derivative(e.get(), "x");
+        ASSERT_NE(d, nullptr);
+        EXPECT_TRUE(is_zero(d.get())) << expression;
+    }
+
+    // the derivatives of other variables are given by the chain
+    {
+        auto e = parse_expression("l*x");
+        auto d = symbolic_derivative(e.get(), "x", {{"l", "dl"}});
+        ASSERT_NE(d, nullptr);
+        EXPECT_EQ(identifiers(d.get()), (std::set<std::string>{"dl", "l", "x"}));
+    }
+
+    // function calls can't be differentiated
+    {
+        auto e = parse_expression("x*foo(x)");
+        EXPECT_EQ(symbolic_derivative(e.get(), "x"), nullptr);
+    }
+}
+
+// the arrays of an API method are the ones its statements access, including
+// the statements of the procedures it calls and of both branches of an if,
+// and not every indexed variable that the mechanism declares
+TEST(MemOpVisitor, api_method) {
+    std::string source =
+        "NEURON {\n"
+        "    SUFFIX memops\n"
+        "    USEION na READ ena WRITE ina\n"
+        "    RANGE gbar, minf\n"
+        "}\n"
+        "PARAMETER {\n"
+        "    gbar = 1\n"
+        "}\n"
+        "STATE {\n"
+        "    m\n"
+        "}\n"
+        "ASSIGNED {\n"
+        "    minf\n"
+        "}\n"
+        "INITIAL {\n"
+        "    rates(v)\n"
+        "    m = minf\n"
+        "}\n"
+        "BREAKPOINT {\n"
+        "    SOLVE states METHOD cnexp\n"
+        "    ina = gbar*m*(v - ena)\n"
+        "}\n"
+        "DERIVATIVE states {\n"
+        "    rates(v)\n"
+        "    m' = minf - m\n"
+        "}\n"
+        "PROCEDURE rates(u) {\n"
+        "    if (u > 0) {\n"
+        "        minf = 1\n"
+        "    } else {\n"
+        "        minf = 1/(1+exp(-u))\n"
+        "    }\n"
+        "}\n";
+    Module m(std::vector<char>(source.begin(), source.end()));
+    Parser p(m, false);
+    EXPECT_TRUE(p.parse());
+    ASSERT_TRUE(m.semantic());
+
+    auto names = [](std::set<Symbol*> const& symbols) {
+        std::set<std::string> s;
+        for(auto sym : symbols) s.insert(sym->name());
+        return s;
+    };
+
+    auto state = m.symbols()["nrn_state"]->is_api_method();
+    ASSERT_NE(state, nullptr);
+    MemOpVisitor state_ops;
+    state->accept(&state_ops);
+    using names_type = std::set<std::string>;
+    EXPECT_EQ(names(state_ops.indexed_reads()), (names_type{"v"}));
+    EXPECT_EQ(names(state_ops.vector_reads()), (names_type{"m", "minf"}));
+    EXPECT_TRUE(state_ops.indexed_writes().empty());
+    // minf is written by the procedure rates
+    EXPECT_EQ(names(state_ops.vector_writes()), (names_type{"m", "minf"}));
+    EXPECT_EQ(state_ops.num_streams(), 3);
+
+    auto current = m.symbols()["nrn_current"]->is_api_method();
+    ASSERT_NE(current, nullptr);
+    MemOpVisitor current_ops;
+    current->accept(&current_ops);
+    EXPECT_EQ(names(current_ops.indexed_reads()), (names_type{"ena", "v"}));
+    EXPECT_EQ(names(current_ops.vector_reads()), (names_type{"gbar", "m"}));
+    EXPECT_EQ(names(current_ops.indexed_writes()), (names_type{"conductance_", "current_", "ina"}));
+    EXPECT_TRUE(current_ops.vector_writes().empty());
+}
@@ -150,27 +150,10 @@ PROCEDURE setRNG()
 { }
 
 FUNCTION urand() {
-    urand = 1.0
-:VERBATIM
-:    double value;
-:    if (_p_rng) {
-:            /*
-:            :Supports separate independent but reproducible streams for
-:            : each instance. However, the corresponding hoc Random
-:            : distribution MUST be set to Random.negexp(1)
-:            */
-:            value = nrn_random_pick(_p_rng);
-:            //printf("random stream for this simulation = %lf\n",value);
-:            return value;
-:    }else{
-:ENDVERBATIM
-:    : the old standby. Cannot use if reproducible parallel sim
-:    : independent of nhost or which host this instance is on
-:    : is desired, since each instance on this cpu draws from
-:    : the same stream
-:    value = scop_random(1)
-:VERBATIM
-:    }
-:ENDVERBATIM
-:    urand = value
+    : replaces nrn_random_pick and scop_random in VERBATIM blocks. The
+    : stream of an instance is reproducible for any number of threads and
+    : any order of delivery of events, but it is keyed by the index of the
+    : instance in the mechanism, so it changes when the cells are
+    : distributed differently over hosts
+    urand = random_uniform()
 }
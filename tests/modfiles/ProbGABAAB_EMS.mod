@@ -149,9 +149,10 @@ NET_RECEIVE (weight, weight_GABAA, weight_GABAB, Psurv, tsyn){
 PROCEDURE setRNG()
 {}
 
-: remove VERBATIM calls to rand
+: a reproducible random stream for each instance replaces the VERBATIM
+: calls to rand
 FUNCTION urand() {
-  urand = 0.5
+  urand = random_uniform()
 }
 
 :FUNCTION toggleVerbose() {
@@ -0,0 +1,50 @@
+TITLE calcium dynamics with a saturating pump
+
+NEURON {
+    SUFFIX cadpump
+    USEION ca READ ica WRITE cai
+    RANGE depth, kd, vmax, taur
+}
+
+UNITS {
+    (mA) = (milliamp)
+    (mM) = (milli/liter)
+    (um) = (micron)
+}
+
+PARAMETER {
+    depth = 0.1 (um)
+    taur = 200 (ms)
+    cainf = 0.0001 (mM)
+    kd = 0.0005 (mM)
+    vmax = 0.0001 (mM/ms)
+}
+
+ASSIGNED {
+    ica (mA/cm2)
+    cai (mM)
+}
+
+STATE {
+    ca
+}
+
+BREAKPOINT {
+    SOLVE states METHOD derivimplicit
+}
+
+INITIAL {
+    ca = cainf
+    cai = ca
+}
+
+DERIVATIVE states {
+    LOCAL drive, pump
+    drive = -(10000)*ica/(2*96485*depth)
+    if (drive < 0) {
+        drive = 0
+    }
+    pump = vmax*ca/(ca + kd)
+    ca' = drive - pump + (cainf - ca)/taur
+    cai = ca
+}
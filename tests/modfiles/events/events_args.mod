@@ -0,0 +1,25 @@
+: a synapse with a NET_RECEIVE block that has several arguments, and whose
+: effect depends on the order of the events
+
+NEURON {
+    POINT_PROCESS events_args
+    NONSPECIFIC_CURRENT i
+}
+
+STATE {
+    g h
+}
+
+INITIAL {
+    g = 0
+    h = 0
+}
+
+BREAKPOINT {
+    i = (g + h)*v
+}
+
+NET_RECEIVE(weight, scale, offset) {
+    g = g*scale + weight
+    h = h + offset*g
+}
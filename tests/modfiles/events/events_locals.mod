@@ -0,0 +1,28 @@
+: a synapse with a NET_RECEIVE block that uses local variables, and whose
+: effect depends on the order of the events
+
+NEURON {
+    POINT_PROCESS events_locals
+    NONSPECIFIC_CURRENT i
+}
+
+STATE {
+    g h
+}
+
+INITIAL {
+    g = 0
+    h = 1
+}
+
+BREAKPOINT {
+    i = g*h*v
+}
+
+NET_RECEIVE(weight) {
+    LOCAL a, b
+    a = 2*weight
+    b = a*g + 1
+    g = g + a
+    h = h*b
+}
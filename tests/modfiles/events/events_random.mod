@@ -0,0 +1,30 @@
+: a synapse that releases with a probability on every event
+
+NEURON {
+    POINT_PROCESS events_random
+    NONSPECIFIC_CURRENT i
+}
+
+PARAMETER {
+    p = 0.5
+}
+
+STATE {
+    g n
+}
+
+INITIAL {
+    g = 0
+    n = 0
+}
+
+BREAKPOINT {
+    i = g*v
+}
+
+NET_RECEIVE(weight) {
+    n = n + 1
+    if (random_uniform() < p) {
+        g = g + weight*random_uniform()
+    }
+}
@@ -0,0 +1,82 @@
+TITLE Hodgkin-Huxley type sodium and potassium channels with tabulated rates
+
+NEURON {
+    SUFFIX hh_table
+    USEION na READ ena WRITE ina
+    USEION k READ ek WRITE ik
+    RANGE gnabar, gkbar, gna, gk
+    RANGE minf, hinf, ninf, mtau, htau
+}
+
+UNITS {
+    (S) = (siemens)
+    (mV) = (millivolt)
+    (mA) = (milliamp)
+}
+
+PARAMETER {
+    gnabar = 0.12 (S/cm2)
+    gkbar = 0.036 (S/cm2)
+    celsius = 6.3 (degC)
+}
+
+STATE {
+    : the gates are stored in single precision with --mixed-precision
+    m <1e-5>
+    h <1e-5>
+    n <1e-5>
+}
+
+ASSIGNED {
+    v (mV)
+    ena (mV)
+    ek (mV)
+    ina (mA/cm2)
+    ik (mA/cm2)
+    gna (S/cm2)
+    gk (S/cm2)
+    minf
+    hinf
+    ninf
+    mtau (ms)
+    htau (ms)
+}
+
+BREAKPOINT {
+    SOLVE states METHOD cnexp
+    gna = gnabar*m*m*m*h
+    ina = gna*(v - ena)
+    gk = gkbar*n*n*n*n
+    ik = gk*(v - ek)
+}
+
+INITIAL {
+    rates(v)
+    m = minf
+    h = hinf
+    n = ninf
+}
+
+DERIVATIVE states {
+    rates(v)
+    m' = (minf - m)/mtau
+    h' = (hinf - h)/htau
+    n' = (ninf - n)/ntau(v)
+}
+
+PROCEDURE rates(v) {
+    TABLE minf, mtau, hinf, htau, ninf DEPEND celsius FROM -100 TO 100 WITH 200
+    LOCAL q10
+    q10 = 3^((celsius - 6.3)/10)
+
+    minf = 1/(1 + exp(-(v + 40)/7))
+    mtau = (0.05 + 0.5*exp(-(v + 40)*(v + 40)/400))/q10
+    hinf = 1/(1 + exp((v + 62)/7))
+    htau = (1 + 7*exp(-(v + 60)*(v + 60)/225))/q10
+    ninf = 1/(1 + exp(-(v + 53)/15))
+}
+
+FUNCTION ntau(v) {
+    TABLE FROM -100 TO 100 WITH 200
+    ntau = 1 + 5*exp(-(v + 60)*(v + 60)/625)
+}
@@ -0,0 +1,54 @@
+TITLE three state kinetic channel
+
+NEURON {
+    SUFFIX kinetic
+    USEION k READ ek WRITE ik
+    RANGE gbar
+}
+
+UNITS {
+    (mA) = (milliamp)
+    (mV) = (millivolt)
+    (S) = (siemens)
+}
+
+PARAMETER {
+    gbar = 0.001 (S/cm2)
+}
+
+ASSIGNED {
+    v (mV)
+    ek (mV)
+    ik (mA/cm2)
+}
+
+STATE {
+    C1 C2 O
+}
+
+BREAKPOINT {
+    SOLVE states METHOD sparse
+    ik = gbar*O*(v - ek)
+}
+
+INITIAL {
+    C1 = 1
+    C2 = 0
+    O = 0
+}
+
+KINETIC states {
+    LOCAL q
+    q = 0.1
+    ~ C1 <-> C2 (alpha(v), beta(v))
+    ~ C2 <-> O (q*alpha(v), 2*beta(v))
+    CONSERVE C1 + C2 + O = 1
+}
+
+FUNCTION alpha(v) {
+    alpha = 0.1*exp(v/20)
+}
+
+FUNCTION beta(v) {
+    beta = 0.2*exp(-v/30)
+}